@@ -0,0 +1,754 @@
+#define _GNU_SOURCE // qsort_r()
+#include "BTree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BufferManager.h"
+#include "DBConfig.h"
+#include "DiskManager.h"
+
+#define BTREE_MAGIC 0x42545245 // "BTRE"
+
+typedef struct BTreeLayout
+{
+	FieldType type;
+	size_t keysize;
+	size_t entrysize; // Key then BTreeRid
+	size_t leafCapacity;
+	size_t innerCapacity; // Separators of an inner node, it has one more child
+} BTreeLayout;
+
+static BTreeLayout layoutOf(FieldType type, size_t keysize)
+{
+	BTreeLayout l;
+	l.type = type;
+	l.keysize = keysize;
+	l.entrysize = keysize + sizeof(BTreeRid);
+	l.leafCapacity = (config->pagesize - sizeof(BTreeNode)) / l.entrysize;
+	l.innerCapacity = (config->pagesize - sizeof(BTreeNode) - sizeof(PageId)) / (l.entrysize + sizeof(PageId));
+	return l;
+}
+
+static uint8_t *leafEntry(const BTreeLayout *l, BTreeNode *node, size_t i)
+{
+	return node->data + i * l->entrysize;
+}
+
+static PageId *innerChild(BTreeNode *node, size_t i)
+{
+	return (PageId *)node->data + i;
+}
+
+static uint8_t *innerEntry(const BTreeLayout *l, BTreeNode *node, size_t i)
+{
+	return node->data + (l->innerCapacity + 1) * sizeof(PageId) + i * l->entrysize;
+}
+
+/*
+*   Params :
+*       - type : INT, REAL or FIXED_LENGTH_STRING
+*       - keysize : bytes of a key
+*       - a, b : keys, not aligned
+*
+*   Return :
+*       - < 0, 0 or > 0 as a is lower, equal or greater than b
+*
+*   Notes :
+*       - Strings are padded with zeros, comparing their bytes orders them like strcmp()
+*/
+int BTreeCompareKeys(FieldType type, size_t keysize, const uint8_t *a, const uint8_t *b)
+{
+	switch (type)
+	{
+	case INT:
+	{
+		int32_t x, y;
+		memcpy(&x, a, sizeof x);
+		memcpy(&y, b, sizeof y);
+		return (x > y) - (x < y);
+	}
+	case REAL:
+	{
+		float x, y;
+		memcpy(&x, a, sizeof x);
+		memcpy(&y, b, sizeof y);
+		return (x > y) - (x < y);
+	}
+	default:
+		return memcmp(a, b, keysize);
+	}
+}
+
+// Key, then record order
+static int compareEntries(const BTreeLayout *l, const uint8_t *a, const uint8_t *b)
+{
+	const int c = BTreeCompareKeys(l->type, l->keysize, a, b);
+	if (c)
+		return c;
+
+	BTreeRid x, y;
+	memcpy(&x, a + l->keysize, sizeof x);
+	memcpy(&y, b + l->keysize, sizeof y);
+	if (x.pageId.FileIdx != y.pageId.FileIdx)
+		return x.pageId.FileIdx < y.pageId.FileIdx ? -1 : 1;
+	if (x.pageId.PageIdx != y.pageId.PageIdx)
+		return x.pageId.PageIdx < y.pageId.PageIdx ? -1 : 1;
+	return (x.slot_idx > y.slot_idx) - (x.slot_idx < y.slot_idx);
+}
+
+// First entry of a leaf not lower than entry
+static size_t leafLowerBound(const BTreeLayout *l, BTreeNode *node, const uint8_t *entry)
+{
+	size_t lo = 0, hi = node->nb_entries;
+	while (lo < hi)
+	{
+		const size_t mid = (lo + hi) / 2;
+		if (compareEntries(l, leafEntry(l, node, mid), entry) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// Child of an inner node whose subtree holds entry
+static size_t innerChildOfEntry(const BTreeLayout *l, BTreeNode *node, const uint8_t *entry)
+{
+	size_t lo = 0, hi = node->nb_entries;
+	while (lo < hi)
+	{
+		const size_t mid = (lo + hi) / 2;
+		if (compareEntries(l, innerEntry(l, node, mid), entry) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// Child of an inner node whose subtree holds the first entry of key, or precedes it
+static size_t innerChildOfKey(const BTreeLayout *l, BTreeNode *node, const uint8_t *key)
+{
+	size_t lo = 0, hi = node->nb_entries;
+	while (lo < hi)
+	{
+		const size_t mid = (lo + hi) / 2;
+		if (BTreeCompareKeys(l->type, l->keysize, innerEntry(l, node, mid), key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+*   Params :
+*       - type : type of the keys, INT, REAL or FIXED_LENGTH_STRING
+*       - keysize : bytes of a key
+*
+*   Return :
+*       - The meta page of an empty tree, NULL if no page could be allocated or if less than 3 keys fit in a page
+*/
+PageId *BTreeCreate(FieldType type, size_t keysize)
+{
+	const BTreeLayout l = layoutOf(type, keysize);
+	if (l.innerCapacity < 3 || l.leafCapacity < 3)
+		return NULL;
+
+	PageId *metaPageId = AllocPage();
+	if (!metaPageId)
+		return NULL;
+	PageId *rootPageId = AllocPage();
+	if (!rootPageId)
+	{
+		DeallocPage(metaPageId);
+		return NULL;
+	}
+
+	BTreeNode *root = (BTreeNode *)GetPage(rootPageId);
+	LatchBuffer((uint8_t *)root, BUFFER_LATCH_EXCLUSIVE);
+	root->is_leaf = 1;
+	root->has_next = 0;
+	root->nb_entries = 0;
+	UnlatchBuffer((uint8_t *)root);
+	FreePage(rootPageId, 1);
+
+	BTreeMeta *meta = (BTreeMeta *)GetPage(metaPageId);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	meta->magic = BTREE_MAGIC;
+	meta->type = type;
+	meta->keysize = keysize;
+	meta->height = 1;
+	meta->nb_entries = 0;
+	meta->root = *rootPageId;
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(metaPageId, 1);
+
+	return metaPageId;
+}
+
+static void dropNode(PageId *pageId)
+{
+	BTreeNode *node = (BTreeNode *)GetPage(pageId);
+	if (!node->is_leaf)
+	{
+		// Copied first, the page is released before going down
+		const size_t nb = node->nb_entries + 1;
+		PageId *children = malloc(nb * sizeof *children);
+		if (!children)
+		{
+			perror("error: malloc btree:");
+			abort();
+		}
+		memcpy(children, innerChild(node, 0), nb * sizeof *children);
+		FreePage(pageId, 0);
+
+		for (size_t i = 0; i < nb; i++)
+			dropNode(FindPageId(children[i]));
+		free(children);
+	}
+	else
+		FreePage(pageId, 0);
+
+	DeallocPage(pageId);
+}
+
+// Deallocates every page of the tree
+void BTreeDrop(PageId *metaPageId)
+{
+	BTreeMeta *meta = (BTreeMeta *)GetPage(metaPageId);
+	PageId *rootPageId = FindPageId(meta->root);
+	FreePage(metaPageId, 0);
+
+	dropNode(rootPageId);
+	DeallocPage(metaPageId);
+}
+
+// Inserts entry at pos in a leaf that has room for it
+static void leafInsertAt(const BTreeLayout *l, BTreeNode *leaf, size_t pos, const uint8_t *entry)
+{
+	memmove(leafEntry(l, leaf, pos + 1), leafEntry(l, leaf, pos), (leaf->nb_entries - pos) * l->entrysize);
+	memcpy(leafEntry(l, leaf, pos), entry, l->entrysize);
+	leaf->nb_entries++;
+}
+
+/*
+*   Params :
+*       - l
+*       - pageId : root of the tree
+*       - entry : to insert
+*
+*   Return :
+*       - The number of pages the insertion of entry allocates: one per node that splits, the full nodes from its leaf
+*         up, and a new root if every node of the path splits
+*/
+static size_t pagesForInsert(const BTreeLayout *l, PageId *pageId, const uint8_t *entry)
+{
+	size_t nb_full = 0, depth = 0;
+
+	while (pageId)
+	{
+		BTreeNode *node = (BTreeNode *)GetPage(pageId);
+		const int full = node->nb_entries >= (node->is_leaf ? l->leafCapacity : l->innerCapacity);
+		nb_full = full ? nb_full + 1 : 0;
+		depth++;
+
+		PageId *childId = node->is_leaf ? NULL : FindPageId(*innerChild(node, innerChildOfEntry(l, node, entry)));
+		FreePage(pageId, 0);
+		pageId = childId;
+	}
+
+	return nb_full + (nb_full == depth);
+}
+
+/*
+*   Params :
+*       - l
+*       - pageId : root of the subtree
+*       - entry : inserted in the subtree
+*       - spares : pages allocated by BTreeInsert(), a node that splits takes its new sibling from the end
+*       - nb_spares : pages left in spares
+*       - sep : entrysize bytes, receives the separator of the split
+*       - right : receives the new right sibling of the split
+*
+*   Return :
+*       - 1 if the node split, sep and right then go in the parent, 0 if it didn't
+*/
+static int insertEntry(const BTreeLayout *l, PageId *pageId, const uint8_t *entry, PageId **spares, size_t *nb_spares,
+	uint8_t *sep, PageId **right)
+{
+	BTreeNode *node = (BTreeNode *)GetPage(pageId);
+
+	if (node->is_leaf)
+	{
+		if (node->nb_entries < l->leafCapacity)
+		{
+			LatchBuffer((uint8_t *)node, BUFFER_LATCH_EXCLUSIVE);
+			leafInsertAt(l, node, leafLowerBound(l, node, entry), entry);
+			UnlatchBuffer((uint8_t *)node);
+			FreePage(pageId, 1);
+			return 0;
+		}
+
+		PageId *siblingId = spares[--*nb_spares];
+		BTreeNode *sibling = (BTreeNode *)GetPage(siblingId);
+		const size_t pos = leafLowerBound(l, node, entry);
+		const size_t half = (node->nb_entries + 1) / 2;
+
+		// The upper half moves to the new right sibling. One page is latched at a time, a checkpoint latches the
+		// dirty frames in their order.
+		LatchBuffer((uint8_t *)sibling, BUFFER_LATCH_EXCLUSIVE);
+		sibling->is_leaf = 1;
+		sibling->nb_entries = node->nb_entries - half;
+		memcpy(leafEntry(l, sibling, 0), leafEntry(l, node, half), sibling->nb_entries * l->entrysize);
+		sibling->has_next = node->has_next;
+		sibling->next = node->next;
+		if (pos > half)
+			leafInsertAt(l, sibling, pos - half, entry);
+		memcpy(sep, leafEntry(l, sibling, 0), l->entrysize);
+		UnlatchBuffer((uint8_t *)sibling);
+
+		LatchBuffer((uint8_t *)node, BUFFER_LATCH_EXCLUSIVE);
+		node->has_next = 1;
+		node->next = *siblingId;
+		node->nb_entries = half;
+		if (pos <= half)
+			leafInsertAt(l, node, pos, entry);
+		UnlatchBuffer((uint8_t *)node);
+
+		*right = siblingId;
+		FreePage(siblingId, 1);
+		FreePage(pageId, 1);
+		return 1;
+	}
+
+	// The path isn't kept pinned, the node is read again if its child split
+	const size_t idx = innerChildOfEntry(l, node, entry);
+	PageId *childId = FindPageId(*innerChild(node, idx));
+	FreePage(pageId, 0);
+
+	uint8_t *childSep = malloc(l->entrysize);
+	if (!childSep)
+	{
+		perror("error: malloc btree:");
+		abort();
+	}
+	PageId *childRight = NULL;
+	if (!insertEntry(l, childId, entry, spares, nb_spares, childSep, &childRight))
+	{
+		free(childSep);
+		return 0;
+	}
+
+	node = (BTreeNode *)GetPage(pageId);
+	const size_t nb = node->nb_entries;
+	if (nb < l->innerCapacity)
+	{
+		LatchBuffer((uint8_t *)node, BUFFER_LATCH_EXCLUSIVE);
+		memmove(innerEntry(l, node, idx + 1), innerEntry(l, node, idx), (nb - idx) * l->entrysize);
+		memcpy(innerEntry(l, node, idx), childSep, l->entrysize);
+		memmove(innerChild(node, idx + 2), innerChild(node, idx + 1), (nb - idx) * sizeof(PageId));
+		*innerChild(node, idx + 1) = *childRight;
+		node->nb_entries++;
+		UnlatchBuffer((uint8_t *)node);
+		FreePage(pageId, 1);
+		free(childSep);
+		return 0;
+	}
+
+	PageId *siblingId = spares[--*nb_spares];
+	BTreeNode *sibling = (BTreeNode *)GetPage(siblingId);
+
+	// nb + 1 separators and nb + 2 children laid out in order, the middle separator goes up
+	uint8_t *entries = malloc((nb + 1) * l->entrysize);
+	PageId *children = malloc((nb + 2) * sizeof *children);
+	if (!entries || !children)
+	{
+		perror("error: malloc btree:");
+		abort();
+	}
+	memcpy(entries, innerEntry(l, node, 0), idx * l->entrysize);
+	memcpy(entries + idx * l->entrysize, childSep, l->entrysize);
+	memcpy(entries + (idx + 1) * l->entrysize, innerEntry(l, node, idx), (nb - idx) * l->entrysize);
+	memcpy(children, innerChild(node, 0), (idx + 1) * sizeof *children);
+	children[idx + 1] = *childRight;
+	memcpy(children + idx + 2, innerChild(node, idx + 1), (nb - idx) * sizeof *children);
+
+	const size_t mid = (nb + 1) / 2;
+	LatchBuffer((uint8_t *)node, BUFFER_LATCH_EXCLUSIVE);
+	node->nb_entries = mid;
+	memcpy(innerEntry(l, node, 0), entries, mid * l->entrysize);
+	memcpy(innerChild(node, 0), children, (mid + 1) * sizeof *children);
+	UnlatchBuffer((uint8_t *)node);
+
+	LatchBuffer((uint8_t *)sibling, BUFFER_LATCH_EXCLUSIVE);
+	sibling->is_leaf = 0;
+	sibling->has_next = 0;
+	sibling->nb_entries = nb - mid;
+	memcpy(innerEntry(l, sibling, 0), entries + (mid + 1) * l->entrysize, (nb - mid) * l->entrysize);
+	memcpy(innerChild(sibling, 0), children + mid + 1, (nb - mid + 1) * sizeof *children);
+	UnlatchBuffer((uint8_t *)sibling);
+
+	memcpy(sep, entries + mid * l->entrysize, l->entrysize);
+	*right = siblingId;
+
+	free(entries);
+	free(children);
+	free(childSep);
+	FreePage(siblingId, 1);
+	FreePage(pageId, 1);
+	return 1;
+}
+
+/*
+*   Params :
+*       - metaPageId : tree
+*       - key : keysize bytes
+*       - rid : record of key
+*
+*   Return :
+*       - 1 if the entry was inserted, 0 if no page could be allocated, the tree is then left unchanged
+*
+*   Description :
+*       Every page the splits need is allocated before a node changes, so a split can't fail halfway. The insertions
+*       into a tree are serialized by their caller, the full nodes counted first are still full when they split.
+*/
+int BTreeInsert(PageId *metaPageId, const uint8_t *key, RecordId rid)
+{
+	BTreeMeta *meta = (BTreeMeta *)GetPage(metaPageId);
+	const BTreeLayout l = layoutOf(meta->type, meta->keysize);
+	PageId *rootPageId = FindPageId(meta->root);
+	FreePage(metaPageId, 0);
+
+	uint8_t *entry = malloc(2 * l.entrysize);
+	if (!entry)
+	{
+		perror("error: malloc btree:");
+		abort();
+	}
+	uint8_t *sep = entry + l.entrysize;
+	const BTreeRid diskRid = {.pageId = *rid.page_id, .slot_idx = rid.slot_idx};
+	memcpy(entry, key, l.keysize);
+	memcpy(entry + l.keysize, &diskRid, sizeof diskRid);
+
+	size_t nb_spares = pagesForInsert(&l, rootPageId, entry);
+	PageId **spares = malloc((nb_spares + 1) * sizeof *spares);
+	if (!spares)
+	{
+		perror("error: malloc btree:");
+		abort();
+	}
+	for (size_t i = 0; i < nb_spares; i++)
+	{
+		spares[i] = AllocPage();
+		if (!spares[i])
+		{
+			while (i--)
+				DeallocPage(spares[i]);
+			free(spares);
+			free(entry);
+			return 0;
+		}
+	}
+
+	PageId *right = NULL;
+	PageId *newRootId = NULL;
+	if (insertEntry(&l, rootPageId, entry, spares, &nb_spares, sep, &right))
+	{
+		// The root split, the tree grows by one level
+		newRootId = spares[--nb_spares];
+		BTreeNode *root = (BTreeNode *)GetPage(newRootId);
+		LatchBuffer((uint8_t *)root, BUFFER_LATCH_EXCLUSIVE);
+		root->is_leaf = 0;
+		root->has_next = 0;
+		root->nb_entries = 1;
+		*innerChild(root, 0) = *rootPageId;
+		*innerChild(root, 1) = *right;
+		memcpy(innerEntry(&l, root, 0), sep, l.entrysize);
+		UnlatchBuffer((uint8_t *)root);
+		FreePage(newRootId, 1);
+	}
+
+	meta = (BTreeMeta *)GetPage(metaPageId);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	if (newRootId)
+	{
+		meta->root = *newRootId;
+		meta->height++;
+	}
+	meta->nb_entries++;
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(metaPageId, 1);
+
+	free(spares);
+	free(entry);
+	return 1;
+}
+
+static int compareEntriesOf(const void *a, const void *b, void *layout)
+{
+	return compareEntries(layout, a, b);
+}
+
+// Fewest nodes holding nb_items items, capacity at most each
+static size_t nodesFor(size_t nb_items, size_t capacity)
+{
+	return (nb_items + capacity - 1) / capacity;
+}
+
+/*
+*   Params :
+*       - metaPageId : empty tree
+*       - entries : n entries of keysize bytes followed by a BTreeRid, sorted here
+*       - n : number of entries
+*
+*   Return :
+*       - 1 if the tree was built, 0 if no page could be allocated, the tree is then left empty
+*
+*   Description :
+*       Builds the tree bottom-up from the sorted entries instead of n BTreeInsert(): every page is written once, in
+*       order, and the leaves are full. The following insertions split them as usual.
+*/
+int BTreeBuild(PageId *metaPageId, uint8_t *entries, size_t n)
+{
+	BTreeMeta *meta = (BTreeMeta *)GetPage(metaPageId);
+	const BTreeLayout l = layoutOf(meta->type, meta->keysize);
+	PageId *rootPageId = FindPageId(meta->root);
+	FreePage(metaPageId, 0);
+
+	if (!n)
+		return 1;
+	qsort_r(entries, n, l.entrysize, compareEntriesOf, (void *)&l);
+
+	// Nodes of the level being built, and the first entry of each, its separator in the parent
+	size_t nb_nodes = nodesFor(n, l.leafCapacity);
+	PageId **nodes = malloc(nb_nodes * sizeof *nodes);
+	const uint8_t **firsts = malloc(nb_nodes * sizeof *firsts);
+	PageId **allocated = malloc(2 * nb_nodes * sizeof *allocated); // Pages to deallocate if the build fails
+	size_t nb_allocated = 0;
+	if (!nodes || !firsts || !allocated)
+	{
+		perror("error: malloc btree build:");
+		abort();
+	}
+
+	// The empty root leaf becomes the first leaf, the others are consecutive on disk like the nodes of each level
+	nodes[0] = rootPageId;
+	if (nb_nodes > 1 && !AllocPages(nodes + 1, (int)(nb_nodes - 1)))
+		goto failed;
+	memcpy(allocated, nodes + 1, (nb_nodes - 1) * sizeof *allocated);
+	nb_allocated = nb_nodes - 1;
+
+	for (size_t i = 0; i < nb_nodes; i++)
+	{
+		const size_t first = i * n / nb_nodes, last = (i + 1) * n / nb_nodes;
+		BTreeNode *leaf = (BTreeNode *)GetPage(nodes[i]);
+		LatchBuffer((uint8_t *)leaf, BUFFER_LATCH_EXCLUSIVE);
+		leaf->is_leaf = 1;
+		leaf->nb_entries = last - first;
+		memcpy(leafEntry(&l, leaf, 0), entries + first * l.entrysize, (last - first) * l.entrysize);
+		leaf->has_next = i + 1 < nb_nodes;
+		if (leaf->has_next)
+			leaf->next = *nodes[i + 1];
+		UnlatchBuffer((uint8_t *)leaf);
+		FreePage(nodes[i], 1);
+		firsts[i] = entries + first * l.entrysize;
+	}
+
+	uint32_t height = 1;
+	while (nb_nodes > 1)
+	{
+		// Each parent takes the children [first, last[ and the separators between them
+		const size_t nb_parents = nodesFor(nb_nodes, l.innerCapacity + 1);
+		PageId **parents = allocated + nb_allocated;
+		if (!AllocPages(parents, (int)nb_parents))
+			goto failed;
+		nb_allocated += nb_parents;
+		for (size_t p = 0; p < nb_parents; p++)
+		{
+			const size_t first = p * nb_nodes / nb_parents, last = (p + 1) * nb_nodes / nb_parents;
+			PageId *parentId = parents[p];
+
+			BTreeNode *parent = (BTreeNode *)GetPage(parentId);
+			LatchBuffer((uint8_t *)parent, BUFFER_LATCH_EXCLUSIVE);
+			parent->is_leaf = 0;
+			parent->has_next = 0;
+			parent->nb_entries = last - first - 1;
+			for (size_t c = first; c < last; c++)
+			{
+				*innerChild(parent, c - first) = *nodes[c];
+				if (c > first)
+					memcpy(innerEntry(&l, parent, c - first - 1), firsts[c], l.entrysize);
+			}
+			UnlatchBuffer((uint8_t *)parent);
+			FreePage(parentId, 1);
+
+			// Written over the children already linked
+			nodes[p] = parentId;
+			firsts[p] = firsts[first];
+		}
+		nb_nodes = nb_parents;
+		height++;
+	}
+
+	meta = (BTreeMeta *)GetPage(metaPageId);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	meta->root = *nodes[0];
+	meta->height = height;
+	meta->nb_entries = n;
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(metaPageId, 1);
+
+	free(nodes);
+	free(firsts);
+	free(allocated);
+	return 1;
+
+failed:
+	for (size_t i = 0; i < nb_allocated; i++)
+		DeallocPage(allocated[i]);
+	BTreeNode *root = (BTreeNode *)GetPage(rootPageId);
+	LatchBuffer((uint8_t *)root, BUFFER_LATCH_EXCLUSIVE);
+	root->is_leaf = 1;
+	root->has_next = 0;
+	root->nb_entries = 0;
+	UnlatchBuffer((uint8_t *)root);
+	FreePage(rootPageId, 1);
+
+	free(nodes);
+	free(firsts);
+	free(allocated);
+	return 0;
+}
+
+/*
+*   Params :
+*       - metaPageId : tree
+*       - lo : lowest key returned, NULL for no lower bound
+*       - loInclusive : 0 if the entries of lo itself are skipped
+*       - hi : highest key returned, NULL for no upper bound
+*       - hiInclusive : 0 if the entries of hi itself are skipped
+*
+*   Return :
+*       - The cursor, to give to BTreeCursorNext() and BTreeCloseCursor()
+*
+*   Description :
+*       Goes down to the leaf of the first entry not lower than lo, the following entries are then read leaf by leaf.
+*/
+BTreeCursor *BTreeOpenCursor(PageId *metaPageId, const uint8_t *lo, int loInclusive, const uint8_t *hi, int hiInclusive)
+{
+	BTreeCursor *cursor = calloc(1, sizeof *cursor);
+	if (!cursor)
+		return NULL;
+
+	BTreeMeta *meta = (BTreeMeta *)GetPage(metaPageId);
+	const BTreeLayout l = layoutOf(meta->type, meta->keysize);
+	PageId *pageId = FindPageId(meta->root);
+	FreePage(metaPageId, 0);
+
+	cursor->type = l.type;
+	cursor->keysize = l.keysize;
+	cursor->entrysize = l.entrysize;
+	cursor->loInclusive = loInclusive;
+	cursor->hiInclusive = hiInclusive;
+	if (lo)
+	{
+		cursor->lo = malloc(l.keysize);
+		if (!cursor->lo)
+		{
+			perror("error: malloc btree cursor:");
+			abort();
+		}
+		memcpy(cursor->lo, lo, l.keysize);
+	}
+	if (hi)
+	{
+		cursor->hi = malloc(l.keysize);
+		if (!cursor->hi)
+		{
+			perror("error: malloc btree cursor:");
+			abort();
+		}
+		memcpy(cursor->hi, hi, l.keysize);
+	}
+
+	BTreeNode *node = (BTreeNode *)GetPage(pageId);
+	while (!node->is_leaf)
+	{
+		PageId *childId = FindPageId(*innerChild(node, lo ? innerChildOfKey(&l, node, lo) : 0));
+		FreePage(pageId, 0);
+		pageId = childId;
+		node = (BTreeNode *)GetPage(pageId);
+	}
+
+	cursor->leafId = pageId;
+	cursor->leaf = node;
+	cursor->pos = 0;
+	while (lo && cursor->pos < node->nb_entries && BTreeCompareKeys(l.type, l.keysize, leafEntry(&l, node, cursor->pos), lo) < 0)
+		cursor->pos++;
+
+	return cursor;
+}
+
+/*
+*   Params :
+*       - cursor
+*       - rid : receives the record of the next entry
+*
+*   Return :
+*       - 1 if rid was set, 0 once every entry up to the upper bound has been returned
+*/
+int BTreeCursorNext(BTreeCursor *cursor, RecordId *rid)
+{
+	const BTreeLayout l = {.type = cursor->type, .keysize = cursor->keysize, .entrysize = cursor->entrysize};
+
+	while (cursor->leaf)
+	{
+		if (cursor->pos >= cursor->leaf->nb_entries)
+		{
+			PageId *nextId = cursor->leaf->has_next ? FindPageId(cursor->leaf->next) : NULL;
+			FreePage(cursor->leafId, 0);
+			cursor->leafId = nextId;
+			cursor->leaf = nextId ? (BTreeNode *)GetPage(nextId) : NULL;
+			cursor->pos = 0;
+			continue;
+		}
+
+		const uint8_t *entry = leafEntry(&l, cursor->leaf, cursor->pos++);
+		if (cursor->lo && !cursor->loInclusive && BTreeCompareKeys(l.type, l.keysize, entry, cursor->lo) == 0)
+			continue;
+		if (cursor->hi)
+		{
+			const int c = BTreeCompareKeys(l.type, l.keysize, entry, cursor->hi);
+			if (c > 0 || (c == 0 && !cursor->hiInclusive))
+			{
+				FreePage(cursor->leafId, 0);
+				cursor->leafId = NULL;
+				cursor->leaf = NULL;
+				return 0;
+			}
+		}
+
+		BTreeRid diskRid;
+		memcpy(&diskRid, entry + l.keysize, sizeof diskRid);
+		rid->page_id = FindPageId(diskRid.pageId);
+		rid->slot_idx = diskRid.slot_idx;
+		return 1;
+	}
+
+	return 0;
+}
+
+void BTreeCloseCursor(BTreeCursor *cursor)
+{
+	if (!cursor)
+		return;
+
+	if (cursor->leaf)
+		FreePage(cursor->leafId, 0);
+	free(cursor->lo);
+	free(cursor->hi);
+	free(cursor);
+}
@@ -0,0 +1,80 @@
+#ifndef SHINBDDA_BTREE_H
+#define SHINBDDA_BTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "HeapFile.h"
+#include "PageId.h"
+#include "Record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BTreeMeta
+/*
+*   First page of a B+tree, its PageId identifies the tree, the root moves when it splits
+*/
+{
+	uint32_t magic;
+	FieldType type; // INT, REAL or FIXED_LENGTH_STRING
+	uint32_t keysize; // Bytes of a key, a string is padded with zeros
+	uint32_t height; // 1 while the root is a leaf
+	uint64_t nb_entries;
+	PageId root;
+} BTreeMeta;
+
+typedef struct BTreeNode
+/*
+*   Page of a B+tree, its entries are (key, BTreeRid) pairs ordered by key then by record, so a key can repeat.
+*   A leaf holds nb_entries entries, an inner node nb_entries separators between nb_entries + 1 children, the
+*   separator i being the first entry of the subtree of child i + 1.
+*/
+{
+	uint8_t is_leaf;
+	uint8_t has_next; // A leaf that isn't the last one, next is its right sibling
+	uint32_t nb_entries;
+	PageId next;
+	uint8_t data[]; // Leaf: entries. Inner node: the PageId of every child, then the separators
+} BTreeNode;
+
+typedef struct BTreeRid
+{
+	PageId pageId;
+	uint32_t slot_idx;
+} BTreeRid;
+
+typedef struct BTreeCursor
+/*
+*   Entries of a B+tree between two keys, in order, see BTreeCursorNext()
+*/
+{
+	FieldType type;
+	size_t keysize;
+	size_t entrysize;
+
+	PageId *leafId; // Pinned leaf of the next entry, NULL at the end
+	BTreeNode *leaf;
+	uint32_t pos;
+
+	uint8_t *lo; // NULL for no lower bound
+	int loInclusive;
+	uint8_t *hi; // NULL for no upper bound
+	int hiInclusive;
+} BTreeCursor;
+
+int BTreeCompareKeys(FieldType type, size_t keysize, const uint8_t *a, const uint8_t *b);
+PageId *BTreeCreate(FieldType type, size_t keysize);
+void BTreeDrop(PageId *metaPageId);
+int BTreeInsert(PageId *metaPageId, const uint8_t *key, RecordId rid);
+int BTreeBuild(PageId *metaPageId, uint8_t *entries, size_t n);
+BTreeCursor *BTreeOpenCursor(PageId *metaPageId, const uint8_t *lo, int loInclusive, const uint8_t *hi, int hiInclusive);
+int BTreeCursorNext(BTreeCursor *cursor, RecordId *rid);
+void BTreeCloseCursor(BTreeCursor *cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHINBDDA_BTREE_H
@@ -2,12 +2,127 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 
 #include "BufferManager.h"
+#include "DiskManager.h"
 
+#ifdef BUFFER_PIN_TRACE
+#include <stdatomic.h>
+#endif
+
+// Accesses left in bufferManager->referenced by the hits that don't take lock
+#define TOUCH_ACCESS 1 // Move the frame to the head of the list, the CLOCK reference bit
+#define TOUCH_PROMOTE 2 // Also move the page to T2 of ARC
 
 BufferManager *bufferManager;
 
+// pin_count and flagdirty are read without the lock that guards their changes
+static int pins(const buffer *buf)
+{
+    return __atomic_load_n(&buf->pin_count, __ATOMIC_ACQUIRE);
+}
+
+static int is_dirty(const buffer *buf)
+{
+    return __atomic_load_n(&buf->flagdirty, __ATOMIC_ACQUIRE);
+}
+
+static void count_stat(size_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+#ifdef BUFFER_PIN_TRACE
+typedef struct PinEvent
+{
+    _Atomic size_t seq; // Number of the event + 1, 0 while the slot was never written
+    PageId pageId;
+    int is_pin; // 1 for GetPage, 0 for FreePage
+    int pin_count; // After the event
+    const char *function;
+    const char *filename;
+    size_t line;
+} PinEvent;
+
+// Lock-free ring of the last pin events: a writer claims a slot with a fetch_add and publishes it with seq
+static PinEvent pinTrace[BUFFER_PIN_TRACE_SIZE];
+static _Atomic size_t pinTraceNext;
+
+static void trace_pin(const buffer *buf, int is_pin, const char *function, const char *filename, size_t line)
+{
+    const size_t n = atomic_fetch_add_explicit(&pinTraceNext, 1, memory_order_relaxed);
+    PinEvent *event = pinTrace + (n & (BUFFER_PIN_TRACE_SIZE - 1));
+
+    atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // seq is cleared before the fields change
+    event->pageId = buf->bufferPageId;
+    event->is_pin = is_pin;
+    event->pin_count = pins(buf);
+    event->function = function;
+    event->filename = filename;
+    event->line = line;
+    atomic_store_explicit(&event->seq, n + 1, memory_order_release);
+}
+
+void PrintPinTrace(size_t count)
+{
+    const size_t next = atomic_load_explicit(&pinTraceNext, memory_order_acquire);
+    if (count > next)
+        count = next;
+    if (count > BUFFER_PIN_TRACE_SIZE)
+        count = BUFFER_PIN_TRACE_SIZE;
+
+    for (size_t n = next - count; n < next; n++)
+    {
+        const PinEvent *event = pinTrace + (n & (BUFFER_PIN_TRACE_SIZE - 1));
+        if (atomic_load_explicit(&event->seq, memory_order_acquire) != n + 1)
+            continue; // Being written or already overwritten
+
+        // Copied, then kept only if no writer claimed the slot meanwhile, as a seqlock reader does
+        const PageId pageId = event->pageId;
+        const int is_pin = event->is_pin;
+        const int pin_count = event->pin_count;
+        const char *function = event->function;
+        const char *filename = event->filename;
+        const size_t line = event->line;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&event->seq, memory_order_relaxed) != n + 1)
+            continue; // Torn
+
+        printf("#%zu %s (%d, %d) pin_count=%d %s %s:%zu\n", n, is_pin ? "GetPage " : "FreePage",
+            pageId.FileIdx, pageId.PageIdx, pin_count, function, filename, line);
+    }
+}
+#else
+#define trace_pin(buf, is_pin, function, filename, line) ((void)0)
+#endif
+
+static void *bgwriter_main(void *arg);
+
+// Empties T1, T2, B1 and B2, every frame must be empty
+static void resetArc()
+{
+    bufferManager->arcSize[0] = config->dm_buffercount;
+    bufferManager->arcSize[1] = bufferManager->arcSize[2] = 0;
+    bufferManager->arcTarget = 0;
+
+    for (int i = 0; i < config->dm_buffercount; i++)
+    {
+        bufferManager->frames[i].arc_list = 0;
+        bufferManager->ghosts[i].list = 0;
+        bufferManager->ghosts[i].next = i + 1 < config->dm_buffercount ? i + 1 : -1;
+    }
+    bufferManager->ghostFree = 0;
+    clearPageTable(bufferManager->ghostTable);
+
+    for (int l = 0; l < 3; l++)
+    {
+        bufferManager->ghostHead[l] = bufferManager->ghostTail[l] = -1;
+        bufferManager->ghostSize[l] = 0;
+    }
+}
+
 void constructBufferManager()
 
 {
@@ -18,35 +133,104 @@ void constructBufferManager()
         abort();
     }
 
-    bufferManager->bufferHead = calloc(1, sizeof *bufferManager->bufferHead);
+    bufferManager->frames = calloc(config->dm_buffercount, sizeof *bufferManager->frames);
+    bufferManager->arena = aligned_alloc(config->pagesize, (size_t)config->dm_buffercount * config->pagesize);
+    bufferManager->referenced = calloc(config->dm_buffercount, sizeof *bufferManager->referenced);
+    bufferManager->clockHand = 0;
+    if (bufferManager->frames == NULL || bufferManager->arena == NULL || bufferManager->referenced == NULL)
+    {
+        perror("error: malloc frames:");
+        abort();
+    }
+
+    for (int i = 0; i < BUFFER_PAGE_TABLE_SHARDS; i++)
+    {
+        pthread_mutex_init(&bufferManager->shards[i].lock, NULL);
+        bufferManager->shards[i].table = newPageTable(config->dm_buffercount / BUFFER_PAGE_TABLE_SHARDS + 1);
+        if (bufferManager->shards[i].table == NULL)
+        {
+            perror("error: malloc page table:");
+            abort();
+        }
+    }
+
+    for (int i = 0; i < config->dm_buffercount; i++)
+    {
+        buffer *buf = bufferManager->frames + i;
+        buf->bufferPageId.FileIdx = -1;
+        buf->content = bufferManager->arena + (size_t)i * config->pagesize;
+        pthread_rwlock_init(&buf->latch, NULL);
+        buf->prev = i > 0 ? buf - 1 : NULL;
+        buf->next = i < config->dm_buffercount - 1 ? buf + 1 : NULL;
+    }
+
+    bufferManager->bufferHead = bufferManager->frames;
+    bufferManager->bufferTail = bufferManager->frames + config->dm_buffercount - 1;
 
-    buffer *buf = bufferManager->bufferHead;
-    int i = 0;
-    for (; i < config->dm_buffercount - 1; i++)
+    bufferManager->nb_prefetching = 0;
+    bufferManager->seqNext.FileIdx = -1;
+    bufferManager->seqRun = 0;
+    bufferManager->nb_seqAdvised = 0;
+
+    bufferManager->ghosts = malloc(config->dm_buffercount * sizeof *bufferManager->ghosts);
+    bufferManager->ghostTable = newPageTable(config->dm_buffercount);
+    if (bufferManager->ghosts == NULL || bufferManager->ghostTable == NULL)
+    {
+        perror("error: malloc ghosts:");
+        abort();
+    }
+    resetArc();
+    memset(bufferManager->stats, 0, sizeof bufferManager->stats);
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&bufferManager->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&bufferManager->readLock, NULL);
+    pthread_cond_init(&bufferManager->readDone, NULL);
+    bufferManager->nb_dirty = 0;
+    bufferManager->dirtyMap = calloc((config->dm_buffercount + 63) / 64, sizeof *bufferManager->dirtyMap);
+    if (bufferManager->dirtyMap == NULL)
     {
-        buf->next = calloc(1, sizeof *bufferManager->bufferHead);
-        buf->next->prev = buf;
-        buf = buf->next;
+        perror("error: malloc dirtyMap:");
+        abort();
     }
 
-    bufferManager->bufferTail = buf;
+    pthread_mutex_init(&bufferManager->bgwriterLock, NULL);
+    pthread_cond_init(&bufferManager->bgwriterWake, NULL);
+    pthread_cond_init(&bufferManager->bgwriterDone, NULL);
+    bufferManager->bgwriterStop = 0;
+    bufferManager->nb_bgwriting = 0;
+    int maxpages = config->dm_bgwriter_maxpages;
+    if (maxpages > config->dm_buffercount)
+        maxpages = config->dm_buffercount;
+    if (maxpages < 1)
+        maxpages = 1;
+    bufferManager->bgwriterMaxPages = maxpages;
+    bufferManager->bgwriterCopies = malloc(bufferManager->bgwriterMaxPages * config->pagesize);
+    bufferManager->bgwriterIds = malloc(bufferManager->bgwriterMaxPages * sizeof *bufferManager->bgwriterIds);
+    if (bufferManager->bgwriterCopies == NULL || bufferManager->bgwriterIds == NULL)
+    {
+        perror("error: malloc bgwriter:");
+        abort();
+    }
+
+    bufferManager->bgwriterRunning = config->dm_bgwriter_delay > 0
+        && pthread_create(&bufferManager->bgwriter, NULL, bgwriter_main, NULL) == 0;
 }
 
-static buffer* LRU()
+static void move_to_head(buffer *buf)
 {
-    buffer *buf = bufferManager->bufferTail;
-    for (; buf; buf = buf->prev)
-        if (!buf->pin_count || buf->flagdirty)
-            break;
-    if (!buf || buf == bufferManager->bufferHead)
-        return buf;
+    if (buf == bufferManager->bufferHead)
+        return;
 
     buffer *next = buf->next;
     buffer *prev = buf->prev;
 
     if (next)
         next->prev = prev;
-    else
+    else // buf is tail
         bufferManager->bufferTail = prev;
     if (prev)
         prev->next = next;
@@ -55,119 +239,861 @@ static buffer* LRU()
     buf->next = bufferManager->bufferHead;
     buf->prev = NULL;
     bufferManager->bufferHead = buf;
+}
+
+static buffer* LRU(const PageId *pageId)
+{
+    (void)pageId; // Only ARC needs the page, for its ghost lists
+    buffer *buf = bufferManager->bufferTail;
+    for (; buf; buf = buf->prev)
+        if (!pins(buf))
+            break;
+    if (buf)
+        move_to_head(buf);
 
     return buf;
 }
 
-static buffer* MRU()
+static buffer* MRU(const PageId *pageId)
 {
-    buffer *buf = bufferManager->bufferHead;
-    for (; buf; buf = buf->next)
-        if (!buf->pin_count && !buf->flagdirty)
+    (void)pageId; // Only ARC needs the page, for its ghost lists
+    buffer *buf = bufferManager->bufferTail; // Empty frames first, they are never moved to the head
+    for (; buf; buf = buf->prev)
+        if (buf->bufferPageId.FileIdx == -1 && !pins(buf))
             break;
-    if (!buf || buf == bufferManager->bufferHead)
-        return buf;
+    if (!buf)
+        for (buf = bufferManager->bufferHead; buf; buf = buf->next)
+            if (!pins(buf) && !is_dirty(buf))
+                break;
+    if (!buf) // only dirty frames are unpinned, write one back
+        for (buf = bufferManager->bufferHead; buf; buf = buf->next)
+            if (!pins(buf))
+                break;
+    if (buf)
+        move_to_head(buf);
 
-    buffer *next = buf->next;
-    buffer *prev = buf->prev;
+    return buf;
+}
 
-    if (next)
-        next->prev = prev;
+static buffer* CLOCK(const PageId *pageId)
+{
+    (void)pageId; // Only ARC needs the page, for its ghost lists
+    const size_t count = config->dm_buffercount;
+
+    buffer *fallback = NULL;
+
+    // Two full turns at most: the first one may only clear reference bits
+    for (size_t n = 0; n < 2 * count; n++)
+    {
+        const size_t idx = bufferManager->clockHand;
+        bufferManager->clockHand = (idx + 1) % count;
+
+        if (pins(bufferManager->frames + idx))
+            continue;
+        // Set without the lock by the hits
+        if (__atomic_exchange_n(bufferManager->referenced + idx, 0, __ATOMIC_RELAXED))
+        {
+            if (n >= count && !fallback)
+                fallback = bufferManager->frames + idx;
+            continue;
+        }
+        return bufferManager->frames + idx;
+    }
+
+    // The hits of other threads set the bits again as fast as they are cleared, any unpinned frame will do
+    return fallback;
+}
+
+static void arc_set_list(buffer *buf, int list)
+{
+    bufferManager->arcSize[buf->arc_list]--;
+    bufferManager->arcSize[list]++;
+    buf->arc_list = list;
+}
+
+static void ghost_remove(int idx)
+{
+    ArcGhost *ghost = bufferManager->ghosts + idx;
+
+    if (ghost->prev != -1)
+        bufferManager->ghosts[ghost->prev].next = ghost->next;
     else
-        bufferManager->bufferTail = prev;
-    if (prev)
-        prev->next = next;
+        bufferManager->ghostHead[ghost->list] = ghost->next;
+    if (ghost->next != -1)
+        bufferManager->ghosts[ghost->next].prev = ghost->prev;
+    else
+        bufferManager->ghostTail[ghost->list] = ghost->prev;
 
-    bufferManager->bufferHead->prev = buf;
-    buf->next = bufferManager->bufferHead;
-    buf->prev = NULL;
-    bufferManager->bufferHead = buf;
+    removePageTable(bufferManager->ghostTable, &ghost->pageId);
+    bufferManager->ghostSize[ghost->list]--;
+    ghost->list = 0;
+    ghost->next = bufferManager->ghostFree;
+    bufferManager->ghostFree = idx;
+}
+
+// Drops the least recent page of B1 or B2
+static void ghost_pop(int list)
+{
+    if (bufferManager->ghostTail[list] != -1)
+        ghost_remove(bufferManager->ghostTail[list]);
+}
+
+static void ghost_push(int list, const PageId *pageId)
+{
+    if (bufferManager->ghostFree == -1) // Only when the frames are pinned in a way ARC doesn't expect
+        ghost_pop(bufferManager->ghostSize[1] ? 1 : 2);
+
+    const int idx = bufferManager->ghostFree;
+    ArcGhost *ghost = bufferManager->ghosts + idx;
+    bufferManager->ghostFree = ghost->next;
+
+    ghost->pageId = *pageId;
+    ghost->list = list;
+    ghost->prev = -1;
+    ghost->next = bufferManager->ghostHead[list];
+    if (ghost->next != -1)
+        bufferManager->ghosts[ghost->next].prev = idx;
+    else
+        bufferManager->ghostTail[list] = idx;
+    bufferManager->ghostHead[list] = idx;
+    bufferManager->ghostSize[list]++;
+
+    insertPageTable(bufferManager->ghostTable, pageId, idx);
+}
+
+// Least recent unpinned frame of an ARC list, the frames are linked in recency order so each list is too
+static buffer *arc_lru(int list)
+{
+    buffer *buf = bufferManager->bufferTail;
+    for (; buf; buf = buf->prev)
+        if (!pins(buf) && buf->arc_list == list)
+            break;
 
     return buf;
 }
 
-static buffer *find_in_buf(PageId *pageId) {
-    buffer *buf = bufferManager->bufferHead;
+// REPLACE of ARC: evicts from T1 while it is above its target, from T2 otherwise
+static buffer *arc_replace(int in_b2, int keep_ghost)
+{
+    const size_t t1 = bufferManager->arcSize[1];
+    int list = t1 > 0 && ((in_b2 && t1 == bufferManager->arcTarget) || t1 > bufferManager->arcTarget) ? 1 : 2;
 
-    for (; buf; buf = buf->next)
+    buffer *buf = arc_lru(list);
+    if (!buf) // Every page of the list is pinned
     {
-        if (buf->bufferPageId == pageId)
-            break;
+        list = 3 - list;
+        buf = arc_lru(list);
     }
+    if (buf && keep_ghost)
+        ghost_push(list, &buf->bufferPageId);
+
+    return buf;
+}
+
+static buffer* ARC(const PageId *pageId)
+/*
+* Adaptive Replacement Cache (Megiddo and Modha): T1 holds the pages seen once, T2 the pages seen again,
+* B1 and B2 remember their last evicted pages. A miss on B1 grows the target size of T1, a miss on B2 shrinks it,
+* so the cache adapts between recency (scans) and frequency (headers and other hot pages).
+*/
+{
+    const size_t c = config->dm_buffercount;
+    const size_t b1 = bufferManager->ghostSize[1], b2 = bufferManager->ghostSize[2];
+    const int ghost = findPageTable(bufferManager->ghostTable, pageId);
+    const int in_list = ghost == -1 ? 0 : bufferManager->ghosts[ghost].list;
+    int keep_ghost = 1;
 
-    if (buf == NULL)
+    if (in_list == 1)
+    {
+        const size_t delta = b2 > b1 ? b2 / b1 : 1;
+        bufferManager->arcTarget = bufferManager->arcTarget + delta < c ? bufferManager->arcTarget + delta : c;
+        ghost_remove(ghost);
+    }
+    else if (in_list == 2)
+    {
+        const size_t delta = b1 > b2 ? b1 / b2 : 1;
+        bufferManager->arcTarget = bufferManager->arcTarget > delta ? bufferManager->arcTarget - delta : 0;
+        ghost_remove(ghost);
+    }
+    else if (bufferManager->arcSize[1] + b1 >= c)
+    {
+        if (b1 > 0)
+            ghost_pop(1);
+        else // T1 fills the cache, its page is dropped without ghost
+            keep_ghost = 0;
+    }
+    else if (bufferManager->arcSize[1] + bufferManager->arcSize[2] + b1 + b2 >= 2 * c)
+        ghost_pop(2);
+
+    buffer *buf = bufferManager->arcSize[0] ? arc_lru(0) : NULL;
+    if (!buf)
+        buf = arc_replace(in_list == 2, keep_ghost);
+    if (!buf)
         return NULL;
 
-    if (buf == bufferManager->bufferHead) // buf is head
-        return buf;
+    arc_set_list(buf, in_list ? 2 : 1);
+    move_to_head(buf);
 
-    buffer *next = buf->next;
-    buffer *prev = buf->prev;
+    return buf;
+}
 
-    if (next)
-        next->prev = prev;
-    else // buf is tail
-        bufferManager->bufferTail = prev;
-    if (prev)
-        prev->next = next;
+static buffer *(*const replacers[])(const PageId *pageId) = {
+    [POLICY_MRU] = MRU,
+    [POLICY_LRU] = LRU,
+    [POLICY_CLOCK] = CLOCK,
+    [POLICY_ARC] = ARC,
+};
 
-    bufferManager->bufferHead->prev = buf;
-    buf->next = bufferManager->bufferHead;
-    buf->prev = NULL;
-    bufferManager->bufferHead = buf;
+static PageTableShard *shard_of(const PageId *pageId)
+{
+    uint32_t h = (uint32_t)pageId->FileIdx * 0x9E3779B1u ^ (uint32_t)pageId->PageIdx * 0x85EBCA77u;
+    h ^= h >> 16;
+
+    return bufferManager->shards + (h & (BUFFER_PAGE_TABLE_SHARDS - 1));
+}
+
+// Frame of the page, pinned so it can't be evicted once the shard is unlocked
+static buffer *lookup_pin(const PageId *pageId) {
+    PageTableShard *shard = shard_of(pageId);
+
+    pthread_mutex_lock(&shard->lock);
+    const int idx = findPageTable(shard->table, pageId);
+    buffer *buf = idx == -1 ? NULL : bufferManager->frames + idx;
+    if (buf)
+        __atomic_add_fetch(&buf->pin_count, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&shard->lock);
 
     return buf;
 }
 
+// Frame of the page without pinning it, lock is held so it can't be evicted
+static buffer *lookup(const PageId *pageId) {
+    PageTableShard *shard = shard_of(pageId);
+
+    pthread_mutex_lock(&shard->lock);
+    const int idx = findPageTable(shard->table, pageId);
+    pthread_mutex_unlock(&shard->lock);
+
+    return idx == -1 ? NULL : bufferManager->frames + idx;
+}
+
+// Makes the frame reachable from its page, its content must be read or being read
+static void publish_frame(buffer *buf)
+{
+    PageTableShard *shard = shard_of(&buf->bufferPageId);
+
+    pthread_mutex_lock(&shard->lock);
+    insertPageTable(shard->table, &buf->bufferPageId, (int)(buf - bufferManager->frames));
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Replays the access a hit left in referenced instead of waiting for lock, returns whether there was one
+static int replay_touch(buffer *buf)
+{
+    const uint8_t access = __atomic_exchange_n(bufferManager->referenced + (buf - bufferManager->frames), 0, __ATOMIC_RELAXED);
+    if ((access & TOUCH_PROMOTE) && config->dm_policy == POLICY_ARC && buf->arc_list != 0)
+        arc_set_list(buf, 2);
+
+    return access != 0;
+}
+
+// An access for the replacement policy, lock is held
+static void touch(buffer *buf) {
+    if (config->dm_policy == POLICY_CLOCK)
+        __atomic_store_n(bufferManager->referenced + (buf - bufferManager->frames), 1, __ATOMIC_RELAXED);
+    else
+    {
+        replay_touch(buf); // Older than this access
+        move_to_head(buf);
+    }
+}
+
+// An access of a hit that doesn't take lock: CLOCK only needs the reference bit, the other policies replay it later
+static void leave_touch(buffer *buf, uint8_t access)
+{
+    __atomic_fetch_or(bufferManager->referenced + (buf - bufferManager->frames), access, __ATOMIC_RELAXED);
+    if (config->dm_policy != POLICY_CLOCK)
+        __atomic_store_n(&bufferManager->touchesPending, 1, __ATOMIC_RELEASE);
+}
+
+// Moves the frames accessed without lock to the head before a victim is chosen, lock is held.
+// Their order among themselves is lost, they are only more recent than the other frames.
+static void apply_touches()
+{
+    if (config->dm_policy == POLICY_CLOCK || !__atomic_exchange_n(&bufferManager->touchesPending, 0, __ATOMIC_ACQ_REL))
+        return;
+
+    for (int i = 0; i < config->dm_buffercount; i++)
+        if (replay_touch(bufferManager->frames + i) && bufferManager->frames[i].bufferPageId.FileIdx != -1)
+            move_to_head(bufferManager->frames + i);
+}
+
+// Waits for every asynchronous read, releases the frames being prefetched
+static void complete_async()
+{
+    if (bufferManager->nb_prefetching == 0)
+        return;
+
+    WaitPagesAsync();
+
+    for (size_t i = 0; i < bufferManager->nb_prefetching; i++)
+    {
+        __atomic_store_n(&bufferManager->prefetching[i]->io_pending, 0, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&bufferManager->prefetching[i]->pin_count, 1, __ATOMIC_ACQ_REL);
+    }
+    bufferManager->nb_prefetching = 0;
+}
+
+// Waits until the miss that loads the frame has read it, no lock is held
+static void wait_read(buffer *buf)
+{
+    if (__atomic_load_n(&buf->io_pending, __ATOMIC_ACQUIRE) != BUFFER_IO_READ)
+        return;
+
+    pthread_mutex_lock(&bufferManager->readLock);
+    while (__atomic_load_n(&buf->io_pending, __ATOMIC_ACQUIRE) == BUFFER_IO_READ)
+        pthread_cond_wait(&bufferManager->readDone, &bufferManager->readLock);
+    pthread_mutex_unlock(&bufferManager->readLock);
+}
+
+static void finish_read(buffer *buf)
+{
+    pthread_mutex_lock(&bufferManager->readLock);
+    __atomic_store_n(&buf->io_pending, 0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&bufferManager->readDone);
+    pthread_mutex_unlock(&bufferManager->readLock);
+}
+
+// flagdirty, nb_dirty and dirtyMap change together, under the shard lock of the page or once the frame is unreachable
+static int set_dirty(buffer *buf)
+{
+    const size_t idx = buf - bufferManager->frames;
+
+    if (__atomic_exchange_n(&buf->flagdirty, 1, __ATOMIC_ACQ_REL))
+        return 0;
+    __atomic_add_fetch(&bufferManager->nb_dirty, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_or(bufferManager->dirtyMap + idx / 64, (uint64_t)1 << (idx % 64), __ATOMIC_RELAXED);
+    return 1;
+}
+
+static void set_clean(buffer *buf)
+{
+    const size_t idx = buf - bufferManager->frames;
+
+    if (!__atomic_exchange_n(&buf->flagdirty, 0, __ATOMIC_ACQ_REL))
+        return;
+    __atomic_sub_fetch(&bufferManager->nb_dirty, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_and(bufferManager->dirtyMap + idx / 64, ~((uint64_t)1 << (idx % 64)), __ATOMIC_RELAXED);
+}
+
+// Marks a published frame clean before its content is written: a thread that modifies it meanwhile marks it dirty again
+static void set_clean_published(buffer *buf)
+{
+    PageTableShard *shard = shard_of(&buf->bufferPageId);
+
+    pthread_mutex_lock(&shard->lock);
+    set_clean(buf);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Writes the dirty frames found in dirtyMap and marks them clean, lock is held
+static size_t write_dirty()
+{
+    const size_t max = __atomic_load_n(&bufferManager->nb_dirty, __ATOMIC_RELAXED);
+    PageId **ids = malloc(max * sizeof *ids);
+    uint8_t **contents = malloc(max * sizeof *contents);
+    size_t nb = 0;
+
+    const size_t words = (config->dm_buffercount + 63) / 64;
+    for (size_t w = 0; w < words && nb < max; w++)
+    {
+        for (uint64_t bits = __atomic_load_n(bufferManager->dirtyMap + w, __ATOMIC_RELAXED); bits && nb < max; bits &= bits - 1)
+        {
+            buffer *buf = bufferManager->frames + w * 64 + __builtin_ctzll(bits);
+            pthread_rwlock_rdlock(&buf->latch); // Until the write completes
+            set_clean_published(buf);
+            ids[nb] = &buf->bufferPageId;
+            contents[nb] = buf->content;
+            nb++;
+        }
+    }
+    WritePagesAsync(ids, contents, nb);
+    WaitPagesAsync();
+    for (size_t i = 0; i < nb; i++)
+        pthread_rwlock_unlock(&bufferManager->frames[(contents[i] - bufferManager->arena) / config->pagesize].latch);
+
+    free(ids);
+    free(contents);
+    return nb;
+}
+
+// Waits for the current round of the background writer, lock is held. The wait is on bgwriterLock: lock is recursive,
+// a condition wait would only release one level of it.
+static void wait_bg_round()
+{
+    pthread_mutex_lock(&bufferManager->bgwriterLock);
+    while (bufferManager->nb_bgwriting > 0)
+        pthread_cond_wait(&bufferManager->bgwriterDone, &bufferManager->bgwriterLock);
+    pthread_mutex_unlock(&bufferManager->bgwriterLock);
+}
+
+// The page mustn't be read or written again while the background writer writes it
+static void wait_bg_write(const PageId *pageId)
+{
+    pthread_mutex_lock(&bufferManager->bgwriterLock);
+    for (size_t i = 0; i < bufferManager->nb_bgwriting; i++)
+    {
+        if (bufferManager->bgwriterIds[i].FileIdx == pageId->FileIdx && bufferManager->bgwriterIds[i].PageIdx == pageId->PageIdx)
+        {
+            while (bufferManager->nb_bgwriting > 0)
+                pthread_cond_wait(&bufferManager->bgwriterDone, &bufferManager->bgwriterLock);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&bufferManager->bgwriterLock);
+}
+
+// Takes the frame away from its page, fails if another thread pinned the page since the frame was chosen.
+// The frame is returned pinned so no replacer may choose it again. Returns 1 once evicted, 0 on failure, -1 if the
+// frame is dirty: it keeps its page, to be written by clean_frame() without lock held.
+static int evict_frame(buffer *buf)
+{
+    if (buf->bufferPageId.FileIdx == -1)
+    {
+        if (pins(buf)) // Reserved by another thread
+            return 0;
+        __atomic_store_n(&buf->pin_count, 1, __ATOMIC_RELEASE);
+        return 1;
+    }
+
+    PageTableShard *shard = shard_of(&buf->bufferPageId);
+    pthread_mutex_lock(&shard->lock);
+    if (pins(buf))
+    {
+        pthread_mutex_unlock(&shard->lock);
+        return 0;
+    }
+    __atomic_store_n(&buf->pin_count, 1, __ATOMIC_RELEASE);
+    if (is_dirty(buf))
+    {
+        pthread_mutex_unlock(&shard->lock);
+        return -1;
+    }
+    removePageTable(shard->table, &buf->bufferPageId);
+    pthread_mutex_unlock(&shard->lock);
+
+    count_stat(&bufferManager->stats[config->dm_policy].evictions);
+    buf->bufferPageId.FileIdx = -1;
+
+    return 1;
+}
+
+// Writes the dirty frame kept by evict_frame() and unpins it, lock isn't held. The page stays cached meanwhile,
+// a miss on it can't read an older version from the disk.
+static void clean_frame(buffer *buf)
+{
+    wait_bg_write(&buf->bufferPageId); // Its copy is older
+    pthread_rwlock_rdlock(&buf->latch);
+    set_clean_published(buf);
+    WritePage(&buf->bufferPageId, buf->content);
+    pthread_rwlock_unlock(&buf->latch);
+
+    count_stat(&bufferManager->stats[config->dm_policy].writebacks);
+    __atomic_sub_fetch(&buf->pin_count, 1, __ATOMIC_ACQ_REL);
+}
+
+// Gives the evicted frame to pageId, the caller reads the content and publishes the frame
+static void assign_frame(buffer *buf, const PageId *pageId)
+{
+    buf->bufferPageId = *pageId;
+    buf->ring_owned = 0;
+    buf->prefetched = 0;
+    // Any other access left belongs to the evicted page
+    __atomic_store_n(bufferManager->referenced + (buf - bufferManager->frames), config->dm_policy == POLICY_CLOCK, __ATOMIC_RELAXED);
+}
+
+static buffer *victim(const PageId *pageId)
+{
+    apply_touches();
+    buffer *buf = replacers[config->dm_policy](pageId);
+
+    if (!buf && bufferManager->nb_prefetching > 0)
+    {
+        complete_async();
+        buf = replacers[config->dm_policy](pageId);
+    }
+
+    return buf;
+}
+
+// Next frame of the ring: the frame of the slot if nobody else uses it, otherwise a victim that joins the ring
+static buffer *strategy_victim(BufferAccessStrategy *strategy, const PageId *pageId)
+{
+    if (!strategy || strategy->size == 0)
+        return victim(pageId);
+
+    strategy->current = (strategy->current + 1) % strategy->size;
+    const int idx = strategy->ring[strategy->current];
+    buffer *buf = idx == -1 ? NULL : bufferManager->frames + idx;
+
+    if (buf && __atomic_load_n(&buf->ring_owned, __ATOMIC_RELAXED) && !pins(buf))
+    {
+        if (config->dm_policy != POLICY_CLOCK)
+            move_to_head(buf);
+    }
+    else
+    {
+        buf = victim(pageId);
+        if (!buf)
+            return NULL;
+        strategy->ring[strategy->current] = (int)(buf - bufferManager->frames);
+    }
+
+    return buf;
+}
+
+// Reads ahead once misses follow the disk order of the pages, lock is held
+static void read_ahead(const PageId *pageId)
+{
+    if (pageId->FileIdx == bufferManager->seqNext.FileIdx && pageId->PageIdx == bufferManager->seqNext.PageIdx)
+    {
+        bufferManager->seqRun++;
+        if (bufferManager->nb_seqAdvised > 0)
+            bufferManager->nb_seqAdvised--;
+    }
+    else
+    {
+        bufferManager->seqRun = 1;
+        bufferManager->nb_seqAdvised = 0;
+    }
+    if (!NextPageId(pageId, &bufferManager->seqNext))
+    {
+        bufferManager->seqNext.FileIdx = -1;
+        return;
+    }
+
+    // The window is refilled once half of it was read
+    if (bufferManager->seqRun < BUFFER_READAHEAD_MIN || bufferManager->nb_seqAdvised > BUFFER_READAHEAD_MAX / 2)
+        return;
+    if (bufferManager->nb_seqAdvised > 0 && bufferManager->seqAdvised.FileIdx == -1) // Read ahead up to the last page
+        return;
+
+    PageId pages[BUFFER_READAHEAD_MAX];
+    PageId *ids[BUFFER_READAHEAD_MAX];
+    PageId next = bufferManager->nb_seqAdvised > 0 ? bufferManager->seqAdvised : bufferManager->seqNext;
+    size_t nb = 0;
+    int exists = 1;
+    while (exists && bufferManager->nb_seqAdvised + nb < BUFFER_READAHEAD_MAX)
+    {
+        pages[nb] = next;
+        ids[nb] = pages + nb;
+        nb++;
+        exists = NextPageId(pages + nb - 1, &next);
+    }
+
+    AdvisePages(ids, nb);
+    bufferManager->seqAdvised = next;
+    if (!exists)
+        bufferManager->seqAdvised.FileIdx = -1;
+    bufferManager->nb_seqAdvised += nb;
+}
+
+// Gives back a frame returned by evict_frame() that won't be loaded
+static void release_frame(buffer *buf)
+{
+    if (buf->arc_list != 0) // Chosen by ARC, which counted it in T1 or T2
+        arc_set_list(buf, 0);
+    buf->bufferPageId.FileIdx = -1;
+    __atomic_store_n(&buf->pin_count, 0, __ATOMIC_RELEASE);
+}
+
+// Chooses a frame for pageId and evicts its page. lock is held once, it is released while a dirty victim is written:
+// the caller looks the page up again.
+static buffer *take_frame(BufferAccessStrategy *strategy, const PageId *pageId)
+{
+    buffer *buf = NULL;
+    int evicted = 0;
+    while (evicted != 1)
+    {
+        buf = strategy_victim(strategy, pageId);
+        if (!buf)
+            return NULL;
+        // Once written, the victim is evicted unless another thread used it meanwhile
+        while ((evicted = evict_frame(buf)) == -1)
+        {
+            pthread_mutex_unlock(&bufferManager->lock);
+            clean_frame(buf);
+            pthread_mutex_lock(&bufferManager->lock);
+        }
+    }
+
+    return buf;
+}
+
+BufferAccessStrategy *GetAccessStrategy(BufferAccessStrategyType type)
+{
+    BufferAccessStrategy *strategy = calloc(1, sizeof *strategy);
+    if (!strategy)
+        return NULL;
+
+    strategy->type = type;
+    if (type == BAS_NORMAL)
+        return strategy;
+
+    // A quarter of the pool at most, so a scan never takes over the frames of the other operations
+    strategy->size = type == BAS_BULKREAD ? BUFFER_RING_BULKREAD : BUFFER_RING_BULKWRITE;
+    if (strategy->size > (size_t)config->dm_buffercount / 4)
+        strategy->size = config->dm_buffercount / 4;
+    if (strategy->size == 0)
+        strategy->size = 1;
+
+    strategy->ring = malloc(strategy->size * sizeof *strategy->ring);
+    if (!strategy->ring)
+    {
+        free(strategy);
+        return NULL;
+    }
+    for (size_t i = 0; i < strategy->size; i++)
+        strategy->ring[i] = -1;
+
+    return strategy;
+}
+
+void FreeAccessStrategy(BufferAccessStrategy *strategy)
+{
+    if (!strategy)
+        return;
+
+    // The pages of the ring stay cached, as any other page
+    pthread_mutex_lock(&bufferManager->lock);
+    for (size_t i = 0; i < strategy->size; i++)
+        if (strategy->ring[i] != -1)
+            __atomic_store_n(&bufferManager->frames[strategy->ring[i]].ring_owned, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&bufferManager->lock);
+
+    free(strategy->ring);
+    free(strategy);
+}
+
+// Frame examined at step k of the order the current policy evicts in
+static buffer *eviction_order(buffer *prev, size_t k)
+{
+    if (config->dm_policy == POLICY_CLOCK)
+        return bufferManager->frames + (bufferManager->clockHand + k) % config->dm_buffercount;
+    if (config->dm_policy == POLICY_MRU)
+        return k == 0 ? bufferManager->bufferHead : prev->next;
+    return k == 0 ? bufferManager->bufferTail : prev->prev;
+}
+
+// Copies the dirty frames to write in this round and marks them clean, lock is held
+static size_t bgwriter_collect()
+{
+    const size_t max = bufferManager->bgwriterMaxPages;
+    const size_t target = (size_t)(config->dm_dirty_ratio * config->dm_buffercount);
+    size_t nb = 0;
+    apply_touches();
+
+    // The next max frames to be evicted are always cleaned, the others only while there are too many dirty frames
+    buffer *buf = NULL;
+    for (size_t k = 0; k < (size_t)config->dm_buffercount && nb < max; k++)
+    {
+        buf = eviction_order(buf, k);
+        if (k >= max && __atomic_load_n(&bufferManager->nb_dirty, __ATOMIC_RELAXED) <= target)
+            break;
+        if (!is_dirty(buf) || pins(buf) || __atomic_load_n(&buf->io_pending, __ATOMIC_ACQUIRE))
+            continue;
+        if (pthread_rwlock_tryrdlock(&buf->latch) != 0) // Pinned and being modified since
+            continue;
+
+        set_clean_published(buf);
+        memcpy(bufferManager->bgwriterCopies + nb * config->pagesize, buf->content, config->pagesize);
+        bufferManager->bgwriterIds[nb++] = buf->bufferPageId;
+        pthread_rwlock_unlock(&buf->latch);
+    }
+
+    return nb;
+}
+
+static void *bgwriter_main(void *arg)
+{
+    PageId **ids = malloc(bufferManager->bgwriterMaxPages * sizeof *ids);
+    uint8_t **contents = malloc(bufferManager->bgwriterMaxPages * sizeof *contents);
+
+    pthread_mutex_lock(&bufferManager->bgwriterLock);
+    while (!bufferManager->bgwriterStop)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += config->dm_bgwriter_delay / 1000;
+        deadline.tv_nsec += (long)(config->dm_bgwriter_delay % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&bufferManager->bgwriterWake, &bufferManager->bgwriterLock, &deadline);
+        if (bufferManager->bgwriterStop)
+            break;
+        pthread_mutex_unlock(&bufferManager->bgwriterLock);
+
+        // lock before bgwriterLock, as the foreground takes them
+        pthread_mutex_lock(&bufferManager->lock);
+        const size_t nb = bgwriter_collect();
+        for (size_t i = 0; i < nb; i++)
+        {
+            ids[i] = bufferManager->bgwriterIds + i;
+            contents[i] = bufferManager->bgwriterCopies + i * config->pagesize;
+        }
+        pthread_mutex_lock(&bufferManager->bgwriterLock);
+        bufferManager->nb_bgwriting = nb;
+        pthread_mutex_unlock(&bufferManager->bgwriterLock);
+        pthread_mutex_unlock(&bufferManager->lock);
+
+        // The foreground keeps working on the frames meanwhile, only these pages wait for the write
+        if (nb > 0)
+            WritePages(ids, contents, nb);
+
+        pthread_mutex_lock(&bufferManager->bgwriterLock);
+        bufferManager->nb_bgwriting = 0;
+        pthread_cond_broadcast(&bufferManager->bgwriterDone);
+    }
+    pthread_mutex_unlock(&bufferManager->bgwriterLock);
+
+    free(ids);
+    free(contents);
+    return arg;
+}
+
 void clearBufferManager() {
-    buffer * buf = bufferManager->bufferHead;
-    buffer * next = buf->next;
+    if (bufferManager->bgwriterRunning)
+    {
+        pthread_mutex_lock(&bufferManager->bgwriterLock);
+        bufferManager->bgwriterStop = 1;
+        pthread_cond_signal(&bufferManager->bgwriterWake);
+        pthread_mutex_unlock(&bufferManager->bgwriterLock);
+        pthread_join(bufferManager->bgwriter, NULL);
+    }
+    pthread_cond_destroy(&bufferManager->bgwriterWake);
+    pthread_cond_destroy(&bufferManager->bgwriterDone);
+    pthread_mutex_destroy(&bufferManager->bgwriterLock);
+    pthread_mutex_destroy(&bufferManager->lock);
+    pthread_cond_destroy(&bufferManager->readDone);
+    pthread_mutex_destroy(&bufferManager->readLock);
+    free(bufferManager->bgwriterCopies);
+    free(bufferManager->bgwriterIds);
 
-    while (next) {
-        next = buf->next;
+    complete_async();
 
-        free(buf->content);
-        free(buf);
+#ifdef BUFFER_TRACK_OWNERS
+    for (int i = 0; i < config->dm_buffercount; i++)
+        free(bufferManager->frames[i].owners);
+#endif
 
-        buf = next;
+    for (int i = 0; i < config->dm_buffercount; i++)
+        pthread_rwlock_destroy(&bufferManager->frames[i].latch);
+    for (int i = 0; i < BUFFER_PAGE_TABLE_SHARDS; i++)
+    {
+        pthread_mutex_destroy(&bufferManager->shards[i].lock);
+        freePageTable(bufferManager->shards[i].table);
     }
 
+    free(bufferManager->frames);
+    free(bufferManager->arena);
+    free(bufferManager->referenced);
+    free(bufferManager->dirtyMap);
+    free(bufferManager->ghosts);
+    freePageTable(bufferManager->ghostTable);
     free(bufferManager);
 }
 
 uint8_t *__GetPage(PageId *pageId, const char *function, const char *filename, size_t line) {
-    buffer *buf = find_in_buf(pageId);
-    /*
-     *  buffer *(*fn[2])();
-     *  fn[POLICY_LRU] = LRU;
-     *  fn[POLICY_MRU] = MRU;
-     *  buf = fn[config->dm_policy]();
-     */
-    if (!buf)
+    return __GetPageStrategy(pageId, NULL, function, filename, line);
+}
+
+uint8_t *__GetPageStrategy(PageId *pageId, BufferAccessStrategy *strategy, const char *function, const char *filename, size_t line) {
+    buffer *buf = lookup_pin(pageId);
+    int locked = 0;
+
+#ifndef BUFFER_TRACK_OWNERS
+    // A hit only takes the shard lock, and lock if no other thread holds it: CLOCK only sets the reference bit,
+    // the lists of the other policies are reordered by the next thread that chooses a victim
+    const Policy policy = config->dm_policy;
+    if (buf && !__atomic_load_n(&buf->prefetched, __ATOMIC_ACQUIRE))
     {
-        buf = (config->dm_policy == POLICY_LRU ? LRU : MRU)();
-        if (buf->flagdirty)
+        if (policy != POLICY_CLOCK)
+            locked = pthread_mutex_trylock(&bufferManager->lock) == 0;
+        if (!locked)
         {
-            // manage dirty, pin count (check if correct)
-            WritePage(buf->bufferPageId, buf->content);
-            memset(buf->content, 0, config->pagesize);
-        }
-        else if (!buf->content)
-        {
-            buf->content = malloc(config->pagesize * sizeof(uint8_t));
+            // A second reference makes the page frequent, unless it comes from a scan
+            leave_touch(buf, policy == POLICY_ARC && !strategy ? TOUCH_ACCESS | TOUCH_PROMOTE : TOUCH_ACCESS);
+            if (!strategy)
+                __atomic_store_n(&buf->ring_owned, 0, __ATOMIC_RELAXED); // Cached for good once accessed outside of a ring
+            count_stat(&bufferManager->stats[policy].hits);
+            trace_pin(buf, 1, function, filename, line);
+            wait_read(buf);
+            return buf->content;
         }
+    }
+#endif
+
+    if (!locked)
+        pthread_mutex_lock(&bufferManager->lock);
+    BufferStats *stats = bufferManager->stats + config->dm_policy;
+    if (!buf) // Another thread may have read it while this one waited for the lock
+        buf = lookup_pin(pageId);
+
+    int must_read = 0;
+    if (buf)
+    {
+        if (__atomic_load_n(&buf->io_pending, __ATOMIC_ACQUIRE) == BUFFER_IO_ASYNC)
+            complete_async();
+        if (!strategy)
+            __atomic_store_n(&buf->ring_owned, 0, __ATOMIC_RELAXED); // Cached for good once accessed outside of a ring
 
+        count_stat(buf->prefetched ? &stats->misses : &stats->hits);
+
+        // A second reference makes the page frequent, unless it comes from a scan or is the first one of a prefetched page
+        if (config->dm_policy == POLICY_ARC && !strategy && !buf->prefetched)
+            arc_set_list(buf, 2);
+        __atomic_store_n(&buf->prefetched, 0, __ATOMIC_RELEASE);
+        touch(buf);
+    }
+    else
+    {
+        count_stat(&stats->misses);
+        buf = take_frame(strategy, pageId);
+        assert(buf != NULL); // every frame is pinned
+#ifdef BUFFER_TRACK_OWNERS
         assert(buf->nb_owners == 0);
+#endif
 
-        ReadPage(pageId, buf->content);
-        buf->bufferPageId = pageId;
-        buf->pin_count = 0;
-        buf->flagdirty = 0;
+        assign_frame(buf, pageId);
+
+        // Other threads ran while the dirty victims were written, one of them may have loaded the page
+        buffer *cached = lookup_pin(pageId);
+        if (cached)
+        {
+            release_frame(buf);
+            buf = cached;
+            if (__atomic_load_n(&buf->io_pending, __ATOMIC_ACQUIRE) == BUFFER_IO_ASYNC)
+                complete_async();
+            __atomic_store_n(&buf->prefetched, 0, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            read_ahead(pageId);
+            buf->ring_owned = strategy && strategy->size > 0;
+            // Read once lock is released, a GetPage of the page meanwhile waits in wait_read()
+            __atomic_store_n(&buf->io_pending, BUFFER_IO_READ, __ATOMIC_RELEASE);
+            publish_frame(buf);
+            must_read = 1;
+        }
+        touch(buf);
     }
-    assert(buf == bufferManager->bufferHead);
-    assert(buf->content != NULL);
-    buf->pin_count++;
+    assert(buf == bufferManager->bufferHead || config->dm_policy == POLICY_CLOCK);
+    trace_pin(buf, 1, function, filename, line);
 
+#ifdef BUFFER_TRACK_OWNERS
     buf->nb_owners++;
     OwnerSrc *tmp = realloc(buf->owners, buf->nb_owners * sizeof(OwnerSrc));
     assert(tmp != NULL);
@@ -175,18 +1101,57 @@ uint8_t *__GetPage(PageId *pageId, const char *function, const char *filename, s
     buf->owners[buf->nb_owners - 1].filename = filename;
     buf->owners[buf->nb_owners - 1].line = line;
     buf->owners[buf->nb_owners - 1].function = function;
+#endif
+
+    pthread_mutex_unlock(&bufferManager->lock);
 
+    if (must_read)
+    {
+        wait_bg_write(pageId);
+        ReadPage(pageId, buf->content);
+        finish_read(buf);
+    }
+    else
+        wait_read(buf);
     return buf->content;
 }
 
 void __FreePage(PageId *pageId, int valdirty, const char *function, const char *filename, size_t line) {
-    buffer *buf = find_in_buf(pageId);
-    if (buf == NULL)
+#ifdef BUFFER_TRACK_OWNERS
+    const int locked = 1;
+    pthread_mutex_lock(&bufferManager->lock);
+#else
+    // As for a hit, the lists are reordered later if another thread holds lock
+    const int locked = config->dm_policy != POLICY_CLOCK && pthread_mutex_trylock(&bufferManager->lock) == 0;
+#endif
+
+    PageTableShard *shard = shard_of(pageId);
+    pthread_mutex_lock(&shard->lock);
+    const int idx = findPageTable(shard->table, pageId);
+    if (idx == -1)
+    {
+        pthread_mutex_unlock(&shard->lock);
+        if (locked)
+            pthread_mutex_unlock(&bufferManager->lock);
         return;
+    }
+    buffer *buf = bufferManager->frames + idx;
 
-    buf->pin_count--;
-    buf->flagdirty = buf->flagdirty || valdirty; // never clear flag dirty on free, we should clean it if we actually write the page
+    // never clear flag dirty on free, we should clean it if we actually write the page
+    if (valdirty && set_dirty(buf) && __atomic_load_n(&bufferManager->nb_dirty, __ATOMIC_RELAXED) > config->dm_dirty_ratio * config->dm_buffercount)
+        pthread_cond_signal(&bufferManager->bgwriterWake);
+    trace_pin(buf, 0, function, filename, line);
+    if (!locked) // Before the unpin, so the access can't be left to the next page of the frame
+        leave_touch(buf, TOUCH_ACCESS);
+    if (pins(buf) > 0)
+        __atomic_sub_fetch(&buf->pin_count, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&shard->lock);
 
+    if (!locked)
+        return;
+    touch(buf);
+
+#ifdef BUFFER_TRACK_OWNERS
     if (buf->nb_owners == 1)
     {
         free(buf->owners);
@@ -208,34 +1173,169 @@ void __FreePage(PageId *pageId, int valdirty, const char *function, const char *
         buf->owners = tmp;
         buf->nb_owners--;
     }
+#endif
 
-    if (buf->pin_count <= 0)
-        buf->pin_count = 0;
+    pthread_mutex_unlock(&bufferManager->lock);
 }
 
 void SetCurrentReplacementPolicy (Policy paul)
 {
+    pthread_mutex_lock(&bufferManager->lock);
+    // Pages loaded by another policy join T1 of ARC
+    if (paul == POLICY_ARC)
+        for (int i = 0; i < config->dm_buffercount; i++)
+            if (bufferManager->frames[i].bufferPageId.FileIdx != -1 && bufferManager->frames[i].arc_list == 0)
+                arc_set_list(bufferManager->frames + i, 1);
+    // The reference bits of CLOCK aren't accesses to replay
+    if (config->dm_policy == POLICY_CLOCK && paul != POLICY_CLOCK)
+        for (int i = 0; i < config->dm_buffercount; i++)
+            __atomic_store_n(bufferManager->referenced + i, 0, __ATOMIC_RELAXED);
+
     config->dm_policy=paul;
+    pthread_mutex_unlock(&bufferManager->lock);
+}
+
+BufferStats GetBufferStats(Policy policy)
+{
+    pthread_mutex_lock(&bufferManager->lock);
+    const BufferStats stats = bufferManager->stats[policy];
+    pthread_mutex_unlock(&bufferManager->lock);
+    return stats;
+}
+
+void ResetBufferStats()
+{
+    pthread_mutex_lock(&bufferManager->lock);
+    memset(bufferManager->stats, 0, sizeof bufferManager->stats);
+    pthread_mutex_unlock(&bufferManager->lock);
+}
+
+size_t PrefetchPages(PageId **pageIds, size_t count, BufferAccessStrategy *strategy) {
+    pthread_mutex_lock(&bufferManager->lock);
+    const size_t requested = count;
+    // Without a ring, half of the pool, none if the configured count makes no sense
+    const size_t shared = config->dm_buffercount > 0 ? (size_t)config->dm_buffercount / 2 : 0;
+    size_t max = strategy && strategy->size > 0 ? strategy->size : shared;
+    if (max > BUFFER_PREFETCH_MAX - bufferManager->nb_prefetching)
+        max = BUFFER_PREFETCH_MAX - bufferManager->nb_prefetching;
+    if (count > max)
+        count = max;
+
+    PageId *ids[BUFFER_PREFETCH_MAX];
+    uint8_t *contents[BUFFER_PREFETCH_MAX];
+    size_t nb = 0;
+
+    apply_touches();
+    buffer *dirty = NULL; // Written once lock is released, prefetching stops at the first dirty victim
+    size_t i = 0;
+    for (; i < count; i++)
+    {
+        if (lookup(pageIds[i]))
+            continue;
+
+        buffer *buf = strategy && strategy->size > 0 ? strategy_victim(strategy, pageIds[i]) : replacers[config->dm_policy](pageIds[i]);
+        const int evicted = buf ? evict_frame(buf) : 0;
+        if (evicted == -1)
+            dirty = buf;
+        if (evicted != 1)
+            break;
+
+        wait_bg_write(pageIds[i]);
+        assign_frame(buf, pageIds[i]);
+        buf->ring_owned = strategy && strategy->size > 0;
+        buf->prefetched = 1;
+        __atomic_store_n(&buf->io_pending, BUFFER_IO_ASYNC, __ATOMIC_RELEASE);
+        bufferManager->prefetching[bufferManager->nb_prefetching++] = buf;
+        publish_frame(buf); // A GetPage of the page waits for the read in complete_async()
+
+        ids[nb] = pageIds[i];
+        contents[nb] = buf->content;
+        nb++;
+    }
+
+    ReadPagesAsync(ids, contents, nb);
+
+    // The pages that don't fit in the frames are only hinted to the kernel, a scan refills its window once half of it was read
+    size_t advised = 0;
+    if (strategy)
+        advised = strategy->advised > i ? strategy->advised - i : 0;
+    size_t ahead = requested - i;
+    if (ahead > BUFFER_READAHEAD_MAX)
+        ahead = BUFFER_READAHEAD_MAX;
+    if (advised <= BUFFER_READAHEAD_MAX / 2 && ahead > advised)
+    {
+        AdvisePages(pageIds + i + advised, ahead - advised);
+        advised = ahead;
+    }
+    if (strategy)
+        strategy->advised = advised;
+
+    pthread_mutex_unlock(&bufferManager->lock);
+    if (dirty)
+        clean_frame(dirty);
+    return i;
+}
+
+size_t CheckpointBuffers() {
+    pthread_mutex_lock(&bufferManager->lock);
+    wait_bg_round(); // Its copies may be older than the frames
+    complete_async();
+
+    // Only the dirty frames are written, every page stays cached
+    const size_t nb = write_dirty();
+    SyncPages();
+
+    pthread_mutex_unlock(&bufferManager->lock);
+    return nb;
+}
+
+// A latch is never held across GetPage()/FreePage(): checkpoints take them while holding lock
+void LatchBuffer(const uint8_t *content, BufferLatchMode mode)
+{
+    buffer *buf = bufferManager->frames + (content - bufferManager->arena) / config->pagesize;
+
+    if (mode == BUFFER_LATCH_EXCLUSIVE)
+        pthread_rwlock_wrlock(&buf->latch);
+    else
+        pthread_rwlock_rdlock(&buf->latch);
+}
+
+void UnlatchBuffer(const uint8_t *content)
+{
+    pthread_rwlock_unlock(&bufferManager->frames[(content - bufferManager->arena) / config->pagesize].latch);
 }
 
+// Teardown, only on QUIT: every frame is emptied, no other thread may use the buffers
 void FlushBuffers() {
-    for (buffer *buf = bufferManager->bufferHead; buf; buf = buf->next)
+    pthread_mutex_lock(&bufferManager->lock);
+    wait_bg_round(); // Its copies may be older than the frames
+    complete_async();
+
+    write_dirty();
+    for (int i = 0; i < BUFFER_PAGE_TABLE_SHARDS; i++)
     {
-        assert(buf->nb_owners == 0 && buf->pin_count == 0);
-        if (buf->flagdirty)
-        {
-            assert(buf->content);
-            // manage dirty, pin count (check if correct)
-            WritePage(buf->bufferPageId, buf->content);
-            memset(buf->content, 0, config->pagesize);
-        }
+        pthread_mutex_lock(&bufferManager->shards[i].lock);
+        clearPageTable(bufferManager->shards[i].table);
+        pthread_mutex_unlock(&bufferManager->shards[i].lock);
+    }
+    memset(bufferManager->referenced, 0, config->dm_buffercount * sizeof *bufferManager->referenced);
+    bufferManager->clockHand = 0;
+    resetArc();
 
-        buf->flagdirty = 0;
+    for (buffer *buf = bufferManager->bufferHead; buf; buf = buf->next)
+    {
+#ifdef BUFFER_TRACK_OWNERS
+        assert(buf->nb_owners == 0);
+#endif
+        assert(buf->pin_count == 0);
         buf->pin_count = 0;
-        buf->bufferPageId = NULL;
-        free(buf->content);
-        buf->content = NULL;
+        buf->prefetched = 0;
+        buf->bufferPageId.FileIdx = -1;
+#ifdef BUFFER_TRACK_OWNERS
         free(buf->owners);
         buf->owners = NULL;
+        buf->nb_owners = 0;
+#endif
     }
+    pthread_mutex_unlock(&bufferManager->lock);
 }
\ No newline at end of file
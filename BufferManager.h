@@ -3,11 +3,24 @@
 
 #include "Structures.h"
 #include "PageId.h"
+#include "PageTable.h"
+
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define BUFFER_PREFETCH_MAX 64 // Pages that can be read ahead at once
+#define BUFFER_RING_BULKREAD 32 // Max frames recycled by a sequential scan
+#define BUFFER_RING_BULKWRITE 64 // Max frames recycled by a bulk insert
+#define BUFFER_PIN_TRACE_SIZE 1024 // Pin events kept with BUFFER_PIN_TRACE, a power of two
+#define BUFFER_PAGE_TABLE_SHARDS 16 // Page table partitions, each with its own lock, a power of two
+#define BUFFER_READAHEAD_MIN 4 // Misses on consecutive pages before reading ahead
+#define BUFFER_READAHEAD_MAX 32 // Pages read ahead of a sequential scan, at most
+#define BUFFER_IO_ASYNC 1 // io_pending of a frame read by PrefetchPages(), completed with lock held
+#define BUFFER_IO_READ 2 // io_pending of a frame read by the miss that loaded it, without any lock held
+
 typedef struct buffer buffer;
 
 typedef struct OwnerSrc
@@ -19,13 +32,20 @@ typedef struct OwnerSrc
 
 struct buffer
 {
-    PageId* bufferPageId;
-    int pin_count;
-    int flagdirty;
+    PageId bufferPageId; // FileIdx is -1 if the frame is empty
+    int pin_count; // Atomic, only incremented under the shard lock of bufferPageId so an eviction can check it
+    int flagdirty; // Atomic, changed under the shard lock of bufferPageId
+    int io_pending; // Atomic, BUFFER_IO_ASYNC or BUFFER_IO_READ while content is read, the frame is pinned until then
+    int ring_owned; // loaded through a BufferAccessStrategy and not accessed normally since, its ring may recycle it
+    int prefetched; // read ahead and not requested yet, its first GetPage is a miss
+    int arc_list; // ARC list of the frame: 0 empty, 1 T1 (recent pages), 2 T2 (frequent pages)
     uint8_t *content;
+    pthread_rwlock_t latch; // Protects content between threads that pinned the page, see LatchBuffer()
 
+#ifdef BUFFER_TRACK_OWNERS // Debug only, every pin reallocs this array
     size_t nb_owners;
-    OwnerSrc *owners;
+    OwnerSrc *owners; // Source location of each current pin
+#endif
 
     buffer* next;
     buffer* prev;
@@ -33,26 +53,137 @@ struct buffer
 
 
 
+typedef struct BufferStats
+/*
+*   Counters of one replacement policy, updated while it is the current policy
+*/
+{
+    size_t hits; // GetPage served from a frame
+    size_t misses; // GetPage that read the page (a prefetched page counts as a miss)
+    size_t evictions; // Pages replaced in a frame
+    size_t writebacks; // Victims that were dirty, written before their eviction
+} BufferStats;
+
+typedef struct ArcGhost
+/*
+*   Page recently evicted by ARC, linked in B1 or B2 from the most to the least recent
+*/
+{
+    PageId pageId;
+    int list; // 1 for B1, 2 for B2, 0 if the entry is free
+    int prev;
+    int next;
+} ArcGhost;
+
+typedef struct PageTableShard
+{
+    pthread_mutex_t lock;
+    PageTable *table;
+} PageTableShard;
+
 typedef struct BufferManager
 /*
 *   bufferManager data
 */
 {
-    buffer* bufferHead; // Call Config->dm_buffercount for init
+    buffer* frames; // The Config->dm_buffercount frames, bufferHead to bufferTail links them in LRU/MRU order
+    buffer* bufferHead;
     buffer* bufferTail;
+    PageTableShard shards[BUFFER_PAGE_TABLE_SHARDS]; // PageId -> index in frames, of every page in a frame
+
+    uint8_t *arena; // Contents of all the frames, page aligned, frames[i].content is arena + i * pagesize
+    uint8_t *referenced; // CLOCK reference bit of each frame, set on every access. With the other policies, the
+                         // TOUCH_ACCESS and TOUCH_PROMOTE flags of the hits that didn't take lock
+    int touchesPending; // Set once an access is left in referenced, see apply_touches()
+    size_t clockHand; // Next frame examined by CLOCK
+
+    buffer *prefetching[BUFFER_PREFETCH_MAX]; // Frames with io_pending BUFFER_IO_ASYNC
+    size_t nb_prefetching;
+
+    PageId seqNext; // Page following the last miss on disk, a miss on it continues the sequential run
+    size_t seqRun; // Consecutive misses in disk order
+    PageId seqAdvised; // First page not read ahead yet, valid while nb_seqAdvised > 0, FileIdx is -1 past the last file
+    size_t nb_seqAdvised; // Pages read ahead of seqNext
+
+    size_t arcSize[3]; // Number of frames of each arc_list
+    size_t arcTarget; // ARC adaptive target size of T1
+    ArcGhost *ghosts; // dm_buffercount entries, B1 and B2 never hold more pages than the frames
+    PageTable *ghostTable; // PageId -> index in ghosts
+    int ghostHead[3]; // Most recent entry of B1 and B2, -1 if empty
+    int ghostTail[3];
+    size_t ghostSize[3];
+    int ghostFree; // Free entries of ghosts, linked by next
+
+    BufferStats stats[POLICY_ARC + 1]; // Indexed by Policy
+
+    pthread_mutex_t lock; // Recursive, guards the replacement state, the asynchronous I/O and the background writer, never held
+                          // across a synchronous read or write
+    pthread_mutex_t readLock; // For the condition only
+    pthread_cond_t readDone; // Broadcast when a frame leaves BUFFER_IO_READ
+    size_t nb_dirty; // Frames with flagdirty set
+    uint64_t *dirtyMap; // Bit i is set iff frames[i].flagdirty, checkpoints only visit these frames
+
+    pthread_t bgwriter; // Writes dirty unpinned frames ahead of their eviction, see config->dm_bgwriter_delay
+    int bgwriterRunning;
+    pthread_mutex_t bgwriterLock; // Not recursive, for the conditions: guards bgwriterStop and nb_bgwriting, taken after lock
+    int bgwriterStop;
+    pthread_cond_t bgwriterWake; // Signaled when the dirty frames exceed config->dm_dirty_ratio
+    pthread_cond_t bgwriterDone; // Broadcast once the pages of a round are written
+    size_t bgwriterMaxPages; // config->dm_bgwriter_maxpages, clamped to [1, dm_buffercount]
+    uint8_t *bgwriterCopies; // Copies of the pages of the current round, written without holding lock
+    PageId *bgwriterIds; // Changed with lock held while nb_bgwriting is 0
+    size_t nb_bgwriting; // Pages of bgwriterIds being written, set with both locks held, cleared with bgwriterLock
 } BufferManager;
 
+typedef enum BufferLatchMode
+{
+    BUFFER_LATCH_SHARED,
+    BUFFER_LATCH_EXCLUSIVE,
+} BufferLatchMode;
+
+typedef enum BufferAccessStrategyType
+{
+    BAS_NORMAL, // No ring, the replacement policy is used
+    BAS_BULKREAD, // Sequential scan
+    BAS_BULKWRITE, // Bulk insertion
+} BufferAccessStrategyType;
+
+struct BufferAccessStrategy
+/*
+*   Private ring of frames of one operation, its misses recycle the ring instead of evicting the rest of the pool
+*/
+{
+    BufferAccessStrategyType type;
+    size_t size; // Number of slots of ring, 0 for BAS_NORMAL
+    size_t current; // Slot used by the last miss
+    int *ring; // Frame indices, -1 while a slot isn't used
+    size_t advised; // Pages following the last PrefetchPages() hinted to the kernel, the list is read in order
+};
+
 extern BufferManager *bufferManager;
 
 ////
 void constructBufferManager();
 void clearBufferManager();
 uint8_t *__GetPage(PageId *pageId, const char *function, const char *filename, size_t line);
+uint8_t *__GetPageStrategy(PageId *pageId, BufferAccessStrategy *strategy, const char *function, const char *filename, size_t line);
 void __FreePage(PageId *pageId, int valdirty, const char *function, const char *filename, size_t line);
 void SetCurrentReplacementPolicy (Policy);
 void FlushBuffers();
+size_t CheckpointBuffers();
+void LatchBuffer(const uint8_t *content, BufferLatchMode mode);
+void UnlatchBuffer(const uint8_t *content);
+BufferStats GetBufferStats(Policy policy);
+void ResetBufferStats();
+#ifdef BUFFER_PIN_TRACE
+void PrintPinTrace(size_t count);
+#endif
+size_t PrefetchPages(PageId **pageIds, size_t count, BufferAccessStrategy *strategy);
+BufferAccessStrategy *GetAccessStrategy(BufferAccessStrategyType type);
+void FreeAccessStrategy(BufferAccessStrategy *strategy);
 
 #define GetPage(pageId) __GetPage(pageId, __PRETTY_FUNCTION__, __FILE__, __LINE__)
+#define GetPageStrategy(pageId, strategy) __GetPageStrategy(pageId, strategy, __PRETTY_FUNCTION__, __FILE__, __LINE__)
 #define FreePage(pageId, valdirty) __FreePage(pageId, valdirty, __PRETTY_FUNCTION__, __FILE__, __LINE__)
 
 #ifdef __cplusplus
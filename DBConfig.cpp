@@ -1,5 +1,6 @@
 #include "DBConfig.h"
 
+#include <algorithm>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
@@ -31,8 +32,17 @@ static void initDBConfig()
 	config->dbpath = dup_str((fs::current_path() / "BDD Stack").string());
 	config->dm_buffercount = 5;
 	config->dm_policy = POLICY_LRU;
+	config->dm_io_backend = IO_BACKEND_MMAP;
+	config->dm_bgwriter_delay = 200;
+	config->dm_bgwriter_maxpages = 100;
+	config->dm_dirty_ratio = 0.1;
+	config->dm_query_memory = (size_t)16 << 20;
+	config->dm_result_format = RESULT_TEXT;
 	config->pagesize = getpagesize(); // System-wide page size (used for best performance mmap)
 	config->dm_maxfilesize = config->pagesize * 3;
+	config->dm_growthfactor = 2;
+	config->dm_maxsegmentsize = (size_t)64 << 20;
+	config->need_init = 1; // Cleared by LoadState() when a dm.save exists
 }
 
 void LoadDBConfig(const char* fichier_config)
@@ -67,8 +77,20 @@ void LoadDBConfig(const char* fichier_config)
 			config->pagesize = std::stoi(value);
 		else if (prop == "dm_maxfilesize")
 			config->dm_maxfilesize = std::stoi(value);
+		else if (prop == "dm_growthfactor")
+			config->dm_growthfactor = std::stod(value);
+		else if (prop == "dm_maxsegmentsize")
+			config->dm_maxsegmentsize = std::stoull(value);
 		else if (prop == "dm_buffercount")
 			config->dm_buffercount = std::stoi(value);
+		else if (prop == "dm_bgwriter_delay")
+			config->dm_bgwriter_delay = std::stoi(value);
+		else if (prop == "dm_bgwriter_maxpages")
+			config->dm_bgwriter_maxpages = std::stoi(value);
+		else if (prop == "dm_dirty_ratio")
+			config->dm_dirty_ratio = std::stod(value);
+		else if (prop == "dm_query_memory")
+			config->dm_query_memory = std::stoull(value);
 		else if (prop == "dm_policy")
 		{
 			std::ranges::transform(value, value.begin(), ::toupper);
@@ -76,6 +98,34 @@ void LoadDBConfig(const char* fichier_config)
 				config->dm_policy = POLICY_LRU;
 			else if (value == "MRU")
 				config->dm_policy = POLICY_MRU;
+			else if (value == "CLOCK")
+				config->dm_policy = POLICY_CLOCK;
+			else if (value == "ARC")
+				config->dm_policy = POLICY_ARC;
+			else
+				throw std::invalid_argument("invalid input format: " + line + " (" + std::to_string(ln) + ")");
+		}
+		else if (prop == "dm_io_backend")
+		{
+			std::ranges::transform(value, value.begin(), ::toupper);
+			if (value == "MMAP")
+				config->dm_io_backend = IO_BACKEND_MMAP;
+			else if (value == "PREAD")
+				config->dm_io_backend = IO_BACKEND_PREAD;
+			else if (value == "URING" || value == "IO_URING")
+				config->dm_io_backend = IO_BACKEND_URING;
+			else
+				throw std::invalid_argument("invalid input format: " + line + " (" + std::to_string(ln) + ")");
+		}
+		else if (prop == "dm_result_format")
+		{
+			std::ranges::transform(value, value.begin(), ::toupper);
+			if (value == "TEXT")
+				config->dm_result_format = RESULT_TEXT;
+			else if (value == "TSV")
+				config->dm_result_format = RESULT_TSV;
+			else if (value == "BINARY")
+				config->dm_result_format = RESULT_BINARY;
 			else
 				throw std::invalid_argument("invalid input format: " + line + " (" + std::to_string(ln) + ")");
 		}
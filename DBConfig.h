@@ -2,6 +2,7 @@
 #define SHINBDDA_DBCONFIG_H
 
 #include "Structures.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -11,8 +12,22 @@ extern "C" {
 typedef enum Policy {
     POLICY_MRU,
     POLICY_LRU,
+    POLICY_CLOCK,
+    POLICY_ARC,
 } Policy;
 
+typedef enum IOBackend {
+    IO_BACKEND_MMAP,
+    IO_BACKEND_PREAD,
+    IO_BACKEND_URING,
+} IOBackend;
+
+typedef enum ResultFormat {
+    RESULT_TEXT,
+    RESULT_TSV,
+    RESULT_BINARY,
+} ResultFormat;
+
 typedef struct DBConfig
 /*
 *   Configurations data
@@ -20,9 +35,17 @@ typedef struct DBConfig
 {
     char* dbpath; // Le dossier BDD Stack //A MALLOC
     int pagesize;// Tailles d'une page
-    int dm_maxfilesize; // Tailles Max d'un fichier rsdb
+    int dm_maxfilesize; // Taille initiale d'un fichier rsdb
+    double dm_growthfactor; // The last file grows by this factor when every page is allocated, 1 or less creates a new file instead
+    size_t dm_maxsegmentsize; // Files stop growing at this size, a new one of dm_maxfilesize is then created
     int dm_buffercount; // Number of BufferManager to manage
-    Policy dm_policy; // Replacement policy(LRU or MRU)
+    Policy dm_policy; // Replacement policy(LRU, MRU, CLOCK or ARC)
+    IOBackend dm_io_backend; // Page I/O backend(MMAP, PREAD or URING)
+    int dm_bgwriter_delay; // Milliseconds between two rounds of the background writer, 0 disables it
+    int dm_bgwriter_maxpages; // Max dirty frames written by one round
+    double dm_dirty_ratio; // Fraction of dirty frames the background writer aims to stay under
+    size_t dm_query_memory; // Estimated bytes the operators of a query can hold at once, the query is refused beyond
+    ResultFormat dm_result_format; // Output of the rows of a SELECT(TEXT, TSV or BINARY)
     uint8_t need_init; // If it needs Initialisation of if it reads saved state.
 } DBConfig;
 
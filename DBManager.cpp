@@ -3,6 +3,7 @@
 #include "BufferManager.h"
 
 
+#include <algorithm>
 #include <cassert> // assert.h but in C++ style
 #include <cstring> // string.h but in C++ style
 #include <filesystem>
@@ -16,6 +17,8 @@
 
 namespace fs = std::filesystem;
 
+#define INDEX_SAVE_MAGIC 0x3158444e49ULL // "INDX1", marks the indexes section of databases.save
+
 // Overload of operator==
 bool operator==(const Relation &r1, const Relation &r2)
 {
@@ -26,6 +29,9 @@ void RelationDestructor::operator()(Relation* r) const noexcept
 {
 	if (destroy)
 	{
+		while (r->nb_indexes)
+			DropRelationIndex(r, r->indexes[0].name);
+
 		auto* lst = getDataPages(r);
 
 		for (size_t i = 0; i < lst->length; i++)
@@ -179,6 +185,20 @@ void DBManager::RemoveTablesFromCurrentDatabase() const
 }
 
 
+// Table of the index of this name in the current database, nullptr if there's none
+DBManager::RelationPtr DBManager::GetIndexTableFromCurrentDatabase(const std::string &name) const
+{
+	if (selected_db == dbs.end())
+		return nullptr;
+
+	for (const RelationPtr &rel : *selected_db->second)
+		for (int i = 0; i < rel->nb_indexes; i++)
+			if (rel->indexes[i].name == name)
+				return rel;
+
+	return nullptr;
+}
+
 DBManager::Database::iterator DBManager::find_relation(const std::string &name)
 {
 	auto pred = [name](const RelationPtr &rel)
@@ -243,6 +263,9 @@ void DBManager::LoadState()
 			rel->headHdrPageId = FindPageId(page_id);
 			ifs.read(reinterpret_cast<char *>(&page_id), sizeof(page_id));
 			rel->tailHdrPageId = FindPageId(page_id);
+			rel->fsm = nullptr; // Rebuilt from the header pages on the first insertion
+			rel->indexes = nullptr; // Read after the databases
+			rel->nb_indexes = 0;
 
 			ifs.read(reinterpret_cast<char *>(&len), sizeof(len));
 			name.assign(len, '\0');
@@ -267,9 +290,54 @@ void DBManager::LoadState()
 				ifs.read(reinterpret_cast<char *>(&meta->len), sizeof(meta->len));
 			}
 
-			assert(cur_db.emplace(rel).second);
+			// The set compares pointers, two relations of the same name would both be kept
+			if (std::ranges::any_of(cur_db, [&rel](const RelationPtr &r) { return strcmp(r->name, rel->name) == 0; }))
+			{
+				std::cerr << "error: database " << dbs_emplace_res.first->first << ": relation " << rel->name
+					<< " is saved twice, only the first one is kept" << std::endl;
+				continue;
+			}
+			cur_db.emplace(rel);
 		}
 	}
+
+	// The indexes follow the databases, a save made before indexes existed stops here
+	uint64_t magic;
+	if (!ifs.read(reinterpret_cast<char *>(&magic), sizeof(magic)) || magic != INDEX_SAVE_MAGIC)
+		return;
+
+	size_t nb_indexes;
+	ifs.read(reinterpret_cast<char *>(&nb_indexes), sizeof(nb_indexes));
+	for (size_t i = 0; i < nb_indexes && ifs; i++)
+	{
+		ssize_t len;
+		std::string db_name, rel_name, name;
+		ifs.read(reinterpret_cast<char *>(&len), sizeof(len));
+		db_name.resize(len);
+		ifs.read(db_name.data(), len);
+		ifs.read(reinterpret_cast<char *>(&len), sizeof(len));
+		rel_name.resize(len);
+		ifs.read(rel_name.data(), len);
+		ifs.read(reinterpret_cast<char *>(&len), sizeof(len));
+		name.resize(len);
+		ifs.read(name.data(), len);
+
+		IndexKind kind;
+		int col;
+		PageId meta_page_id;
+		ifs.read(reinterpret_cast<char *>(&kind), sizeof(kind));
+		ifs.read(reinterpret_cast<char *>(&col), sizeof(col));
+		ifs.read(reinterpret_cast<char *>(&meta_page_id), sizeof(meta_page_id));
+		if (!ifs)
+			break;
+
+		const auto db = dbs.find(db_name);
+		if (db == dbs.end())
+			continue;
+		const auto rel = std::ranges::find_if(*db->second, [&rel_name](const RelationPtr &r) { return r->name == rel_name; });
+		if (rel != db->second->end())
+			AddRelationIndex(rel->get(), name.c_str(), kind, col, FindPageId(meta_page_id));
+	}
 }
 
 void DBManager::SaveState() const
@@ -322,6 +390,37 @@ void DBManager::SaveState() const
 		}
 	}
 
+	// After the databases, so that a save without indexes keeps its format
+	const uint64_t magic = INDEX_SAVE_MAGIC;
+	ofs.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+
+	len = 0;
+	for (const auto &db : dbs | std::views::values)
+		for (const auto &relPtr : *db)
+			len += relPtr->nb_indexes;
+	ofs.write(reinterpret_cast<const char *>(&len), sizeof(len));
+
+	for (const auto &[name, db] : dbs)
+	{
+		for (const auto &relPtr : *db)
+		{
+			for (int i = 0; i < relPtr->nb_indexes; i++)
+			{
+				const RelationIndex *index = relPtr->indexes + i;
+				for (const char *str : {name.c_str(), relPtr->name, static_cast<const char *>(index->name)})
+				{
+					len = strlen(str);
+					ofs.write(reinterpret_cast<const char *>(&len), sizeof(len));
+					ofs.write(str, static_cast<ssize_t>(len));
+				}
+
+				ofs.write(reinterpret_cast<const char *>(&index->kind), sizeof(index->kind));
+				ofs.write(reinterpret_cast<const char *>(&index->col), sizeof(index->col));
+				ofs.write(reinterpret_cast<const char *>(index->metaPageId), sizeof(*index->metaPageId));
+			}
+		}
+	}
+
 	ofs.flush();
 	ofs.close();
 }
@@ -62,6 +62,7 @@ public:
 	RelationPtr GetTableFromCurrentDatabase (const std::string &name) const;
 	void RemoveTableFromCurrentDatabase(const std::string &name) const;
 	void RemoveTablesFromCurrentDatabase() const;
+	RelationPtr GetIndexTableFromCurrentDatabase(const std::string &name) const;
 
 	void LoadState();
 	void SaveState() const;
@@ -9,37 +9,278 @@
 #include "DBConfig.h"
 #include "PageId.h"
 #include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <limits.h>
+#include <dirent.h>
+
+#define DM_SAVE_MAGIC 0x32534D44 // "DMS2", dm.save holds free-space bitmaps
 
 static PageIdList* pageidlist;
+// Page I/O takes no lock: the fd and the mapping of a file never change once opened, the allocator orders
+// the growth of a file before any access to its new pages
+static pthread_rwlock_t spacesLock = PTHREAD_RWLOCK_INITIALIZER; // Guards spaces and pageidlist, written by the allocation
+static pthread_rwlock_t filesLock = PTHREAD_RWLOCK_INITIALIZER; // Guards mappings, written to open, map or grow a file
 DiskManager* diskManager;
 int defaultnumberoffiles = 3;
 
-static int count_page_id(PageId **ids, int size)
+static void uringClose();
+static int getFile(int fileIdx, DiskFileMapping* file);
+
+static DiskFileSpace* getFileSpace(int fileIdx)
 /*
 * Includes:
-*   <stddef.h> [NULL]
+*   <stdio.h> [perror()]
+*   <stdlib.h> [realloc()]
 *
-*   "PageId.h" [PageId]
-*   "DiskManager.h" [DiskManager]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
 * Params:
-*   PageId **ids = The Array of PageIds.
-*   int size = The size of the array of PageIds.
+*   int fileIdx = The index x of the Fx.rsdb file.
 * Return:
-*   int => Returns the size of not NULL Elements of the array
+*   DiskFileSpace* => Returns the free-space entry of the file, its pages are NULL if it isn't registered.
+*   NULL => There's been an error.
 * Description:
-*   This function returns the number of not NULL elements of an array.
+*   This function returns the entry of spaces for fileIdx, growing spaces if needed.
 * Malloc:
-*   None.
+*   None, diskFREE() manages it.
 * Notes:
 *   None.
 */
 {
-    int nb = 0;
+    if (fileIdx < 0)
+        return NULL;
+
+    if (fileIdx >= diskManager->nb_spaces)
+    {
+        int nb_spaces = fileIdx + 1 > 2 * diskManager->nb_spaces ? fileIdx + 1 : 2 * diskManager->nb_spaces;
+        DiskFileSpace* tmp = realloc(diskManager->spaces, nb_spaces * sizeof *tmp);
+        if (tmp == NULL)
+        {
+            perror("Memory reallocation failed for spaces");
+            return NULL;
+        }
+        memset(tmp + diskManager->nb_spaces, 0, (nb_spaces - diskManager->nb_spaces) * sizeof *tmp);
+        diskManager->spaces = tmp;
+        diskManager->nb_spaces = nb_spaces;
+    }
+
+    return diskManager->spaces + fileIdx;
+}
+
+static void registerPages(int from)
+/*
+* Includes:
+*   <stdio.h> [perror()]
+*   <stdlib.h> [calloc(); malloc(); abort()]
+*
+*   "PageId.h" [PageIdList; PageId]
+*   "DiskManager.h" [DiskFileSpace; getFileSpace()]
+* Params:
+*   int from = Index in pageidlist->list of the first PageId to register.
+* Return:
+*   None.
+* Description:
+*   This function gives a free-space entry to each file of the PageIds pageidlist->list[from..size[, all their pages are free.
+*   The PageIds of a file are consecutive in pageidlist, as InitiatiateTables() and addTable() create them.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   Allocated pages are then marked with markPage().
+*/
+{
+    int i = from;
+    while (i < pageidlist->size)
+    {
+        const int fileIdx = pageidlist->list[i]->FileIdx;
+        int nb_pages = 0;
+        for (int j = i; j < pageidlist->size && pageidlist->list[j]->FileIdx == fileIdx; j++)
+            if (pageidlist->list[j]->PageIdx + 1 > nb_pages)
+                nb_pages = pageidlist->list[j]->PageIdx + 1;
+
+        DiskFileSpace* space = getFileSpace(fileIdx);
+        if (space == NULL)
+            abort();
+        space->pages = calloc(nb_pages, sizeof *space->pages);
+        space->used = calloc((nb_pages + 63) / 64, sizeof *space->used);
+        if (space->pages == NULL || space->used == NULL)
+        {
+            perror("Memory allocation failed for the free-space bitmap");
+            abort();
+        }
+        space->nb_pages = nb_pages;
+        space->nb_free = 0;
+        space->freeWord = 0;
+
+        for (; i < pageidlist->size && pageidlist->list[i]->FileIdx == fileIdx; i++)
+        {
+            space->pages[pageidlist->list[i]->PageIdx] = pageidlist->list[i];
+            space->nb_free++;
+        }
+        if (fileIdx < diskManager->freeHint)
+            diskManager->freeHint = fileIdx;
+    }
+}
+
+static void markPage(DiskFileSpace* space, int pageIdx)
+// Marks a free page of the file allocated.
+{
+    space->used[pageIdx / 64] |= (uint64_t)1 << (pageIdx % 64);
+    space->nb_free--;
+}
+
+static PageId* takeFreePage(DiskFileSpace* space)
+// Allocates the first free page of a file that has one, words before freeWord are full.
+{
+    int w = space->freeWord;
+    while (~space->used[w] == 0)
+        w++;
+    space->freeWord = w;
+
+    const int pageIdx = w * 64 + __builtin_ctzll(~space->used[w]);
+    markPage(space, pageIdx);
+    return space->pages[pageIdx];
+}
+
+static int firstFreeFile()
+// Index of the first file with a free page, diskManager->nb_spaces if there's none.
+{
+    int f = diskManager->freeHint;
+    while (f < diskManager->nb_spaces && diskManager->spaces[f].nb_free == 0)
+        f++;
+    diskManager->freeHint = f;
+    return f;
+}
+
+static int extendFile(int fileIdx, int nb_pages)
+/*
+* Includes:
+*   <stdio.h> [perror()]
+*   <stdlib.h> [realloc()]
+*   <string.h> [memset()]
+*
+*   "PageId.h" [PageId; appendPageId()]
+*   "Tools_L.h" [preallocateFile()]
+*   "DiskManager.h" [DiskFileSpace; getFile()]
+* Params:
+*   int fileIdx = A registered file.
+*   int nb_pages = The number of pages of the file after the call, more than it has.
+* Return:
+*   0 => Success.
+*   -1 => There's been an error, the file is unchanged.
+* Description:
+*   This function grows the file in place and registers its new pages as free.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   spacesLock is held for writing.
+*   A mapped file grows into the address range reserved by getFileMapping(), only its length changes.
+*/
+{
+    DiskFileSpace* space = diskManager->spaces + fileIdx;
+    DiskFileMapping file;
+    if (getFile(fileIdx, &file) == -1 || preallocateFile(file.fd, (off_t)nb_pages * config->pagesize) == -1)
+    {
+        perror("Error growing file in extendFile");
+        return -1;
+    }
+
+    PageId** pages = realloc(space->pages, nb_pages * sizeof *pages);
+    if (pages == NULL)
+    {
+        perror("Memory reallocation failed for the free-space bitmap");
+        abort();
+    }
+    space->pages = pages;
+    const int words = (space->nb_pages + 63) / 64, new_words = (nb_pages + 63) / 64;
+    uint64_t* used = realloc(space->used, new_words * sizeof *used);
+    if (used == NULL)
+    {
+        perror("Memory reallocation failed for the free-space bitmap");
+        abort();
+    }
+    memset(used + words, 0, (new_words - words) * sizeof *used);
+    space->used = used;
+
+    for (int i = space->nb_pages; i < nb_pages; i++)
+    {
+        space->pages[i] = appendPageId(pageidlist, fileIdx, i);
+        if (space->pages[i] == NULL)
+            abort();
+    }
+    pthread_rwlock_wrlock(&filesLock);
+    if (diskManager->mappings[fileIdx].addr != NULL)
+        diskManager->mappings[fileIdx].length = (size_t)nb_pages * config->pagesize;
+    pthread_rwlock_unlock(&filesLock);
+    space->nb_free += nb_pages - space->nb_pages;
+    space->nb_pages = nb_pages;
+    if (fileIdx < diskManager->freeHint)
+        diskManager->freeHint = fileIdx;
+    return 0;
+}
+
+static size_t maxFileBytes()
+// Size files stop growing at, the largest of config->dm_maxsegmentsize and config->dm_maxfilesize.
+{
+    size_t max_bytes = config->dm_maxsegmentsize;
+    if (max_bytes < (size_t)config->dm_maxfilesize)
+        max_bytes = config->dm_maxfilesize;
+    if (max_bytes > (size_t)INT_MAX * config->pagesize)
+        max_bytes = (size_t)INT_MAX * config->pagesize;
+    return max_bytes;
+}
+
+static int growFiles(int min_pages)
+/*
+* Includes:
+*   "PageId.h" [PageId; addTable()]
+*   "DBConfig.h" [DBConfig]
+*   "DiskManager.h" [DiskManager; DiskFileSpace; extendFile(); registerPages()]
+* Params:
+*   int min_pages = The number of consecutive free pages needed.
+* Return:
+*   int => Returns the FileIdx of the file that has min_pages consecutive free pages at its end.
+*   -1 => There's been an error, or min_pages is more than a file can hold.
+* Description:
+*   This function makes room when every page is allocated.
+*   The last file grows by config->dm_growthfactor up to config->dm_maxsegmentsize, so a bulk load extends a few large
+*   files instead of creating many small ones. Once it is full, a new file of config->dm_maxfilesize is created.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   With a dm_growthfactor of 1 or less, files keep their initial size.
+*/
+{
+    const int max_pages = (int)(maxFileBytes() / config->pagesize);
+    if (min_pages > max_pages)
+        return -1;
 
-    for (int i = 0; i < size; i++)
-        nb += ids[i] != NULL;
+    int last = diskManager->nb_spaces - 1;
+    while (last >= 0 && diskManager->spaces[last].pages == NULL)
+        last--;
+    if (last != -1 && config->dm_growthfactor > 1)
+    {
+        const int nb_pages = diskManager->spaces[last].nb_pages;
+        double target = nb_pages * config->dm_growthfactor;
+        if (target < nb_pages + min_pages)
+            target = nb_pages + min_pages;
+        if (target > max_pages)
+            target = max_pages;
+        if ((int)target - nb_pages >= min_pages && extendFile(last, (int)target) == 0)
+            return last;
+    }
 
-    return nb;
+    int nb_pages = config->dm_maxfilesize / config->pagesize;
+    if (nb_pages < min_pages)
+        nb_pages = min_pages;
+    const int from = pageidlist->size;
+    PageId* first = addTable(config->dbpath,nb_pages * config->pagesize,config->pagesize,1,pageidlist);
+    if (first == NULL)
+        return -1;
+    registerPages(from);
+    return first->FileIdx;
 }
 
 int diskInit()
@@ -58,8 +299,7 @@ int diskInit()
 *   int
 *      0 = Flawless execution of saved state.
 *      1 = Flawless execution of the Init.
-*      -3 = Failed diskManager->allocated malloc().
-*      -4 = Failed diskManager->desalocated malloc().
+*      -3 = Failed InitiatiateTables().
 * Description:
 *   This function Initiates diskManager using DBConfig* configfile.
 *   It is stored as a static value, this function shall be called the soonest possible in the main to Initiate diskManager.
@@ -77,6 +317,13 @@ int diskInit()
         return -2;
     }
     diskManager->config=config;
+    diskManager->mappings=NULL;
+    diskManager->nb_mappings=0;
+    diskManager->io=GetIOBackend(config->dm_io_backend);
+
+    diskManager->spaces=NULL;
+    diskManager->nb_spaces=0;
+    diskManager->freeHint=0;
 
     //Checks saved state, If no save.dm, launch an init.
     LoadState();
@@ -87,35 +334,18 @@ int diskInit()
 
     //Init
     pageidlist = InitiatiateTables(config->dbpath,config->dm_maxfilesize,config->pagesize,defaultnumberoffiles);
-    diskManager->allocated = (PageId**) malloc(pageidlist->size*sizeof(PageId*));
-    if (diskManager->allocated == NULL)
+    if (pageidlist == NULL)
     {
-        perror("Memory allocation failed for allocated");
+        // No page to hand out, AllocPage() retries creating a file with addTable()
+        pageidlist = calloc(1, sizeof *pageidlist);
+        if (pageidlist == NULL)
+        {
+            perror("Memory allocation failed for PageIdList");
+            abort();
+        }
         return -3;
     }
-    diskManager->desalocated = (PageId**) malloc(pageidlist->size*sizeof(PageId*));
-    if (diskManager->desalocated == NULL)
-    {
-        perror("Memory allocation failed for desalocated");
-        free(diskManager->allocated);
-        return -4;
-    }
-    diskManager->size=pageidlist->size;
-    for (int i = 0; i < diskManager->size; i++)
-    {
-        diskManager->allocated[i]=NULL;
-    }
-    for (int i = diskManager->size - 1, j=0; i >= 0; i--,j++)//Met la liste a l'envers pour la LIFO
-    {
-
-        diskManager->desalocated[j]=pageidlist->list[i];
-    }
-    //
-//    DiskManager* disk =diskManager;
-//    printf("Élément %d : FileIdx = %d, PageIdx = %d\n",4,disk->desalocated[4]->FileIdx,disk->desalocated[4]->PageIdx);
-//    printf("Élément %d : FileIdx = %d, PageIdx = %d\n",5,disk->desalocated[5]->FileIdx,disk->desalocated[5]->PageIdx);
-//    printf("Élément %d : FileIdx = %d, PageIdx = %d\n",6,disk->desalocated[6]->FileIdx,disk->desalocated[6]->PageIdx);
-    //
+    registerPages(0);
     return 1;
 }
 
@@ -136,6 +366,7 @@ int diskFREE()
 * Description:
 *   This function free
 *      pageidlist
+*      the opened files(CloseFiles())
 *      diskManager
 * Malloc:
 *   Has to be called to free pageidlist and diskManager
@@ -152,8 +383,14 @@ int diskFREE()
     }
     free(pageidlist->list);
     free(pageidlist);
-    free(diskManager->allocated);
-    free(diskManager->desalocated);
+    pageidlist = NULL;
+    CloseFiles();
+    for (int i = 0; i < diskManager->nb_spaces; i++)
+    {
+        free(diskManager->spaces[i].pages);
+        free(diskManager->spaces[i].used);
+    }
+    free(diskManager->spaces);
     free(diskManager);
     return 0;
 }
@@ -165,365 +402,1572 @@ PageId* AllocPage()
 *
 *   "PageId.h" [PageIdList; PageId; addTable()]
 *   "DBConfig.h" [DBConfig]
-*   "DiskManager.h" [DiskManager]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
 * Params:
 *   None.
 * Return:
 *   PageId* => Returns the Allocated PageId.
+*   NULL => There's been an error.
 * Description:
 *   This function Alloc a PageId and returns it.
- *   This stored allocated pages in NeodiskManager->allocated and the others in NeodiskManager->desalocated
- *   When there is no more PageId to yield, creates a new file and PageId.
+*   The first free page of the first file that has one is taken, so pages are allocated in disk order.
+*   When there is no more PageId to yield, the files grow with growFiles().
 * Malloc:
 *   Nothing to free, carefully. diskFREE() Manages it.
 * Notes:
-*   Uses LIFO.
+*   Amortized O(1): the files and bitmap words known to be full are skipped.
 */
 {
-    //Reasign
-    DiskManager* NeodiskManager = diskManager;
-    PageId* pageId=NULL;
-    //Check if there's page avalaible
-    int i = NeodiskManager->size - 1;
-    while (i >= 0 && NeodiskManager->desalocated[i] == NULL)
+    pthread_rwlock_wrlock(&spacesLock);
+    int f = firstFreeFile();
+    if (f == diskManager->nb_spaces)
+        f = growFiles(1);
+
+    PageId* pageId = f == -1 ? NULL : takeFreePage(diskManager->spaces + f);
+    pthread_rwlock_unlock(&spacesLock);
+    return pageId;
+}
+
+static int findFreeRun(const DiskFileSpace* space, int count)
+// First page of a run of count free pages of the file, -1 if there's none.
+{
+    int run = 0;
+    for (int i = space->freeWord * 64; i < space->nb_pages; i++)
+    {
+        if (space->used[i / 64] & (uint64_t)1 << (i % 64))
+            run = 0;
+        else if (++run == count)
+            return i - count + 1;
+    }
+    return -1;
+}
+
+static void freePage(PageId* pageid)
+// DeallocPage() with spacesLock held for writing.
+{
+    DiskFileSpace* space = pageid->FileIdx >= 0 && pageid->FileIdx < diskManager->nb_spaces ? diskManager->spaces + pageid->FileIdx : NULL;
+    const int w = pageid->PageIdx / 64;
+    const uint64_t bit = (uint64_t)1 << (pageid->PageIdx % 64);
+    if (space == NULL || pageid->PageIdx < 0 || pageid->PageIdx >= space->nb_pages || !(space->used[w] & bit))
+    {
+        fprintf(stderr, "error: DeallocPage: page (%d, %d) isn't allocated\n", pageid->FileIdx, pageid->PageIdx);
+        return;
+    }
+
+    space->used[w] &= ~bit;
+    space->nb_free++;
+    if (w < space->freeWord)
+        space->freeWord = w;
+    if (pageid->FileIdx < diskManager->freeHint)
+        diskManager->freeHint = pageid->FileIdx;
+}
+
+static int allocRun(PageId** pageids, int count)
+// Allocates a run of count consecutive free pages of a same file, 0 if no file can hold it.
+{
+    int f = diskManager->freeHint;
+    int start = -1;
+    for (; f < diskManager->nb_spaces; f++)
+    {
+        if (diskManager->spaces[f].nb_free >= count && (start = findFreeRun(diskManager->spaces + f, count)) != -1)
+            break;
+    }
+    if (start == -1)
     {
-        i--;
+        f = growFiles(count);
+        start = f == -1 ? -1 : findFreeRun(diskManager->spaces + f, count);
     }
-    //No page avalaible case
-    //Tout est NULL[Donc allocated est FULL & desalocated est VIDE] ajotuer une page et retourner cette page
-    if(i==-1)
+    if (start == -1)
+        return 0;
+
+    DiskFileSpace* space = diskManager->spaces + f;
+    for (int i = 0; i < count; i++)
     {
-        //Ajout de la table, on augmente la taille de Diskmanager size
-        return addTable(config->dbpath,config->dm_maxfilesize,config->pagesize,1,pageidlist,NeodiskManager);
+        markPage(space, start + i);
+        pageids[i] = space->pages[start + i];
     }
+    return count;
+}
+
+int AllocPages(PageId** pageids, int count)
+/*
+* Includes:
+*   "PageId.h" [PageId]
+*   "DBConfig.h" [DBConfig]
+*   "DiskManager.h" [DiskManager; DiskFileSpace; allocRun(); maxFileBytes()]
+* Params:
+*   PageId** pageids = Filled with the count allocated PageIds.
+*   int count = The number of pages to allocate.
+* Return:
+*   int => count if the pages are allocated, 0 otherwise and none is allocated.
+* Description:
+*   This function allocates count consecutive pages of a same file, so a bulk load can read and write them in one I/O.
+*   The files are searched in order for a run of free pages, the files grow with growFiles() if none has one.
+*   More pages than a file can hold (maxFileBytes()) are allocated as several runs, each filling a file.
+* Malloc:
+*   Nothing to free, carefully. diskFREE() Manages it.
+* Notes:
+*   BTreeBuild(), HashIndexBuild() and the bulk inserts of InsertRecordsWithStrategy() allocate their pages with it.
+*/
+{
+    if (count <= 0)
+        return 0;
 
-    //Remove from desalocated, add to alocated and returns it
-    int j = 0;
-    while (j < NeodiskManager->size && NeodiskManager->allocated[j] != NULL)//Il y a FORCEMENT de la place
+    const int max_pages = (int)(maxFileBytes() / config->pagesize);
+    pthread_rwlock_wrlock(&spacesLock);
+    for (int done = 0, run; done < count; done += run)
     {
-        j++;
+        run = count - done < max_pages ? count - done : max_pages;
+        if (!allocRun(pageids + done, run))
+        {
+            for (int i = 0; i < done; i++)
+                freePage(pageids[i]);
+            pthread_rwlock_unlock(&spacesLock);
+            return 0;
+        }
     }
-    PageId* tmp = NeodiskManager->desalocated[i];
-    NeodiskManager->desalocated[i]=NeodiskManager->allocated[j];
-    NeodiskManager->allocated[j]=tmp;
-    return NeodiskManager->allocated[j];
+    pthread_rwlock_unlock(&spacesLock);
+    return count;
 }
 
 void DeallocPage (PageId* pageid)
 /*
 * Includes:
-*   <string.h> [memmove(); memset()]
+*   <stdio.h> [fprintf()]
 *
 *   "PageId.h" [PageId]
-*   "DiskManager.h" [DiskManager; count_page_id()]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
 * Params:
-*   PageId* pageid => The PageId to remove from allocated, put it to desaloacted Array.
+*   PageId* pageid => The PageId to free.
 * Return:
 *   None.
 * Description:
-*   This function Desalloc the PageId, it makes allocated array move so there is no Holes. And put it in desalocated.
+*   This function Desalloc the PageId, its bit in the free-space bitmap of its file is cleared.
 * Malloc:
 *   None.
 * Notes:
-*   Uses LIFO.
+*   O(1).
 *   Should be used with DiskManager struct to ensure that the PageId* is from it.
 */
 {
-    int pivot = -1;
-    int nb_alloc = count_page_id(diskManager->allocated, diskManager->size);
-    int nb_dealloc = count_page_id(diskManager->desalocated, diskManager->size);
-
-    for (int i = 0; i < diskManager->size && diskManager->allocated[i]; i++)
-    {
-        if (diskManager->allocated[i] != pageid)
-            continue;
-
-        pivot = i;
-        break;
-    }
-
-    //Desaloc PageId
-    diskManager->desalocated[nb_dealloc] = diskManager->allocated[pivot];
-
-    //Resize allocated and put NULL(so 0)
-    memmove(diskManager->allocated + pivot, diskManager->allocated + pivot + 1, (diskManager->size - pivot - 1) * sizeof *diskManager->allocated);
-    memset(diskManager->allocated + nb_alloc - 1, 0, (diskManager->size - (nb_alloc - 1)) * sizeof *diskManager->allocated);
+    pthread_rwlock_wrlock(&spacesLock);
+    freePage(pageid);
+    pthread_rwlock_unlock(&spacesLock);
 }
 
-void ReadPage(PageId* pageid, unsigned char* buff)
-//<fcntl.h>
-//<sys/mman.h>
+static DiskFileMapping* fileEntry(int fileIdx)
+// Entry of the file in mappings with its fd opened, filesLock is held for writing.
 {
-    char* path = getPageIdFile(pageid);
-    int fd = open(path,O_RDONLY);
-    if (fd == -1)
+    if (fileIdx >= diskManager->nb_mappings)
     {
-        fprintf(stderr, "Error setting file size in ReadPage: %s: %s\n", path, strerror(errno));
-        free(path);
-        return;
+        int nb_mappings = fileIdx + 1 > 2 * diskManager->nb_mappings ? fileIdx + 1 : 2 * diskManager->nb_mappings;
+        DiskFileMapping* tmp = realloc(diskManager->mappings, nb_mappings * sizeof *tmp);
+        if (tmp == NULL)
+        {
+            perror("Memory reallocation failed for mappings");
+            return NULL;
+        }
+        for (int i = diskManager->nb_mappings; i < nb_mappings; i++)
+        {
+            tmp[i].fd = -1;
+            tmp[i].addr = NULL;
+            tmp[i].length = 0;
+            tmp[i].reserved = 0;
+        }
+        diskManager->mappings = tmp;
+        diskManager->nb_mappings = nb_mappings;
     }
 
-    char* pagereaded = mmap(NULL,config->dm_maxfilesize,PROT_READ,MAP_SHARED,fd,0);
-    if (pagereaded == MAP_FAILED)
+    DiskFileMapping* mapping = diskManager->mappings + fileIdx;
+    if (mapping->fd == -1)
     {
-        perror("Error mmap on Read");
-        close(fd);
+        PageId pageid = {.FileIdx = fileIdx, .PageIdx = 0};
+        char* path = getPageIdFile(&pageid);
+        mapping->fd = open(path, O_RDWR);
+        if (mapping->fd == -1)
+        {
+            fprintf(stderr, "Error opening file in fileEntry: %s: %s\n", path, strerror(errno));
+            free(path);
+            return NULL;
+        }
         free(path);
-        return;
     }
 
-    memcpy(buff, pagereaded + pageid->PageIdx * config->pagesize, config->pagesize);
-    munmap(pagereaded, config->dm_maxfilesize);
-
-
-    close(fd);
-    free(path);
+    return mapping;
 }
 
-void WritePage(PageId* pageid,unsigned char* buff)
+static int getFile(int fileIdx, DiskFileMapping* file)
+/*
+* Includes:
+*   <stdio.h> [perror(); fprintf()]
+*   <stdlib.h> [realloc(); free()]
+*   <fcntl.h> [open()]
+*
+*   "PageId.h" [PageId; getPageIdFile()]
+*   "DiskManager.h" [DiskManager; DiskFileMapping; fileEntry()]
+* Params:
+*   int fileIdx = The index x of the Fx.rsdb file.
+*   DiskFileMapping* file = Set to a copy of the cache entry of the file, with its fd opened.
+* Return:
+*   0 => Success.
+*   -1 => There's been an error.
+* Description:
+*   This function gives the cached fd of the file fileIdx, opening it the first time it is needed.
+*   The file stays opened until CloseFiles().
+* Malloc:
+*   None, CloseFiles() manages it.
+* Notes:
+*   Files created by addTable() are opened lazily on their first access.
+*   mappings moves when it grows, the entry is copied under filesLock and the I/O is done without it.
+*/
 {
-    char* path = getPageIdFile(pageid);
-    int fd = open(path,O_RDWR);
-    if (fd == -1)
-    {
-        perror("Error setting file size in WritePage");
-        free(path);
-        return;
-    }
+    if (fileIdx < 0)
+        return -1;
 
-    char* pagereaded = mmap(NULL,config->dm_maxfilesize,PROT_WRITE,MAP_SHARED,fd,0);
-    if (pagereaded == MAP_FAILED)
-    {
-        perror("Error mmap on Write");
-        free(path);
-        return;
-    }
+    pthread_rwlock_rdlock(&filesLock);
+    const int opened = fileIdx < diskManager->nb_mappings && diskManager->mappings[fileIdx].fd != -1;
+    if (opened)
+        *file = diskManager->mappings[fileIdx];
+    pthread_rwlock_unlock(&filesLock);
+    if (opened)
+        return 0;
 
-    memcpy(pagereaded + pageid->PageIdx * config->pagesize,  buff, config->pagesize);
-    free(path);
+    pthread_rwlock_wrlock(&filesLock);
+    DiskFileMapping* mapping = fileEntry(fileIdx);
+    if (mapping != NULL)
+        *file = *mapping;
+    pthread_rwlock_unlock(&filesLock);
+    return mapping == NULL ? -1 : 0;
 }
 
-
-void SaveState()
+static int getFileMapping(int fileIdx, DiskFileMapping* mapping)
 /*
 * Includes:
-*   <stdio.h> [sizeof(); sizeof]
-*   <stddef.h> [NULL; size_t]
-*   <unistd.h> [chdir(); write(); close()]
-*   <fcntl.h> [open()]
-*   <fcntl-linux.h> [O_WRONLY; O_CREAT; O_TRUNC]
-*   <assert.h> [assert()]
+*   <stdio.h> [perror()]
+*   <sys/mman.h> [mmap()]
+*   <sys/stat.h> [fstat()]
 *
-*   "PageId.h" [PageIdList; PageId; addTable()]
-*   "DBConfig.h" [DBConfig]
-*   "DiskManager.h" [DiskManager; count_page_id()]
+*   "DiskManager.h" [DiskFileMapping; fileEntry(); maxFileBytes()]
 * Params:
-*   None.
+*   int fileIdx = The index x of the Fx.rsdb file.
+*   DiskFileMapping* mapping = Set to a copy of the cache entry of the file, with its mapping.
 * Return:
-*   None.
+*   0 => Success.
+*   -1 => There's been an error.
 * Description:
-*   This function saves the state of DiskManager to dm.save.
-*   This will not need page pageidlist, it will be recreated. at LoadState().
+*   This function gives the cached mapping of the file fileIdx, mapping it the first time it is needed.
+*   The file stays mapped until CloseFiles(), so each page access is a plain memory access.
+*   The mapping reserves the size files stop growing at, so extendFile() grows the file without remapping it.
 * Malloc:
-*   None.
+*   None, CloseFiles() manages it.
 * Notes:
-*   None.
+*   The size of the file is only read with fstat() when it is mapped, mapping->length is then kept by extendFile().
 */
 {
-    //Move to bdd folder to open dm.save and commeback.
-    chdir(config->dbpath);
-    int fd = open("dm.save",O_WRONLY | O_CREAT | O_TRUNC, 0640);
-    char* currentdir = currentDirectory();
-    chdir(currentdir);
-    free(currentdir);
-    if (fd == -1)
-    {
-        perror("Error setting file size in SaveState");
-        return;
-    }
+    if (fileIdx < 0)
+        return -1;
 
-    //Count PageId and checks size
-    int nb_alloc = count_page_id(diskManager->allocated, diskManager->size);
-    int nb_dealloc = count_page_id(diskManager->desalocated, diskManager->size);
-    assert(nb_alloc + nb_dealloc == pageidlist->size);
-
-    //Set a PageId size
-    size_t sizeof_page_id = sizeof(PageId);
+    pthread_rwlock_rdlock(&filesLock);
+    const int mapped = fileIdx < diskManager->nb_mappings && diskManager->mappings[fileIdx].addr != NULL;
+    if (mapped)
+        *mapping = diskManager->mappings[fileIdx];
+    pthread_rwlock_unlock(&filesLock);
+    if (mapped)
+        return 0;
 
-    //Writes the number of PageId
-    write(fd, &nb_alloc, sizeof nb_alloc);
-    //Writes each Pages,
-    for (int i = diskManager->size - 1; i >= 0; i--)
+    pthread_rwlock_wrlock(&filesLock);
+    DiskFileMapping* file = fileEntry(fileIdx);
+    struct stat s;
+    if (file != NULL && file->addr == NULL) // Unless mapped by another thread meanwhile
     {
-        if (diskManager->allocated[i] == NULL)
-            continue;
-
-        write(fd, diskManager->allocated[i], sizeof_page_id);
+        if (fstat(file->fd, &s) == -1)
+        {
+            perror("Error fstat in getFileMapping");
+            file = NULL;
+        }
+        else
+        {
+            // Past the end of the file the reserved range is never accessed, pages there aren't allocated yet
+            size_t reserved = maxFileBytes();
+            if (reserved < (size_t)s.st_size)
+                reserved = s.st_size;
+            void* addr = mmap(NULL, reserved, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                perror("Error mmap in getFileMapping");
+                file = NULL;
+            }
+            else
+            {
+                file->addr = addr;
+                file->reserved = reserved;
+                file->length = s.st_size;
+            }
+        }
     }
+    if (file != NULL)
+        *mapping = *file;
+    pthread_rwlock_unlock(&filesLock);
+    return file == NULL ? -1 : 0;
+}
 
-    //Writes the number of PageId
-    write(fd, &nb_dealloc, sizeof nb_dealloc);
-    //Writes each Pages,
+static uint8_t* getPageAddress(PageId* pageid)
+// Address of the page inside the mapping of its file, NULL if it can't be mapped.
+{
+    DiskFileMapping mapping;
+    if (getFileMapping(pageid->FileIdx, &mapping) == -1)
+        return NULL;
 
-    for (int i = diskManager->size - 1; i >= 0; i--)
+    size_t offset = (size_t)pageid->PageIdx * config->pagesize;
+    if (pageid->PageIdx < 0 || offset + config->pagesize > mapping.length)
     {
-        if (diskManager->desalocated[i] == NULL)
-            continue;
-
-        write(fd, diskManager->desalocated[i], sizeof_page_id);
+        fprintf(stderr, "error: page %d out of file %d\n", pageid->PageIdx, pageid->FileIdx);
+        return NULL;
     }
 
-    close(fd);
+    return mapping.addr + offset;
 }
 
-void LoadState()
+void CloseFiles()
 /*
 * Includes:
+*   <stdlib.h> [free()]
+*   <sys/mman.h> [munmap()]
+*   <unistd.h> [close()]
 *
-*   <unistd.h> [chdir(); read(); close()]
-*   <fcntl.h> [open()]
-*   <fcntl-linux.h> [O_RDONLY]
-*   <stdlib.h> [free(); calloc(); realloc()]
-*   <stdio.h> [perror(); sizeof]
-*   <stddef.h> [NULL]
-*   <string.h> [memset()]
-*
-*   "PageId.h" [PageIdList; PageId; addTable()]
-*   "DBConfig.h" [DBConfig]
-*   "DiskManager.h" [DiskManager; count_page_id()]
+*   "DiskManager.h" [DiskManager; DiskFileMapping]
 * Params:
 *   None.
 * Return:
 *   None.
 * Description:
-*   This function loads the state of DiskManager to dm.save.
-*   This will re created pageidlist, and diskManager.
+*   This function waits for the asynchronous requests, then unmaps and closes every file opened by getFile() and getFileMapping().
 * Malloc:
-*   None.
+*   Frees diskManager->mappings.
 * Notes:
-*   None.
+*   Shared mappings and page cache are written back by the kernel, SyncPages() is only needed for durability.
 */
 {
-    //Move to bdd folder to open dm.save and commeback.
-    chdir(config->dbpath);
-    int fd = open("dm.save",O_RDONLY);
-    char* currentdir = currentDirectory();
-    chdir(currentdir);
-    free(currentdir);
-    if (fd == -1)
+    uringClose();
+    pthread_rwlock_wrlock(&filesLock);
+    for (int i = 0; i < diskManager->nb_mappings; i++)
     {
-        if (errno != ENOENT)
-            perror("Initialisation of default dependencies, because for dm.save"); //Good error
-        return;
+        if (diskManager->mappings[i].addr != NULL)
+            munmap(diskManager->mappings[i].addr, diskManager->mappings[i].reserved);
+        if (diskManager->mappings[i].fd != -1)
+            close(diskManager->mappings[i].fd);
     }
-    //return;
+    free(diskManager->mappings);
+    diskManager->mappings = NULL;
+    diskManager->nb_mappings = 0;
+    pthread_rwlock_unlock(&filesLock);
+}
 
-    //Get number of PagedId to read for allocated.
-    int nb_alloc;
-    read(fd, &nb_alloc, sizeof nb_alloc);
+//MMAP backend, pages are copied from/to the cached mapping of their file.
 
-    //SETUP ALLOCATED
-    //Read all the allocated pages.
-    PageId **allocated = calloc(nb_alloc, sizeof *allocated);
-    for (int i = nb_alloc - 1; i >= 0; i--) {
-        allocated[i] = calloc(1, sizeof *allocated[i]);
-        read(fd, allocated[i], sizeof *allocated[i]);
-    }
+static void mmapReadPage(PageId* pageid, uint8_t* buff)
+{
+    uint8_t* page = getPageAddress(pageid);
+    if (page == NULL)
+        return;
 
-    //Get number of PagedId to read for desalocated.
-    int nb_dealloc;
-    read(fd, &nb_dealloc, sizeof nb_dealloc);
+    memcpy(buff, page, config->pagesize);
+}
 
-    //Read all the desalocated pages to fill other spots with NULL.
-    int nb_pageid = nb_alloc + nb_dealloc;
-    void *tmp = realloc(allocated,nb_pageid * sizeof *allocated);
-    if (tmp == NULL)
-    {
-        perror("Error realloc");
+static void mmapWritePage(PageId* pageid, const uint8_t* buff)
+{
+    uint8_t* page = getPageAddress(pageid);
+    if (page == NULL)
         return;
-    }
-    allocated = tmp;
-    memset(allocated + nb_alloc , 0, (nb_pageid - nb_alloc) * sizeof *allocated);
 
+    memcpy(page, buff, config->pagesize);
+}
 
-    //SETUP DEALLOCATED
-    //Read all the deallocated pages.
-    PageId **deallocated = calloc(nb_pageid, sizeof *deallocated);
-    for (int i = nb_dealloc - 1; i >= 0; i--) {
-        deallocated[i] = calloc(1, sizeof(PageId));
-        read(fd, deallocated[i], sizeof(PageId));
-    }
+static void mmapReadPages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        mmapReadPage(pageids[i], buffs[i]);
+}
 
-    //SETUP pageidlist
-    pageidlist = calloc(1, sizeof *pageidlist);
-    pageidlist->size = nb_pageid;
-    pageidlist->list = calloc(nb_pageid, sizeof *pageidlist->list);
+static void mmapWritePages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        mmapWritePage(pageids[i], buffs[i]);
+}
 
+static size_t pageRun(PageId** pageids, size_t count)
+// Length of the run of consecutive pages of a same file starting at pageids[0].
+{
+    size_t n = 1;
+    while (n < count && pageids[n]->FileIdx == pageids[0]->FileIdx && pageids[n]->PageIdx == pageids[0]->PageIdx + (int)n)
+        n++;
+    return n;
+}
 
-    //Setup list of files.
-    int* files = calloc(nb_pageid, sizeof *files);
-    for (int i = 0; i < nb_pageid; i++)
-        files[i] += -1;
-    int nb_file = 0;
+static void mmapAdvise(PageId** pageids, size_t count)
+{
+    const size_t sys_page = getpagesize();
 
+    for (size_t i = 0, n; i < count; i += n)
+    {
+        n = pageRun(pageids + i, count - i);
+        DiskFileMapping mapping;
+        if (getFileMapping(pageids[i]->FileIdx, &mapping) == -1)
+            continue;
 
-    //Fills pageidlist with allocated PageId and count files.
-    int i = 0;
-    for (int j = nb_pageid - 1; j >= 0; j--)
+        size_t start = (size_t)pageids[i]->PageIdx * config->pagesize;
+        size_t end = start + n * config->pagesize;
+        if (end > mapping.length)
+            end = mapping.length;
+        start -= start % sys_page; // madvise() needs an aligned address
+        if (start < end && madvise(mapping.addr + start, end - start, MADV_WILLNEED) == -1)
+            perror("Error madvise in mmapAdvise");
+    }
+}
+
+static void mmapSync()
+{
+    pthread_rwlock_rdlock(&filesLock);
+    for (int i = 0; i < diskManager->nb_mappings; i++)
+    {
+        if (diskManager->mappings[i].addr != NULL && msync(diskManager->mappings[i].addr, diskManager->mappings[i].length, MS_SYNC) == -1)
+            perror("Error msync in mmapSync");
+    }
+    pthread_rwlock_unlock(&filesLock);
+}
+
+//PREAD backend, pages are read/written with positioned I/O on the cached fd of their file.
+
+static int positionedIO(int fd, struct iovec* iov, int iovcnt, off_t offset, int is_write)
+/*
+* Includes:
+*   <sys/uio.h> [preadv(); pwritev(); struct iovec]
+*   <errno.h> [errno; EINTR]
+* Params:
+*   int fd = The file descriptor.
+*   struct iovec* iov = The pages buffers, modified when there's a short read/write.
+*   int iovcnt = The number of buffers.
+*   off_t offset = The position in the file of the first buffer.
+*   int is_write = 1 for pwritev(), 0 for preadv().
+* Return:
+*   0 => Success.
+*   -1 => There's been an error, errno is set.
+* Description:
+*   This function does a vectored positioned read or write and resumes it until every byte is transferred.
+* Malloc:
+*   None.
+* Notes:
+*   Reading past the end of file is an error, pages always exist in the file.
+*/
+{
+    while (iovcnt > 0)
     {
-        if (allocated[j] == NULL)
+        ssize_t done = is_write ? pwritev(fd, iov, iovcnt, offset) : preadv(fd, iov, iovcnt, offset);
+        if (done == -1 && errno == EINTR)
             continue;
-        pageidlist->list[i++] = allocated[j];
-        int file = allocated[j]->FileIdx;
+        if (done <= 0)
+        {
+            if (done == 0)
+                errno = EIO;
+            return -1;
+        }
+
+        offset += done;
+        while (iovcnt > 0 && (size_t)done >= iov->iov_len)
+        {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+static void preadTransferPages(PageId** pageids, uint8_t** buffs, size_t count, int is_write)
+/*
+* Includes:
+*   <sys/uio.h> [struct iovec]
+*
+*   "DiskManager.h" [getFile(); positionedIO()]
+* Params:
+*   PageId** pageids = The pages to transfer.
+*   uint8_t** buffs = One buffer of config->pagesize per page.
+*   size_t count = The number of pages.
+*   int is_write = 1 to write the buffers to the pages, 0 to read the pages in the buffers.
+* Return:
+*   None.
+* Description:
+*   This function transfers the pages, coalescing each run of consecutive pages of a same file in one syscall.
+* Malloc:
+*   None.
+* Notes:
+*   Pages are not sorted, only runs already in order are coalesced.
+*/
+{
+    struct iovec iov[64]; // Far below IOV_MAX
+    const int max_iov = sizeof iov / sizeof iov[0];
 
-        int found = 0;
-        for (int k = 0; k < nb_file && !found; k++){
-            if (file == files[k])
-                found = 1;
+    size_t i = 0;
+    while (i < count)
+    {
+        DiskFileMapping file;
+        if (getFile(pageids[i]->FileIdx, &file) == -1)
+        {
+            i++;
+            continue;
         }
 
-        if (!found)
-            files[nb_file++] = file;
+        int iovcnt = 0;
+        do
+        {
+            iov[iovcnt].iov_base = buffs[i + iovcnt];
+            iov[iovcnt].iov_len = config->pagesize;
+            iovcnt++;
+        } while (i + iovcnt < count && iovcnt < max_iov
+            && pageids[i + iovcnt]->FileIdx == pageids[i]->FileIdx
+            && pageids[i + iovcnt]->PageIdx == pageids[i]->PageIdx + iovcnt);
+
+        if (positionedIO(file.fd, iov, iovcnt, (off_t)pageids[i]->PageIdx * config->pagesize, is_write) == -1)
+            fprintf(stderr, "Error %s in preadTransferPages: file %d: %s\n", is_write ? "pwritev" : "preadv", pageids[i]->FileIdx, strerror(errno));
+        i += iovcnt;
+    }
+}
+
+static void preadReadPage(PageId* pageid, uint8_t* buff)
+{
+    preadTransferPages(&pageid, &buff, 1, 0);
+}
+
+static void preadWritePage(PageId* pageid, const uint8_t* buff)
+{
+    uint8_t* tmp = (uint8_t*)buff;
+    preadTransferPages(&pageid, &tmp, 1, 1);
+}
+
+static void preadReadPages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    preadTransferPages(pageids, buffs, count, 0);
+}
+
+static void preadWritePages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    preadTransferPages(pageids, buffs, count, 1);
+}
+
+static void preadAdvise(PageId** pageids, size_t count)
+{
+    for (size_t i = 0, n; i < count; i += n)
+    {
+        n = pageRun(pageids + i, count - i);
+        DiskFileMapping file;
+        if (getFile(pageids[i]->FileIdx, &file) == -1)
+            continue;
+
+        int err = posix_fadvise(file.fd, (off_t)pageids[i]->PageIdx * config->pagesize, (off_t)n * config->pagesize, POSIX_FADV_WILLNEED);
+        if (err != 0)
+            fprintf(stderr, "Error posix_fadvise in preadAdvise: file %d: %s\n", pageids[i]->FileIdx, strerror(err));
+    }
+}
+
+static void preadSync()
+{
+    pthread_rwlock_rdlock(&filesLock);
+    for (int i = 0; i < diskManager->nb_mappings; i++)
+    {
+        if (diskManager->mappings[i].fd != -1 && fdatasync(diskManager->mappings[i].fd) == -1)
+            perror("Error fdatasync in preadSync");
+    }
+    pthread_rwlock_unlock(&filesLock);
+}
+
+//Synchronous backends complete their *_async operations immediately, there is nothing to wait for.
+
+static void syncWait()
+{
+}
+
+//URING backend, pages are read/written by batches submitted to an io_uring, completions are reaped by uringWait().
+
+#define URING_ENTRIES 64
+
+typedef struct UringRequest
+{
+    int fd;
+    uint8_t* buff;
+    off_t offset;
+    int is_write;
+} UringRequest;
+
+static struct
+{
+    int fd; //io_uring fd, -1 if not set up.
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_len;
+    void* cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+
+    unsigned to_submit; //Queued in the SQ, not yet submitted.
+    unsigned inflight; //Queued or submitted, not yet completed.
+    UringRequest requests[URING_ENTRIES]; //Indexed by user_data.
+    unsigned free_slots[URING_ENTRIES];
+    unsigned nb_free;
+} uring = {.fd = -1};
+
+static pthread_mutex_t uringLock = PTHREAD_MUTEX_INITIALIZER; // The ring is shared, guards uring once it is set up
+
+static int uringInit()
+/*
+* Includes:
+*   <linux/io_uring.h> [struct io_uring_params; IORING_*]
+*   <sys/syscall.h> [__NR_io_uring_setup]
+*   <sys/mman.h> [mmap()]
+*   <unistd.h> [syscall(); close()]
+*   <string.h> [memset()]
+* Params:
+*   None.
+* Return:
+*   0 => Success.
+*   -1 => io_uring isn't available, errno is set.
+* Description:
+*   This function sets up the io_uring of the URING backend and maps its rings, without liburing.
+* Malloc:
+*   None, uringClose() unmaps the rings.
+* Notes:
+*   Fails on kernels without io_uring or when it is disabled(seccomp, io_uring_disabled sysctl).
+*/
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+
+    int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (fd < 0)
+        return -1;
+
+    uring.sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    uring.cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (uring.cq_ring_len > uring.sq_ring_len)
+            uring.sq_ring_len = uring.cq_ring_len;
+        uring.cq_ring_len = uring.sq_ring_len;
+    }
+
+    uring.sq_ring = mmap(NULL, uring.sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (uring.sq_ring == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    uring.cq_ring = uring.sq_ring;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        uring.cq_ring = mmap(NULL, uring.cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (uring.cq_ring == MAP_FAILED)
+        {
+            munmap(uring.sq_ring, uring.sq_ring_len);
+            close(fd);
+            return -1;
+        }
+    }
+
+    uring.sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    uring.sqes = mmap(NULL, uring.sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (uring.sqes == MAP_FAILED)
+    {
+        if (uring.cq_ring != uring.sq_ring)
+            munmap(uring.cq_ring, uring.cq_ring_len);
+        munmap(uring.sq_ring, uring.sq_ring_len);
+        close(fd);
+        return -1;
+    }
+
+    uint8_t* sq = uring.sq_ring;
+    uring.sq_head = (unsigned*)(sq + p.sq_off.head);
+    uring.sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    uring.sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    uring.sq_array = (unsigned*)(sq + p.sq_off.array);
+
+    uint8_t* cq = uring.cq_ring;
+    uring.cq_head = (unsigned*)(cq + p.cq_off.head);
+    uring.cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    uring.cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    uring.cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    uring.to_submit = 0;
+    uring.inflight = 0;
+    uring.nb_free = URING_ENTRIES;
+    for (unsigned i = 0; i < URING_ENTRIES; i++)
+        uring.free_slots[i] = URING_ENTRIES - 1 - i;
+
+    uring.fd = fd;
+    return 0;
+}
+
+static void uringReap(unsigned min_complete)
+/*
+* Includes:
+*   <linux/io_uring.h> [struct io_uring_cqe; IORING_ENTER_GETEVENTS]
+*   <sys/syscall.h> [__NR_io_uring_enter]
+*   <stdlib.h> [abort()]
+*   <errno.h> [errno; EINTR]
+*
+*   "DiskManager.h" [positionedIO()]
+* Params:
+*   unsigned min_complete = The number of completions to wait for, 0 to only submit.
+* Return:
+*   None.
+* Description:
+*   This function submits the queued requests, waits for min_complete of them, then handles every available completion.
+*   A failed or short transfer is redone synchronously with positionedIO().
+* Malloc:
+*   None.
+* Notes:
+*   Aborts if io_uring_enter() fails, requests would be lost otherwise.
+*/
+{
+    if (min_complete > uring.inflight)
+        min_complete = uring.inflight;
+
+    while (uring.to_submit > 0 || min_complete > 0)
+    {
+        int ret = (int)syscall(__NR_io_uring_enter, uring.fd, uring.to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error io_uring_enter in uringReap");
+            abort();
+        }
+        uring.to_submit -= ret;
+        if (min_complete > 0 || ret == 0)
+            break;
+    }
+
+    unsigned head = *uring.cq_head;
+    const unsigned tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        const struct io_uring_cqe* cqe = uring.cqes + (head & *uring.cq_mask);
+        UringRequest* req = uring.requests + cqe->user_data;
+
+        if (cqe->res != config->pagesize)
+        {
+            struct iovec iov = {.iov_base = req->buff, .iov_len = config->pagesize};
+            if (positionedIO(req->fd, &iov, 1, req->offset, req->is_write) == -1)
+                fprintf(stderr, "Error %s in uringReap: %s\n", req->is_write ? "write" : "read", strerror(errno));
+        }
+
+        uring.free_slots[uring.nb_free++] = (unsigned)cqe->user_data;
+        uring.inflight--;
+    }
+    __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void uringQueuePages(PageId** pageids, uint8_t** buffs, size_t count, int is_write)
+/*
+* Includes:
+*   <linux/io_uring.h> [struct io_uring_sqe; IORING_OP_READ; IORING_OP_WRITE]
+*   <string.h> [memset()]
+*
+*   "DiskManager.h" [getFile(); uringReap()]
+* Params:
+*   PageId** pageids = The pages to transfer.
+*   uint8_t** buffs = One buffer of config->pagesize per page, they must stay valid until uringWait().
+*   size_t count = The number of pages.
+*   int is_write = 1 to write the buffers to the pages, 0 to read the pages in the buffers.
+* Return:
+*   None.
+* Description:
+*   This function queues one request per page and submits them, without waiting for their completion.
+*   When the ring is full, it waits for completions to make room, so any count can be queued.
+* Malloc:
+*   None.
+* Notes:
+*   Requests aren't ordered, a page shouldn't be read while a write of it is in flight.
+*/
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        DiskFileMapping file;
+        if (getFile(pageids[i]->FileIdx, &file) == -1)
+            continue;
+
+        if (uring.nb_free == 0)
+            uringReap(1);
+
+        const unsigned slot = uring.free_slots[--uring.nb_free];
+        UringRequest* req = uring.requests + slot;
+        req->fd = file.fd;
+        req->buff = buffs[i];
+        req->offset = (off_t)pageids[i]->PageIdx * config->pagesize;
+        req->is_write = is_write;
+
+        const unsigned tail = *uring.sq_tail;
+        const unsigned idx = tail & *uring.sq_mask;
+        struct io_uring_sqe* sqe = uring.sqes + idx;
+        memset(sqe, 0, sizeof *sqe);
+        sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = req->fd;
+        sqe->addr = (uintptr_t)req->buff;
+        sqe->len = config->pagesize;
+        sqe->off = req->offset;
+        sqe->user_data = slot;
+        uring.sq_array[idx] = idx;
+        __atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        uring.to_submit++;
+        uring.inflight++;
+    }
+
+    uringReap(0);
+}
+
+static void uringWait()
+// Waits for every request in flight, uringLock is held.
+{
+    while (uring.inflight > 0)
+        uringReap(uring.inflight);
+}
+
+static void uringWaitLocked()
+{
+    pthread_mutex_lock(&uringLock);
+    uringWait();
+    pthread_mutex_unlock(&uringLock);
+}
+
+static void uringReadPagesAsync(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    pthread_mutex_lock(&uringLock);
+    uringQueuePages(pageids, buffs, count, 0);
+    pthread_mutex_unlock(&uringLock);
+}
+
+static void uringWritePagesAsync(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    pthread_mutex_lock(&uringLock);
+    uringQueuePages(pageids, buffs, count, 1);
+    pthread_mutex_unlock(&uringLock);
+}
+
+static void uringReadPages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    pthread_mutex_lock(&uringLock);
+    uringQueuePages(pageids, buffs, count, 0);
+    uringWait();
+    pthread_mutex_unlock(&uringLock);
+}
+
+static void uringWritePages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    pthread_mutex_lock(&uringLock);
+    uringQueuePages(pageids, buffs, count, 1);
+    uringWait();
+    pthread_mutex_unlock(&uringLock);
+}
+
+static void uringSync()
+{
+    uringWaitLocked();
+    preadSync();
+}
+
+static void uringClose()
+/*
+* Includes:
+*   <sys/mman.h> [munmap()]
+*   <unistd.h> [close()]
+*
+*   "DiskManager.h" [uringWait()]
+* Params:
+*   None.
+* Return:
+*   None.
+* Description:
+*   This function waits for the requests in flight, then unmaps the rings and closes the io_uring.
+* Malloc:
+*   None.
+* Notes:
+*   Does nothing if the io_uring isn't set up.
+*/
+{
+    if (uring.fd == -1)
+        return;
+
+    uringWaitLocked();
+    munmap(uring.sqes, uring.sqes_len);
+    if (uring.cq_ring != uring.sq_ring)
+        munmap(uring.cq_ring, uring.cq_ring_len);
+    munmap(uring.sq_ring, uring.sq_ring_len);
+    close(uring.fd);
+    uring.fd = -1;
+}
+
+static const DiskIOBackend mmapBackend = {
+    .name = "MMAP",
+    .is_async = 0,
+    .read_page = mmapReadPage,
+    .write_page = mmapWritePage,
+    .read_pages = mmapReadPages,
+    .write_pages = mmapWritePages,
+    .read_pages_async = mmapReadPages,
+    .write_pages_async = mmapWritePages,
+    .wait = syncWait,
+    .advise = mmapAdvise,
+    .sync = mmapSync,
+};
+
+static const DiskIOBackend preadBackend = {
+    .name = "PREAD",
+    .is_async = 0,
+    .read_page = preadReadPage,
+    .write_page = preadWritePage,
+    .read_pages = preadReadPages,
+    .write_pages = preadWritePages,
+    .read_pages_async = preadReadPages,
+    .write_pages_async = preadWritePages,
+    .wait = syncWait,
+    .advise = preadAdvise,
+    .sync = preadSync,
+};
+
+static const DiskIOBackend uringBackend = {
+    .name = "URING",
+    .is_async = 1,
+    .read_page = preadReadPage, // A single page is waited for at once, positioned I/O doesn't hold the shared ring meanwhile
+    .write_page = preadWritePage,
+    .read_pages = uringReadPages,
+    .write_pages = uringWritePages,
+    .read_pages_async = uringReadPagesAsync,
+    .write_pages_async = uringWritePagesAsync,
+    .wait = uringWaitLocked,
+    .advise = preadAdvise, // Frames are read asynchronously by PrefetchPages(), the pages further ahead only get a hint
+    .sync = uringSync,
+};
+
+const DiskIOBackend* GetIOBackend(IOBackend backend)
+/*
+* Includes:
+*   <stddef.h> [NULL]
+*
+*   "DBConfig.h" [IOBackend]
+*   "DiskManager.h" [DiskIOBackend]
+* Params:
+*   IOBackend backend = The backend wanted.
+* Return:
+*   const DiskIOBackend* => Returns the operations of the backend.
+* Description:
+*   This function returns the operations of a backend, diskInit() uses it with config->dm_io_backend.
+*   Backends share the same opened files, so they can be switched at any time, e.g. to benchmark them.
+* Malloc:
+*   None.
+* Notes:
+*   Unknown values fall back to MMAP, URING falls back to PREAD when io_uring can't be set up.
+*/
+{
+    switch (backend)
+    {
+    case IO_BACKEND_URING:
+        if (uring.fd != -1 || uringInit() == 0)
+            return &uringBackend;
+        fprintf(stderr, "warning: io_uring unavailable(%s), using PREAD\n", strerror(errno));
+        return &preadBackend;
+    case IO_BACKEND_PREAD:
+        return &preadBackend;
+    case IO_BACKEND_MMAP:
+    default:
+        return &mmapBackend;
+    }
+}
+
+void ReadPage(PageId* pageid, unsigned char* buff)
+{
+    diskManager->io->read_page(pageid, buff);
+}
+
+void WritePage(PageId* pageid,unsigned char* buff)
+{
+    diskManager->io->write_page(pageid, buff);
+}
+
+void ReadPages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    diskManager->io->read_pages(pageids, buffs, count);
+}
+
+void WritePages(PageId** pageids, uint8_t** buffs, size_t count)
+{
+    diskManager->io->write_pages(pageids, buffs, count);
+}
+
+void ReadPagesAsync(PageId** pageids, uint8_t** buffs, size_t count)
+/*
+* Includes:
+*   "DiskManager.h" [DiskManager; DiskIOBackend]
+* Params:
+*   PageId** pageids = The pages to read.
+*   uint8_t** buffs = One buffer of config->pagesize per page.
+*   size_t count = The number of pages.
+* Return:
+*   None.
+* Description:
+*   This function starts reading the pages in the buffers, they are filled once WaitPagesAsync() returns.
+*   With a synchronous backend the pages are read before returning.
+* Malloc:
+*   None.
+* Notes:
+*   Buffers must stay valid and untouched until WaitPagesAsync().
+*/
+{
+    diskManager->io->read_pages_async(pageids, buffs, count);
+}
+
+void WritePagesAsync(PageId** pageids, uint8_t** buffs, size_t count)
+/*
+* Includes:
+*   "DiskManager.h" [DiskManager; DiskIOBackend]
+* Params:
+*   PageId** pageids = The pages to write.
+*   uint8_t** buffs = One buffer of config->pagesize per page.
+*   size_t count = The number of pages.
+* Return:
+*   None.
+* Description:
+*   This function starts writing the buffers to the pages, they are written once WaitPagesAsync() returns.
+*   With a synchronous backend the pages are written before returning.
+* Malloc:
+*   None.
+* Notes:
+*   Buffers must stay valid and untouched until WaitPagesAsync().
+*   A page being written shouldn't be read before WaitPagesAsync().
+*/
+{
+    diskManager->io->write_pages_async(pageids, buffs, count);
+}
+
+void WaitPagesAsync()
+{
+    diskManager->io->wait();
+}
+
+void AdvisePages(PageId** pageids, size_t count)
+/*
+* Includes:
+*   "DiskManager.h" [DiskManager; DiskIOBackend]
+* Params:
+*   PageId** pageids = The pages that will be read soon.
+*   size_t count = The number of pages.
+* Return:
+*   None.
+* Description:
+*   This function lets the kernel start reading the pages into its page cache, without reading them in any buffer.
+*   The next ReadPage() of these pages is then a copy from memory instead of a disk round trip.
+* Malloc:
+*   None.
+* Notes:
+*   Only a hint, runs of consecutive pages are advised at once.
+*/
+{
+    diskManager->io->advise(pageids, count);
+}
+
+void SyncPages()
+{
+    diskManager->io->sync();
+}
+
+
+void SaveState()
+/*
+* Includes:
+*   <stdio.h> [sizeof(); sizeof]
+*   <stddef.h> [NULL; size_t]
+*   <unistd.h> [chdir(); write(); close()]
+*   <fcntl.h> [open()]
+*   <fcntl-linux.h> [O_WRONLY; O_CREAT; O_TRUNC]
+*
+*   "DBConfig.h" [DBConfig]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
+* Params:
+*   None.
+* Return:
+*   None.
+* Description:
+*   This function saves the state of DiskManager to dm.save.
+*   The file is DM_SAVE_MAGIC, the number of files, then for each file its FileIdx, its number of pages and its free-space bitmap.
+*   This will not need page pageidlist, it will be recreated. at LoadState().
+* Malloc:
+*   None.
+* Notes:
+*   The size of dm.save only depends on the number of pages, not on which ones are allocated.
+*/
+{
+    //Move to bdd folder to open dm.save and commeback.
+    chdir(config->dbpath);
+    int fd = open("dm.save",O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    char* currentdir = currentDirectory();
+    chdir(currentdir);
+    free(currentdir);
+    if (fd == -1)
+    {
+        perror("Error setting file size in SaveState");
+        return;
     }
 
-    //Fills pageidlist with allocated PageId and count files.
-    for (int j = nb_pageid - 1; j >= 0; j--)
+    pthread_rwlock_rdlock(&spacesLock);
+    const uint32_t magic = DM_SAVE_MAGIC;
+    int nb_files = 0;
+    for (int i = 0; i < diskManager->nb_spaces; i++)
+        nb_files += diskManager->spaces[i].pages != NULL;
+
+    write(fd, &magic, sizeof magic);
+    write(fd, &nb_files, sizeof nb_files);
+    for (int i = 0; i < diskManager->nb_spaces; i++)
     {
-        if (deallocated[j] == NULL)
+        const DiskFileSpace* space = diskManager->spaces + i;
+        if (space->pages == NULL)
             continue;
 
-        pageidlist->list[i++] = deallocated[j];
+        write(fd, &i, sizeof i);
+        write(fd, &space->nb_pages, sizeof space->nb_pages);
+        write(fd, space->used, (space->nb_pages + 63) / 64 * sizeof *space->used);
+    }
+    pthread_rwlock_unlock(&spacesLock);
+
+    close(fd);
+}
+
+static int comparePageIds(const void* a, const void* b)
+{
+    const PageId* p = *(PageId* const*)a;
+    const PageId* q = *(PageId* const*)b;
+
+    if (p->FileIdx != q->FileIdx)
+        return p->FileIdx < q->FileIdx ? -1 : 1;
+    return (p->PageIdx > q->PageIdx) - (p->PageIdx < q->PageIdx);
+}
 
-        int file = deallocated[j]->FileIdx;
+static int readFully(int fd, void* buff, size_t size)
+// Reads size bytes, returns 0 if read() fails or the file ends before.
+{
+    uint8_t* p = buff;
+    while (size > 0)
+    {
+        const ssize_t n = read(fd, p, size);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
 
-        int found = 0;
-        for (int k = 0; k < nb_file && !found; k++){
-            if (file == files[k])
-                found = 1;
+static int loadLegacyState(int fd, int nb_alloc, off_t filesize)
+/*
+* Includes:
+*   <unistd.h> [read()]
+*   <stdlib.h> [malloc(); calloc(); realloc(); qsort()]
+*
+*   "PageId.h" [PageIdList; PageId]
+*   "DiskManager.h" [registerPages(); markPage(); readFully()]
+* Params:
+*   int fd = dm.save, positioned after the number of allocated PageIds.
+*   int nb_alloc = The number of allocated PageIds.
+*   off_t filesize = The size of dm.save.
+* Return:
+*   0 => The state is loaded.
+*   -1 => dm.save is truncated or holds invalid PageIds, nothing was loaded.
+* Description:
+*   This function loads a dm.save written before the free-space bitmaps: the allocated PageIds then the deallocated ones.
+*   The next SaveState() writes the bitmaps.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   The whole file is read before pageidlist is created.
+*/
+{
+    // Each PageId takes sizeof(PageId) bytes, a count the file can't hold is garbage
+    const size_t max = (size_t)filesize / sizeof(PageId);
+    if (nb_alloc < 0 || (size_t)nb_alloc > max)
+        return -1;
+
+    PageId* ids = malloc((nb_alloc + 1) * sizeof *ids);
+    if (ids == NULL)
+    {
+        perror("Memory allocation failed for the saved PageIds");
+        abort();
+    }
+    int nb_dealloc = 0;
+    if (!readFully(fd, ids, nb_alloc * sizeof *ids) || !readFully(fd, &nb_dealloc, sizeof nb_dealloc)
+        || nb_dealloc < 0 || (size_t)nb_dealloc > max - nb_alloc)
+    {
+        free(ids);
+        return -1;
+    }
+    const size_t nb_pages = (size_t)nb_alloc + (size_t)nb_dealloc;
+    PageId* tmp = realloc(ids, (nb_pages + 1) * sizeof *ids);
+    if (tmp == NULL)
+    {
+        perror("Error realloc");
+        abort();
+    }
+    ids = tmp;
+    if (!readFully(fd, ids + nb_alloc, nb_dealloc * sizeof *ids))
+    {
+        free(ids);
+        return -1;
+    }
+    for (size_t i = 0; i < nb_pages; i++)
+        if (ids[i].FileIdx < 0 || ids[i].PageIdx < 0)
+        {
+            free(ids);
+            return -1;
         }
 
-        if (!found)
-            files[nb_file++] = file;
+    PageId** pages = calloc(nb_pages + 1, sizeof *pages);
+    for (size_t i = 0; i < nb_pages; i++)
+    {
+        pages[i] = malloc(sizeof *pages[i]);
+        *pages[i] = ids[i];
     }
+    free(ids);
 
-    free(files);
+    //pageidlist in disk order, each file's pages are consecutive
+    pageidlist = calloc(1, sizeof *pageidlist);
+    pageidlist->size = (int)nb_pages;
+    pageidlist->capacity = pageidlist->size;
+    pageidlist->list = calloc(pageidlist->size, sizeof *pageidlist->list);
+    memcpy(pageidlist->list, pages, pageidlist->size * sizeof *pages);
+    qsort(pageidlist->list, pageidlist->size, sizeof *pageidlist->list, comparePageIds);
+    for (int i = 0; i < pageidlist->size; i++)
+        pageidlist->numnerofFiles += i == 0 || pageidlist->list[i]->FileIdx != pageidlist->list[i - 1]->FileIdx;
 
-    //Update pageidlist and diskManager.
-    pageidlist->numnerofFiles = nb_file;
-    diskManager->allocated = allocated;
-    diskManager->desalocated = deallocated;
-    diskManager->size = nb_pageid;
+    registerPages(0);
+    for (int i = 0; i < nb_alloc; i++)
+        markPage(diskManager->spaces + pages[i]->FileIdx, pages[i]->PageIdx);
+    free(pages);
+    return 0;
+}
 
+static int loadBitmapState(int fd, off_t filesize)
+/*
+* Includes:
+*   <unistd.h> [read()]
+*   <stdlib.h> [calloc(); free()]
+*
+*   "PageId.h" [PageIdList; appendPageId()]
+*   "DiskManager.h" [DiskFileSpace; registerPages(); readFully()]
+* Params:
+*   int fd = dm.save, positioned after DM_SAVE_MAGIC.
+*   off_t filesize = The size of dm.save.
+* Return:
+*   0 => The state is loaded.
+*   -1 => dm.save is truncated or invalid, nothing was loaded.
+* Description:
+*   This function loads the files of dm.save, each with its FileIdx, its number of pages and its free-space bitmap.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   The whole file is read before pageidlist is created.
+*/
+{
+    int nb_files = 0;
+    if (!readFully(fd, &nb_files, sizeof nb_files) || nb_files < 0 || (size_t)nb_files > (size_t)filesize / (2 * sizeof(int)))
+        return -1;
 
+    uint64_t** bitmaps = calloc(nb_files + 1, sizeof *bitmaps);
+    int* fileIdxs = calloc(nb_files + 1, sizeof *fileIdxs);
+    int* nb_pages = calloc(nb_files + 1, sizeof *nb_pages);
+    if (bitmaps == NULL || fileIdxs == NULL || nb_pages == NULL)
+    {
+        perror("Memory allocation failed for the saved bitmaps");
+        abort();
+    }
+
+    int valid = 1;
+    int i = 0;
+    for (; valid && i < nb_files; i++)
+    {
+        valid = readFully(fd, fileIdxs + i, sizeof *fileIdxs) && readFully(fd, nb_pages + i, sizeof *nb_pages)
+            && fileIdxs[i] >= 0 && nb_pages[i] > 0 && (size_t)(nb_pages[i] + 63) / 64 * sizeof **bitmaps <= (size_t)filesize;
+        for (int j = 0; valid && j < i; j++)
+            valid = fileIdxs[j] != fileIdxs[i];
+        if (!valid)
+            break;
+
+        bitmaps[i] = calloc((nb_pages[i] + 63) / 64, sizeof *bitmaps[i]);
+        if (bitmaps[i] == NULL)
+        {
+            perror("Memory allocation failed for the saved bitmaps");
+            abort();
+        }
+        valid = readFully(fd, bitmaps[i], (nb_pages[i] + 63) / 64 * sizeof *bitmaps[i]);
+    }
+
+    if (valid)
+    {
+        pageidlist = calloc(1, sizeof *pageidlist);
+        pageidlist->numnerofFiles = nb_files;
+        for (i = 0; i < nb_files; i++)
+            for (int j = 0; j < nb_pages[i]; j++)
+                if (appendPageId(pageidlist, fileIdxs[i], j) == NULL)
+                    abort();
+
+        registerPages(0);
+        for (i = 0; i < nb_files; i++)
+        {
+            DiskFileSpace* space = diskManager->spaces + fileIdxs[i];
+            for (int w = 0; w < (space->nb_pages + 63) / 64; w++)
+            {
+                space->used[w] = bitmaps[i][w];
+                space->nb_free -= __builtin_popcountll(bitmaps[i][w]);
+            }
+        }
+    }
+
+    for (i = 0; i < nb_files; i++)
+        free(bitmaps[i]);
+    free(bitmaps);
+    free(fileIdxs);
+    free(nb_pages);
+    return valid ? 0 : -1;
+}
+
+static int compareInts(const void* a, const void* b)
+{
+    const int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int rebuildState()
+/*
+* Includes:
+*   <dirent.h> [opendir(); readdir(); closedir()]
+*   <stdio.h> [sscanf()]
+*   <stdlib.h> [realloc(); free(); qsort()]
+*   <sys/stat.h> [stat()]
+*
+*   "PageId.h" [PageIdList; appendPageId(); getPageIdFile()]
+*   "Tools_L.h" [pathExtended()]
+*   "DiskManager.h" [DiskFileSpace; registerPages(); markPage()]
+* Params:
+*   None.
+* Return:
+*   0 => The state is rebuilt from the data files.
+*   -1 => There's no data file, the DiskManager has to be initiated.
+* Description:
+*   This function recreates pageidlist from the Fx.rsdb files of BinData when dm.save can't be loaded.
+*   Which pages were free is lost, so every page is marked allocated: no page of a relation can be given away.
+* Malloc:
+*   None, diskFREE() manages it.
+* Notes:
+*   The free pages of the files are never reused, only the new files are.
+*/
+{
+    char* BinDatapath = pathExtended(config->dbpath,"BinData",1);
+    DIR* dir = BinDatapath ? opendir(BinDatapath) : NULL;
+    free(BinDatapath);
+    if (dir == NULL)
+        return -1;
+
+    int* fileIdxs = NULL;
+    int nb_files = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        int fileIdx = -1, end = 0;
+        if (sscanf(entry->d_name, "F%d.rsdb%n", &fileIdx, &end) != 1 || end == 0 || entry->d_name[end] != '\0' || fileIdx < 0)
+            continue;
+
+        int* tmp = realloc(fileIdxs, (nb_files + 1) * sizeof *fileIdxs);
+        if (tmp == NULL)
+        {
+            perror("Error realloc");
+            abort();
+        }
+        fileIdxs = tmp;
+        fileIdxs[nb_files++] = fileIdx;
+    }
+    closedir(dir);
+    qsort(fileIdxs, nb_files, sizeof *fileIdxs, compareInts);
+
+    pageidlist = calloc(1, sizeof *pageidlist);
+    for (int i = 0; i < nb_files; i++)
+    {
+        PageId first = {fileIdxs[i], 0};
+        char* path = getPageIdFile(&first);
+        struct stat s;
+        const int nb_pages = path != NULL && stat(path, &s) == 0 ? (int)(s.st_size / config->pagesize) : 0;
+        free(path);
+
+        for (int j = 0; j < nb_pages; j++)
+            if (appendPageId(pageidlist, fileIdxs[i], j) == NULL)
+                abort();
+        pageidlist->numnerofFiles += nb_pages > 0;
+    }
+    free(fileIdxs);
+    if (pageidlist->size == 0)
+    {
+        free(pageidlist->list);
+        free(pageidlist);
+        pageidlist = NULL;
+        return -1;
+    }
+
+    registerPages(0);
+    for (int i = 0; i < pageidlist->size; i++)
+        markPage(diskManager->spaces + pageidlist->list[i]->FileIdx, pageidlist->list[i]->PageIdx);
+    return 0;
+}
+
+void LoadState()
+/*
+* Includes:
+*
+*   <unistd.h> [chdir(); read(); close()]
+*   <fcntl.h> [open()]
+*   <fcntl-linux.h> [O_RDONLY]
+*   <sys/stat.h> [fstat()]
+*   <stdio.h> [perror(); fprintf(); sizeof]
+*   <stddef.h> [NULL]
+*
+*   "DBConfig.h" [DBConfig]
+*   "DiskManager.h" [loadBitmapState(); loadLegacyState(); rebuildState(); readFully()]
+* Params:
+*   None.
+* Return:
+*   None.
+* Description:
+*   This function loads the state of DiskManager to dm.save.
+*   This will re created pageidlist, and the free-space bitmaps of diskManager.
+*   A dm.save without DM_SAVE_MAGIC is the former list of PageIds, loaded by loadLegacyState().
+*   A dm.save that is truncated or can't be read is rejected, the state is then rebuilt from the data files by rebuildState().
+* Malloc:
+*   None.
+* Notes:
+*   config->need_init stays set when there's neither a dm.save nor a data file. Does nothing once the state exists.
+*/
+{
+    if (pageidlist != NULL) // Already loaded or initiated by diskInit()
+        return;
+
+    //Move to bdd folder to open dm.save and commeback.
+    chdir(config->dbpath);
+    int fd = open("dm.save",O_RDONLY);
+    char* currentdir = currentDirectory();
+    chdir(currentdir);
+    free(currentdir);
+    if (fd == -1)
+    {
+        if (errno != ENOENT)
+            perror("Initialisation of default dependencies, because for dm.save"); //Good error
+        return;
+    }
+
+    struct stat s;
+    uint32_t magic = 0;
+    int loaded = -1;
+    if (fstat(fd, &s) == 0 && readFully(fd, &magic, sizeof magic))
+        loaded = magic == DM_SAVE_MAGIC ? loadBitmapState(fd, s.st_size)
+            : loadLegacyState(fd, (int)magic, s.st_size); // Was the number of allocated PageIds
     close(fd);
+
+    if (loaded == -1)
+    {
+        fprintf(stderr, "error: dm.save is truncated or corrupted, every page of the data files is kept allocated\n");
+        if (rebuildState() == -1)
+            return;
+    }
+
     //No need to initiate structs since it's done there.
     config->need_init = 0;
 }
 
 PageId *FindPageId(PageId pageId)
+/*
+* Includes:
+*   <stddef.h> [NULL]
+*
+*   "PageId.h" [PageId]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
+* Params:
+*   PageId pageId = A PageId read from a page or a save file.
+* Return:
+*   PageId* => Returns the PageId of the DiskManager with the same FileIdx and PageIdx.
+*   NULL => There's no such page.
+* Description:
+*   This function interns a PageId: the page headers store PageIds by value, the BufferManager and the relations use the DiskManager's pointers.
+* Malloc:
+*   None.
+* Notes:
+*   O(1), the free-space entry of the file indexes its PageIds by PageIdx.
+*/
 {
-    for (int i = 0; i < pageidlist->size; i++)
-        if (pageId.FileIdx == pageidlist->list[i]->FileIdx && pageId.PageIdx == pageidlist->list[i]->PageIdx)
-            return pageidlist->list[i];
-    return NULL;
-}
\ No newline at end of file
+    PageId *res = NULL;
+
+    pthread_rwlock_rdlock(&spacesLock); // spaces grows in AllocPage
+    if (pageId.FileIdx >= 0 && pageId.FileIdx < diskManager->nb_spaces && pageId.PageIdx >= 0 && pageId.PageIdx < diskManager->spaces[pageId.FileIdx].nb_pages)
+        res = diskManager->spaces[pageId.FileIdx].pages[pageId.PageIdx];
+    pthread_rwlock_unlock(&spacesLock);
+
+    return res;
+}
+
+int NextPageId(const PageId* pageid, PageId* next)
+/*
+* Includes:
+*   "PageId.h" [PageId]
+*   "DiskManager.h" [DiskManager; DiskFileSpace]
+* Params:
+*   const PageId* pageid = A page of a file.
+*   PageId* next = Set to the page following pageid on disk, the first page of the next file after the last one.
+* Return:
+*   1 => next exists.
+*   0 => pageid is the last page of the last file.
+* Description:
+*   This function gives the physical successor of a page, used to read ahead of a sequential scan.
+* Malloc:
+*   None.
+* Notes:
+*   next may be allocated or not.
+*/
+{
+    *next = *pageid;
+    next->PageIdx++;
+
+    pthread_rwlock_rdlock(&spacesLock); // spaces grows in AllocPage
+    if (next->FileIdx >= 0 && next->FileIdx < diskManager->nb_spaces && next->PageIdx >= diskManager->spaces[next->FileIdx].nb_pages)
+    {
+        next->FileIdx++;
+        next->PageIdx = 0;
+    }
+    // File indices have a gap, addTable() numbers its files from numnerofFiles + 1
+    while (next->FileIdx < diskManager->nb_spaces && diskManager->spaces[next->FileIdx].pages == NULL)
+    {
+        next->FileIdx++;
+        next->PageIdx = 0;
+    }
+    const int exists = next->FileIdx >= 0 && next->FileIdx < diskManager->nb_spaces && next->PageIdx < diskManager->spaces[next->FileIdx].nb_pages;
+    pthread_rwlock_unlock(&spacesLock);
+
+    return exists;
+}
@@ -9,31 +9,85 @@
 extern "C" {
 #endif
 
+typedef struct DiskFileMapping
+/*
+* A long-lived mapping of one Fx.rsdb file.
+*/
+{
+    int fd; //Opened file descriptor, -1 if the file isn't mapped yet.
+    uint8_t* addr; //Address of the shared mapping of the whole file.
+    size_t length; //Size of the file, pages past it aren't mapped.
+    size_t reserved; //Length of the mapping, the file grows into it without being remapped.
+}DiskFileMapping;
+
+typedef struct DiskFileSpace
+/*
+* Free-space bitmap of one Fx.rsdb file.
+*/
+{
+    PageId** pages; //PageId of each page, the pointers handed out by AllocPage(). NULL if there's no such file.
+    uint64_t* used; //Bit i is set iff page i is allocated.
+    int nb_pages; //Number of pages of the file.
+    int nb_free; //Number of clear bits of used.
+    int freeWord; //Words of used before this one are full.
+}DiskFileSpace;
+
+typedef struct DiskIOBackend
+/*
+* Page I/O operations of one backend, selected with dm_io_backend.
+*/
+{
+    const char* name; //Name of the backend, as written in the config file.
+    int is_async; //1 if the *_async operations return before the transfer is done.
+    void (*read_page)(PageId* pageid, uint8_t* buff);
+    void (*write_page)(PageId* pageid, const uint8_t* buff);
+    void (*read_pages)(PageId** pageids, uint8_t** buffs, size_t count);
+    void (*write_pages)(PageId** pageids, uint8_t** buffs, size_t count);
+    void (*read_pages_async)(PageId** pageids, uint8_t** buffs, size_t count);
+    void (*write_pages_async)(PageId** pageids, uint8_t** buffs, size_t count);
+    void (*wait)();
+    void (*advise)(PageId** pageids, size_t count); //Hint that the pages will be read soon.
+    void (*sync)();
+}DiskIOBackend;
+
 typedef struct DiskManager
 /*
 * DiskManager Data
 */
 {
     DBConfig* config; //config structure
-    PageId** allocated;//List of Allocated PageId
-    PageId** desalocated;//List of Desalocated PageId
-    int size;//Size of both list.
+    DiskFileSpace* spaces;//Free-space bitmaps indexed by FileIdx.
+    int nb_spaces;//Size of spaces.
+    int freeHint;//Files before this index have no free page.
+    DiskFileMapping* mappings;//Opened files and their mappings indexed by FileIdx.
+    int nb_mappings;//Size of mappings.
+    const DiskIOBackend* io;//Backend used by ReadPage() and WritePage().
 }DiskManager;
 
 extern DiskManager* diskManager;
 
 
-static int count_page_id(PageId **ids, int size);
 int diskInit();
 int diskFREE();
 PageId* AllocPage();
+int AllocPages(PageId** pageids, int count);
 void DeallocPage(PageId* pageid);
 void ReadPage(PageId* pageid, unsigned char* buff);
 void WritePage(PageId* pageid, unsigned char* buff );
+void ReadPages(PageId** pageids, uint8_t** buffs, size_t count);
+void WritePages(PageId** pageids, uint8_t** buffs, size_t count);
+void ReadPagesAsync(PageId** pageids, uint8_t** buffs, size_t count);
+void WritePagesAsync(PageId** pageids, uint8_t** buffs, size_t count);
+void WaitPagesAsync();
+void AdvisePages(PageId** pageids, size_t count);
+void SyncPages();
+const DiskIOBackend* GetIOBackend(IOBackend backend);
+void CloseFiles();
 void SaveState();
 void LoadState();
 
 PageId *FindPageId(PageId pageId);
+int NextPageId(const PageId* pageid, PageId* next);
 
 #ifdef __cplusplus
 }
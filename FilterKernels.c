@@ -0,0 +1,218 @@
+#include "FilterKernels.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILTER_KERNELS_X86
+#endif
+
+// Bits of the records [first, first + count[ of a word of the selection, count is at most 64
+typedef uint64_t (*WordKernel)(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t first, size_t count);
+
+static int32_t load_i32(const uint8_t *field)
+{
+	int32_t value;
+	memcpy(&value, field, sizeof value);
+	return value;
+}
+
+static float load_f32(const uint8_t *field)
+{
+	float value;
+	memcpy(&value, field, sizeof value);
+	return value;
+}
+
+int ColumnFilterMatches(const ColumnFilter *filter, const uint8_t *field)
+{
+	if (filter->type == INT)
+	{
+		const int32_t a = load_i32(field), b = filter->value.i;
+		switch (filter->op)
+		{
+		case FILTER_EQ: return a == b;
+		case FILTER_NE: return a != b;
+		case FILTER_LT: return a < b;
+		case FILTER_LE: return a <= b;
+		case FILTER_GT: return a > b;
+		case FILTER_GE: return a >= b;
+		}
+	}
+	else
+	{
+		const float a = load_f32(field), b = filter->value.f;
+		switch (filter->op)
+		{
+		case FILTER_EQ: return a == b;
+		case FILTER_NE: return a != b;
+		case FILTER_LT: return a < b;
+		case FILTER_LE: return a <= b;
+		case FILTER_GT: return a > b;
+		case FILTER_GE: return a >= b;
+		}
+	}
+	return 0;
+}
+
+static uint64_t scalar_word(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t first, size_t count)
+{
+	uint64_t word = 0;
+	for (size_t j = 0; j < count; j++)
+		word |= (uint64_t)ColumnFilterMatches(filter, base + (first + j) * stride) << j;
+	return word;
+}
+
+#ifdef FILTER_KERNELS_X86
+
+__attribute__((target("avx2")))
+static uint64_t avx2_word(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t first, size_t count)
+{
+	const int s = (int)stride;
+	const __m256i idx = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+	uint64_t word = 0;
+	size_t j = 0;
+
+	if (filter->type == INT)
+	{
+		const __m256i value = _mm256_set1_epi32(filter->value.i);
+		for (; j + 8 <= count; j += 8)
+		{
+			const __m256i x = _mm256_i32gather_epi32((const int *)(base + (first + j) * stride), idx, 1);
+			__m256i m;
+			switch (filter->op)
+			{
+			case FILTER_EQ: m = _mm256_cmpeq_epi32(x, value); break;
+			case FILTER_NE: m = _mm256_xor_si256(_mm256_cmpeq_epi32(x, value), _mm256_set1_epi32(-1)); break;
+			case FILTER_LT: m = _mm256_cmpgt_epi32(value, x); break;
+			case FILTER_LE: m = _mm256_xor_si256(_mm256_cmpgt_epi32(x, value), _mm256_set1_epi32(-1)); break;
+			case FILTER_GT: m = _mm256_cmpgt_epi32(x, value); break;
+			default: m = _mm256_xor_si256(_mm256_cmpgt_epi32(value, x), _mm256_set1_epi32(-1)); break;
+			}
+			word |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << j;
+		}
+	}
+	else
+	{
+		const __m256 value = _mm256_set1_ps(filter->value.f);
+		for (; j + 8 <= count; j += 8)
+		{
+			const __m256 x = _mm256_i32gather_ps((const float *)(base + (first + j) * stride), idx, 1);
+			__m256 m;
+			switch (filter->op)
+			{
+			case FILTER_EQ: m = _mm256_cmp_ps(x, value, _CMP_EQ_OQ); break;
+			case FILTER_NE: m = _mm256_cmp_ps(x, value, _CMP_NEQ_UQ); break;
+			case FILTER_LT: m = _mm256_cmp_ps(x, value, _CMP_LT_OQ); break;
+			case FILTER_LE: m = _mm256_cmp_ps(x, value, _CMP_LE_OQ); break;
+			case FILTER_GT: m = _mm256_cmp_ps(x, value, _CMP_GT_OQ); break;
+			default: m = _mm256_cmp_ps(x, value, _CMP_GE_OQ); break;
+			}
+			word |= (uint64_t)_mm256_movemask_ps(m) << j;
+		}
+	}
+
+	if (j < count)
+		word |= scalar_word(filter, base, stride, first + j, count - j) << j;
+	return word;
+}
+
+// No gather before AVX2, the 4 fields are loaded one by one
+__attribute__((target("sse4.1")))
+static uint64_t sse4_word(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t first, size_t count)
+{
+	uint64_t word = 0;
+	size_t j = 0;
+
+	if (filter->type == INT)
+	{
+		const __m128i value = _mm_set1_epi32(filter->value.i);
+		for (; j + 4 <= count; j += 4)
+		{
+			const uint8_t *p = base + (first + j) * stride;
+			__m128i x = _mm_cvtsi32_si128(load_i32(p));
+			x = _mm_insert_epi32(x, load_i32(p + stride), 1);
+			x = _mm_insert_epi32(x, load_i32(p + 2 * stride), 2);
+			x = _mm_insert_epi32(x, load_i32(p + 3 * stride), 3);
+			__m128i m;
+			switch (filter->op)
+			{
+			case FILTER_EQ: m = _mm_cmpeq_epi32(x, value); break;
+			case FILTER_NE: m = _mm_xor_si128(_mm_cmpeq_epi32(x, value), _mm_set1_epi32(-1)); break;
+			case FILTER_LT: m = _mm_cmplt_epi32(x, value); break;
+			case FILTER_LE: m = _mm_xor_si128(_mm_cmpgt_epi32(x, value), _mm_set1_epi32(-1)); break;
+			case FILTER_GT: m = _mm_cmpgt_epi32(x, value); break;
+			default: m = _mm_xor_si128(_mm_cmplt_epi32(x, value), _mm_set1_epi32(-1)); break;
+			}
+			word |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(m)) << j;
+		}
+	}
+	else
+	{
+		const __m128 value = _mm_set1_ps(filter->value.f);
+		for (; j + 4 <= count; j += 4)
+		{
+			const uint8_t *p = base + (first + j) * stride;
+			const __m128 x = _mm_setr_ps(load_f32(p), load_f32(p + stride), load_f32(p + 2 * stride), load_f32(p + 3 * stride));
+			__m128 m;
+			switch (filter->op)
+			{
+			case FILTER_EQ: m = _mm_cmpeq_ps(x, value); break;
+			case FILTER_NE: m = _mm_cmpneq_ps(x, value); break;
+			case FILTER_LT: m = _mm_cmplt_ps(x, value); break;
+			case FILTER_LE: m = _mm_cmple_ps(x, value); break;
+			case FILTER_GT: m = _mm_cmpgt_ps(x, value); break;
+			default: m = _mm_cmpge_ps(x, value); break;
+			}
+			word |= (uint64_t)_mm_movemask_ps(m) << j;
+		}
+	}
+
+	if (j < count)
+		word |= scalar_word(filter, base, stride, first + j, count - j) << j;
+	return word;
+}
+
+#endif
+
+static WordKernel kernel = scalar_word;
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+
+// Picks the widest kernel the CPU supports, once
+static void select_kernel()
+{
+#ifdef FILTER_KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		kernel = avx2_word;
+	else if (__builtin_cpu_supports("sse4.1"))
+		kernel = sse4_word;
+#endif
+}
+
+/*
+*   Params :
+*       - filter
+*       - base : field of filter->col of the first record
+*       - stride : distance between the fields of two consecutive records, the record size
+*       - count : number of records, less than 2^31 / stride
+*       - selection : (count + 63) / 64 words, bit i is kept only if record i matches filter
+*
+*   Description :
+*       Evaluates filter on count records of constant size at once, with the SIMD kernel of the CPU (AVX2, SSE4.1 or
+*       scalar). The selection is ANDed so that several filters can be combined.
+*/
+void FilterColumn(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t count, uint64_t *selection)
+{
+	pthread_once(&kernelOnce, select_kernel);
+
+	for (size_t w = 0; w * 64 < count; w++)
+	{
+		if (!selection[w])
+			continue; // Nothing left to filter in this word
+
+		const size_t n = count - w * 64 < 64 ? count - w * 64 : 64;
+		selection[w] &= kernel(filter, base, stride, w * 64, n);
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef SHINBDDA_FILTERKERNELS_H
+#define SHINBDDA_FILTERKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum FilterOp
+{
+	FILTER_EQ,
+	FILTER_NE,
+	FILTER_LT,
+	FILTER_LE,
+	FILTER_GT,
+	FILTER_GE,
+} FilterOp;
+
+typedef struct ColumnFilter
+/*
+*   Condition "field op constant" on an INT or REAL field, evaluated over a whole page by FilterColumn()
+*/
+{
+	FieldType type; // INT or REAL
+	FilterOp op;
+	int col; // Field of the relation
+	union
+	{
+		int32_t i;
+		float f;
+	} value;
+} ColumnFilter;
+
+void FilterColumn(const ColumnFilter *filter, const uint8_t *base, size_t stride, size_t count, uint64_t *selection);
+int ColumnFilterMatches(const ColumnFilter *filter, const uint8_t *field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHINBDDA_FILTERKERNELS_H
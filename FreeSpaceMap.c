@@ -0,0 +1,123 @@
+#include "FreeSpaceMap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t max_u32(uint32_t a, uint32_t b)
+{
+	return a > b ? a : b;
+}
+
+// Resizes the leaves to capacity (a power of 2) and rebuilds every inner node
+static void resize_tree(FreeSpaceMap *fsm, size_t capacity)
+{
+	uint32_t *tree = calloc(2 * capacity, sizeof *tree);
+	FreeSpaceSlot *slots = realloc(fsm->slots, capacity * sizeof *slots);
+	if (!tree || !slots)
+	{
+		perror("error: malloc free space map:");
+		abort();
+	}
+
+	if (fsm->tree)
+		memcpy(tree + capacity, fsm->tree + fsm->capacity, fsm->size * sizeof *tree);
+	for (size_t i = capacity - 1; i > 0; i--)
+		tree[i] = max_u32(tree[2 * i], tree[2 * i + 1]);
+
+	free(fsm->tree);
+	fsm->tree = tree;
+	fsm->slots = slots;
+	fsm->capacity = capacity;
+}
+
+FreeSpaceMap *newFreeSpaceMap(size_t expected)
+{
+	FreeSpaceMap *fsm = calloc(1, sizeof *fsm);
+	if (!fsm)
+		return NULL;
+
+	size_t capacity = 1;
+	while (capacity < expected)
+		capacity <<= 1;
+
+	resize_tree(fsm, capacity);
+	fsm->index = newPageTable(capacity);
+	return fsm;
+}
+
+void freeFreeSpaceMap(FreeSpaceMap *fsm)
+{
+	if (!fsm)
+		return;
+
+	freePageTable(fsm->index);
+	free(fsm->slots);
+	free(fsm->tree);
+	free(fsm);
+}
+
+int addFreeSpaceMap(FreeSpaceMap *fsm, PageId *pageId, PageId *hdrPageId, int hdrIdx, uint32_t free_bytes)
+{
+	if (fsm->size == fsm->capacity)
+		resize_tree(fsm, 2 * fsm->capacity);
+
+	const int slot = (int)fsm->size++;
+	fsm->slots[slot].pageId = pageId;
+	fsm->slots[slot].hdrPageId = hdrPageId;
+	fsm->slots[slot].hdrIdx = hdrIdx;
+	insertPageTable(fsm->index, pageId, slot);
+
+	updateFreeSpaceMap(fsm, slot, free_bytes);
+	return slot;
+}
+
+void updateFreeSpaceMap(FreeSpaceMap *fsm, int slot, uint32_t free_bytes)
+{
+	assert(slot >= 0 && (size_t)slot < fsm->size);
+
+	size_t i = fsm->capacity + slot;
+	fsm->tree[i] = free_bytes;
+	for (i >>= 1; i > 0; i >>= 1)
+	{
+		const uint32_t max = max_u32(fsm->tree[2 * i], fsm->tree[2 * i + 1]);
+		if (fsm->tree[i] == max)
+			break; // The ancestors already have the right maximum
+		fsm->tree[i] = max;
+	}
+}
+
+uint32_t readFreeSpaceMap(const FreeSpaceMap *fsm, int slot)
+{
+	assert(slot >= 0 && (size_t)slot < fsm->size);
+	return fsm->tree[fsm->capacity + slot];
+}
+
+/*
+*   Params :
+*       - fsm
+*       - needed : number of free bytes wanted, more than 0
+*
+*   Return :
+*       - The first slot (in header order) of a page with at least needed free bytes, -1 if there's none
+*
+*   Description :
+*       Goes down from the root to the leftmost leaf whose value is large enough, O(log n)
+*/
+int searchFreeSpaceMap(const FreeSpaceMap *fsm, uint32_t needed)
+{
+	if (!fsm->size || fsm->tree[1] < needed)
+		return -1;
+
+	size_t i = 1;
+	while (i < fsm->capacity)
+		i = fsm->tree[2 * i] >= needed ? 2 * i : 2 * i + 1;
+
+	return (int)(i - fsm->capacity);
+}
+
+int findFreeSpaceMap(const FreeSpaceMap *fsm, const PageId *pageId)
+{
+	return findPageTable(fsm->index, pageId);
+}
@@ -0,0 +1,45 @@
+#ifndef SHINBDDA_FREESPACEMAP_H
+#define SHINBDDA_FREESPACEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PageId.h"
+#include "PageTable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FreeSpaceSlot
+{
+	PageId *pageId; // Data page
+	PageId *hdrPageId; // Header page holding the HeapFileDataDesc of pageId
+	int hdrIdx; // Index of that HeapFileDataDesc in the header
+} FreeSpaceSlot;
+
+typedef struct FreeSpaceMap
+/*
+*   Max-tree over the free bytes of the data pages of a relation, the leaves are in header order
+*/
+{
+	FreeSpaceSlot *slots;
+	uint32_t *tree; // tree[1] is the root, tree[capacity + i] the free bytes of slots[i], the unused leaves are 0
+	size_t capacity; // Number of leaves, always a power of 2
+	size_t size;
+	PageTable *index; // Data PageId -> index in slots
+} FreeSpaceMap;
+
+FreeSpaceMap *newFreeSpaceMap(size_t expected);
+void freeFreeSpaceMap(FreeSpaceMap *fsm);
+int addFreeSpaceMap(FreeSpaceMap *fsm, PageId *pageId, PageId *hdrPageId, int hdrIdx, uint32_t free_bytes);
+void updateFreeSpaceMap(FreeSpaceMap *fsm, int slot, uint32_t free_bytes);
+uint32_t readFreeSpaceMap(const FreeSpaceMap *fsm, int slot);
+int searchFreeSpaceMap(const FreeSpaceMap *fsm, uint32_t needed);
+int findFreeSpaceMap(const FreeSpaceMap *fsm, const PageId *pageId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHINBDDA_FREESPACEMAP_H
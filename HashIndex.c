@@ -0,0 +1,806 @@
+#include "HashIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BufferManager.h"
+#include "DBConfig.h"
+#include "DiskManager.h"
+
+#define HASH_INDEX_MAGIC 0x48415348 // "HASH"
+
+typedef struct HashLayout
+{
+	FieldType type;
+	size_t keysize;
+	size_t entrysize; // Hash, key then BTreeRid
+	size_t bucketCapacity;
+	size_t slotsPerPage; // Directory slots of a page, a power of 2
+	uint32_t maxDepth; // Global depth of a directory using every page the meta page can list
+} HashLayout;
+
+static HashLayout layoutOf(FieldType type, size_t keysize)
+{
+	HashLayout l;
+	l.type = type;
+	l.keysize = keysize;
+	l.entrysize = sizeof(uint32_t) + keysize + sizeof(BTreeRid);
+	l.bucketCapacity = (config->pagesize - sizeof(HashBucket)) / l.entrysize;
+	l.slotsPerPage = 1;
+	while (l.slotsPerPage * 2 * sizeof(PageId) <= (size_t)config->pagesize)
+		l.slotsPerPage *= 2;
+
+	const size_t maxSlots = (config->pagesize - sizeof(HashIndexMeta)) / sizeof(PageId) * l.slotsPerPage;
+	l.maxDepth = 0;
+	while (l.maxDepth < 32 && (size_t)2 << l.maxDepth <= maxSlots)
+		l.maxDepth++;
+	return l;
+}
+
+static uint8_t *bucketEntry(const HashLayout *l, HashBucket *bucket, size_t i)
+{
+	return bucket->data + i * l->entrysize;
+}
+
+static uint32_t entryHash(const uint8_t *entry)
+{
+	uint32_t hash;
+	memcpy(&hash, entry, sizeof hash);
+	return hash;
+}
+
+// FNV-1a, then the finalizer of MurmurHash3 so that the low bits, those of the directory, depend on every byte
+static uint32_t hashKey(const HashLayout *l, const uint8_t *key)
+{
+	static const uint8_t zero[sizeof(float)];
+	if (l->type == REAL)
+	{
+		float f;
+		memcpy(&f, key, sizeof f);
+		if (f == 0)
+			key = zero; // -0 and 0 are equal
+	}
+
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < l->keysize; i++)
+	{
+		h ^= key[i];
+		h *= 16777619u;
+	}
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+// 1 if every entry of the page has this hash
+static int allOfHash(const HashLayout *l, HashBucket *bucket, uint32_t hash)
+{
+	for (uint32_t i = 0; i < bucket->nb_entries; i++)
+		if (entryHash(bucketEntry(l, bucket, i)) != hash)
+			return 0;
+	return 1;
+}
+
+static size_t slotOf(uint32_t hash, uint32_t depth)
+{
+	return hash & (((size_t)1 << depth) - 1);
+}
+
+// Pages of the directory, copied so that the meta page isn't pinned with them
+static PageId *readDirectory(PageId *metaPageId, uint32_t *global_depth, uint32_t *nb_dirPages)
+{
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	*global_depth = meta->global_depth;
+	*nb_dirPages = meta->nb_dirPages;
+	PageId *dirPages = malloc(meta->nb_dirPages * sizeof *dirPages);
+	if (!dirPages)
+	{
+		perror("error: malloc hash index:");
+		abort();
+	}
+	memcpy(dirPages, meta->dirPages, meta->nb_dirPages * sizeof *dirPages);
+	FreePage(metaPageId, 0);
+	return dirPages;
+}
+
+// First page of the bucket of hash
+static PageId *bucketOfHash(const HashLayout *l, PageId *metaPageId, uint32_t hash, uint32_t *global_depth)
+{
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	const size_t slot = slotOf(hash, meta->global_depth);
+	*global_depth = meta->global_depth;
+	PageId *dirId = FindPageId(meta->dirPages[slot / l->slotsPerPage]);
+	FreePage(metaPageId, 0);
+
+	PageId *dir = (PageId *)GetPage(dirId);
+	PageId *bucketId = FindPageId(dir[slot % l->slotsPerPage]);
+	FreePage(dirId, 0);
+	return bucketId;
+}
+
+/*
+*   Params :
+*       - type : type of the keys, INT, REAL or FIXED_LENGTH_STRING
+*       - keysize : bytes of a key
+*
+*   Return :
+*       - The meta page of an empty index, NULL if no page could be allocated or if less than 2 keys fit in a bucket
+*/
+PageId *HashIndexCreate(FieldType type, size_t keysize)
+{
+	const HashLayout l = layoutOf(type, keysize);
+	if (l.bucketCapacity < 2 || l.maxDepth < 1)
+		return NULL;
+
+	PageId *pages[3]; // Meta, directory, bucket
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(pages[i] = AllocPage()))
+		{
+			while (i--)
+				DeallocPage(pages[i]);
+			return NULL;
+		}
+	}
+
+	HashBucket *bucket = (HashBucket *)GetPage(pages[2]);
+	LatchBuffer((uint8_t *)bucket, BUFFER_LATCH_EXCLUSIVE);
+	bucket->local_depth = 0;
+	bucket->nb_entries = 0;
+	bucket->has_next = 0;
+	UnlatchBuffer((uint8_t *)bucket);
+	FreePage(pages[2], 1);
+
+	PageId *dir = (PageId *)GetPage(pages[1]);
+	LatchBuffer((uint8_t *)dir, BUFFER_LATCH_EXCLUSIVE);
+	dir[0] = *pages[2];
+	UnlatchBuffer((uint8_t *)dir);
+	FreePage(pages[1], 1);
+
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(pages[0]);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	meta->magic = HASH_INDEX_MAGIC;
+	meta->type = type;
+	meta->keysize = keysize;
+	meta->global_depth = 0;
+	meta->nb_entries = 0;
+	meta->nb_dirPages = 1;
+	meta->dirPages[0] = *pages[1];
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(pages[0], 1);
+
+	return pages[0];
+}
+
+// Deallocates a bucket and its overflow pages
+static void dropChain(PageId *pageId)
+{
+	while (pageId)
+	{
+		HashBucket *bucket = (HashBucket *)GetPage(pageId);
+		PageId *nextId = bucket->has_next ? FindPageId(bucket->next) : NULL;
+		FreePage(pageId, 0);
+		DeallocPage(pageId);
+		pageId = nextId;
+	}
+}
+
+static int comparePageIds(const void *a, const void *b)
+{
+	const PageId *x = a, *y = b;
+	if (x->FileIdx != y->FileIdx)
+		return x->FileIdx < y->FileIdx ? -1 : 1;
+	return (x->PageIdx > y->PageIdx) - (x->PageIdx < y->PageIdx);
+}
+
+// Deallocates every page of the index
+void HashIndexDrop(PageId *metaPageId)
+{
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	const HashLayout l = layoutOf(meta->type, meta->keysize);
+	FreePage(metaPageId, 0);
+	uint32_t global_depth, nb_dirPages;
+	PageId *dirPages = readDirectory(metaPageId, &global_depth, &nb_dirPages);
+
+	// A bucket is in every slot ending with its local_depth bits, each is dropped once
+	const size_t nb_slots = (size_t)1 << global_depth;
+	PageId *buckets = malloc(nb_slots * sizeof *buckets);
+	if (!buckets)
+	{
+		perror("error: malloc hash index:");
+		abort();
+	}
+	for (uint32_t k = 0; k < nb_dirPages; k++)
+	{
+		PageId *dirId = FindPageId(dirPages[k]);
+		const size_t first = k * l.slotsPerPage;
+		memcpy(buckets + first, GetPage(dirId), (nb_slots - first < l.slotsPerPage ? nb_slots - first : l.slotsPerPage) * sizeof *buckets);
+		FreePage(dirId, 0);
+		DeallocPage(dirId);
+	}
+	qsort(buckets, nb_slots, sizeof *buckets, comparePageIds);
+	for (size_t i = 0; i < nb_slots; i++)
+		if (!i || comparePageIds(buckets + i, buckets + i - 1))
+			dropChain(FindPageId(buckets[i]));
+
+	free(buckets);
+	free(dirPages);
+	DeallocPage(metaPageId);
+}
+
+/*
+*   Params :
+*       - l
+*       - metaPageId
+*
+*   Return :
+*       - 1 if the directory doubled, 0 if it is as large as it can be, -1 if no page could be allocated
+*
+*   Description :
+*       Doubles the directory, slot i + 2^global_depth points to the bucket of slot i
+*/
+static int growDirectory(const HashLayout *l, PageId *metaPageId)
+{
+	uint32_t global_depth, nb_dirPages;
+	PageId *dirPages = readDirectory(metaPageId, &global_depth, &nb_dirPages);
+	if (global_depth >= l->maxDepth)
+	{
+		free(dirPages);
+		return 0;
+	}
+
+	const size_t nb_slots = (size_t)1 << global_depth;
+	PageId **added = NULL;
+	uint32_t nb_added = 0;
+	if (nb_slots < l->slotsPerPage)
+	{
+		// The directory still fits in its first page
+		PageId *dirId = FindPageId(dirPages[0]);
+		PageId *dir = (PageId *)GetPage(dirId);
+		LatchBuffer((uint8_t *)dir, BUFFER_LATCH_EXCLUSIVE);
+		memcpy(dir + nb_slots, dir, nb_slots * sizeof *dir);
+		UnlatchBuffer((uint8_t *)dir);
+		FreePage(dirId, 1);
+	}
+	else
+	{
+		// Every page is copied in a new one
+		added = malloc(nb_dirPages * sizeof *added);
+		if (!added)
+		{
+			perror("error: malloc hash index:");
+			abort();
+		}
+		for (; nb_added < nb_dirPages; nb_added++)
+		{
+			if (!(added[nb_added] = AllocPage()))
+			{
+				while (nb_added--)
+					DeallocPage(added[nb_added]);
+				free(added);
+				free(dirPages);
+				return -1;
+			}
+		}
+
+		for (uint32_t k = 0; k < nb_dirPages; k++)
+		{
+			PageId *srcId = FindPageId(dirPages[k]);
+			const uint8_t *src = GetPage(srcId);
+			uint8_t *dst = GetPage(added[k]);
+			LatchBuffer(dst, BUFFER_LATCH_EXCLUSIVE);
+			memcpy(dst, src, config->pagesize);
+			UnlatchBuffer(dst);
+			FreePage(added[k], 1);
+			FreePage(srcId, 0);
+		}
+	}
+
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	for (uint32_t k = 0; k < nb_added; k++)
+		meta->dirPages[meta->nb_dirPages++] = *added[k];
+	meta->global_depth++;
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(metaPageId, 1);
+
+	free(added);
+	free(dirPages);
+	return 1;
+}
+
+// Points the slots of the directory from first, every step slots, to bucketId
+static void setSlots(const HashLayout *l, PageId *metaPageId, size_t first, size_t step, PageId *bucketId)
+{
+	uint32_t global_depth, nb_dirPages;
+	PageId *dirPages = readDirectory(metaPageId, &global_depth, &nb_dirPages);
+
+	PageId *dirId = NULL;
+	PageId *dir = NULL;
+	for (size_t slot = first; slot < (size_t)1 << global_depth; slot += step)
+	{
+		PageId *slotDirId = FindPageId(dirPages[slot / l->slotsPerPage]);
+		if (slotDirId != dirId)
+		{
+			// Latched while it is pinned, released before pinning the next one
+			if (dirId)
+			{
+				UnlatchBuffer((uint8_t *)dir);
+				FreePage(dirId, 1);
+			}
+			dirId = slotDirId;
+			dir = (PageId *)GetPage(dirId);
+			LatchBuffer((uint8_t *)dir, BUFFER_LATCH_EXCLUSIVE);
+		}
+		dir[slot % l->slotsPerPage] = *bucketId;
+	}
+	if (dirId)
+	{
+		UnlatchBuffer((uint8_t *)dir);
+		FreePage(dirId, 1);
+	}
+
+	free(dirPages);
+}
+
+// Writes n entries over the nb_pages pages of a chain, all full but the second one, the one HashIndexInsert() fills
+static void writeChain(const HashLayout *l, PageId **pages, size_t nb_pages, const uint8_t *entries, size_t n, uint32_t local_depth)
+{
+	const size_t partial = n - (nb_pages - 1) * l->bucketCapacity;
+	for (size_t k = 0, first = 0; k < nb_pages; k++)
+	{
+		const size_t count = k == 1 || nb_pages == 1 ? partial : l->bucketCapacity;
+
+		HashBucket *bucket = (HashBucket *)GetPage(pages[k]);
+		LatchBuffer((uint8_t *)bucket, BUFFER_LATCH_EXCLUSIVE);
+		bucket->local_depth = local_depth;
+		bucket->nb_entries = count;
+		memcpy(bucket->data, entries + first * l->entrysize, count * l->entrysize);
+		bucket->has_next = k + 1 < nb_pages;
+		if (bucket->has_next)
+			bucket->next = *pages[k + 1];
+		UnlatchBuffer((uint8_t *)bucket);
+		FreePage(pages[k], 1);
+		first += count;
+	}
+}
+
+static size_t pagesFor(const HashLayout *l, size_t n)
+{
+	return n ? (n + l->bucketCapacity - 1) / l->bucketCapacity : 1;
+}
+
+/*
+*   Params :
+*       - l
+*       - metaPageId
+*       - hash : of an entry of the bucket
+*
+*   Return :
+*       - 1 if the bucket split, 0 if it can't because the directory is full, -1 if no page could be allocated
+*
+*   Description :
+*       Splits the bucket of hash, of local depth d, in the bucket of the entries whose bit d is 0 and a new bucket for
+*       the others, both of local depth d + 1. The directory doubles first when d is its global depth.
+*/
+static int splitBucket(const HashLayout *l, PageId *metaPageId, uint32_t hash)
+{
+	uint32_t global_depth;
+	PageId *bucketId = bucketOfHash(l, metaPageId, hash, &global_depth);
+	HashBucket *bucket = (HashBucket *)GetPage(bucketId);
+	const uint32_t depth = bucket->local_depth;
+	FreePage(bucketId, 0);
+
+	if (depth == global_depth)
+	{
+		const int grown = growDirectory(l, metaPageId);
+		if (grown != 1)
+			return grown;
+	}
+
+	// Entries and pages of the chain
+	size_t nb_pages = 0, n = 0, capacity = 4;
+	PageId **pages = malloc(capacity * sizeof *pages);
+	uint8_t *entries = malloc(capacity * l->bucketCapacity * l->entrysize);
+	if (!pages || !entries)
+	{
+		perror("error: malloc hash index:");
+		abort();
+	}
+	for (PageId *pageId = bucketId; pageId;)
+	{
+		if (nb_pages == capacity)
+		{
+			capacity *= 2;
+			pages = realloc(pages, capacity * sizeof *pages);
+			entries = realloc(entries, capacity * l->bucketCapacity * l->entrysize);
+			if (!pages || !entries)
+			{
+				perror("error: malloc hash index:");
+				abort();
+			}
+		}
+
+		HashBucket *page = (HashBucket *)GetPage(pageId);
+		memcpy(entries + n * l->entrysize, page->data, page->nb_entries * l->entrysize);
+		n += page->nb_entries;
+		pages[nb_pages++] = pageId;
+		PageId *nextId = page->has_next ? FindPageId(page->next) : NULL;
+		FreePage(pageId, 0);
+		pageId = nextId;
+	}
+
+	// The entries whose bit is 0 first
+	size_t n0 = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (entryHash(entries + i * l->entrysize) >> depth & 1)
+			continue;
+		if (i != n0)
+		{
+			uint8_t *a = entries + i * l->entrysize, *b = entries + n0 * l->entrysize;
+			for (size_t j = 0; j < l->entrysize; j++)
+			{
+				const uint8_t tmp = a[j];
+				a[j] = b[j];
+				b[j] = tmp;
+			}
+		}
+		n0++;
+	}
+
+	// The pages of the chain are reused, the missing ones allocated
+	const size_t p0 = pagesFor(l, n0), p1 = pagesFor(l, n - n0);
+	size_t nb_reused = nb_pages;
+	if (p0 + p1 > capacity)
+	{
+		pages = realloc(pages, (p0 + p1) * sizeof *pages);
+		if (!pages)
+		{
+			perror("error: malloc hash index:");
+			abort();
+		}
+	}
+	for (; nb_pages < p0 + p1; nb_pages++)
+	{
+		if (!(pages[nb_pages] = AllocPage()))
+		{
+			while (nb_pages-- > nb_reused)
+				DeallocPage(pages[nb_pages]);
+			free(pages);
+			free(entries);
+			return -1;
+		}
+	}
+
+	writeChain(l, pages, p0, entries, n0, depth + 1);
+	writeChain(l, pages + p0, p1, entries + n0 * l->entrysize, n - n0, depth + 1);
+	for (size_t k = p0 + p1; k < nb_pages; k++)
+		DeallocPage(pages[k]);
+	setSlots(l, metaPageId, slotOf(hash, depth) | (size_t)1 << depth, (size_t)2 << depth, pages[p0]);
+
+	free(pages);
+	free(entries);
+	return 1;
+}
+
+/*
+*   Params :
+*       - metaPageId : index
+*       - key : keysize bytes
+*       - rid : record of the key
+*
+*   Return :
+*       - 1 if the entry was added, 0 if no page could be allocated
+*
+*   Description :
+*       Adds the entry to the bucket of its hash. A full bucket splits, unless all its entries have the hash of the new
+*       one or the directory is full, an overflow page is then chained to it.
+*/
+int HashIndexInsert(PageId *metaPageId, const uint8_t *key, RecordId rid)
+{
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	const HashLayout l = layoutOf(meta->type, meta->keysize);
+	FreePage(metaPageId, 0);
+
+	uint8_t *entry = malloc(l.entrysize);
+	if (!entry)
+	{
+		perror("error: malloc hash index:");
+		abort();
+	}
+	const uint32_t hash = hashKey(&l, key);
+	const BTreeRid diskRid = {.pageId = *rid.page_id, .slot_idx = rid.slot_idx};
+	memcpy(entry, &hash, sizeof hash);
+	memcpy(entry + sizeof hash, key, l.keysize);
+	memcpy(entry + sizeof hash + l.keysize, &diskRid, sizeof diskRid);
+
+	int ok = 1;
+	for (;;)
+	{
+		uint32_t global_depth;
+		PageId *pageId = bucketOfHash(&l, metaPageId, hash, &global_depth);
+		HashBucket *bucket = (HashBucket *)GetPage(pageId);
+		const uint32_t depth = bucket->local_depth;
+
+		// Only the first page of the chain and the overflow page after it can have room
+		if (bucket->nb_entries < l.bucketCapacity)
+		{
+			LatchBuffer((uint8_t *)bucket, BUFFER_LATCH_EXCLUSIVE);
+			memcpy(bucketEntry(&l, bucket, bucket->nb_entries++), entry, l.entrysize);
+			UnlatchBuffer((uint8_t *)bucket);
+			FreePage(pageId, 1);
+			break;
+		}
+		int sameHash = allOfHash(&l, bucket, hash);
+		if (bucket->has_next)
+		{
+			PageId *nextId = FindPageId(bucket->next);
+			HashBucket *next = (HashBucket *)GetPage(nextId);
+			if (next->nb_entries < l.bucketCapacity)
+			{
+				LatchBuffer((uint8_t *)next, BUFFER_LATCH_EXCLUSIVE);
+				memcpy(bucketEntry(&l, next, next->nb_entries++), entry, l.entrysize);
+				UnlatchBuffer((uint8_t *)next);
+				FreePage(nextId, 1);
+				FreePage(pageId, 0);
+				break;
+			}
+			sameHash = sameHash && allOfHash(&l, next, hash);
+			FreePage(nextId, 0);
+		}
+
+		// A bucket that can split does, unless its entries all have the hash of the new one
+		if (!sameHash && depth < l.maxDepth)
+		{
+			FreePage(pageId, 0);
+			// Can't be 0, the directory grows if the bucket is at its depth
+			if (splitBucket(&l, metaPageId, hash) == 1)
+				continue;
+			ok = 0;
+			break;
+		}
+
+		// Chained after the first page, the pages already chained being full
+		PageId *overflowId = AllocPage();
+		if (!overflowId)
+		{
+			FreePage(pageId, 0);
+			ok = 0;
+			break;
+		}
+		HashBucket *overflow = (HashBucket *)GetPage(overflowId);
+		LatchBuffer((uint8_t *)overflow, BUFFER_LATCH_EXCLUSIVE);
+		overflow->local_depth = depth;
+		overflow->nb_entries = 1;
+		overflow->has_next = bucket->has_next;
+		overflow->next = bucket->next;
+		memcpy(bucketEntry(&l, overflow, 0), entry, l.entrysize);
+		UnlatchBuffer((uint8_t *)overflow);
+		FreePage(overflowId, 1);
+
+		LatchBuffer((uint8_t *)bucket, BUFFER_LATCH_EXCLUSIVE);
+		bucket->has_next = 1;
+		bucket->next = *overflowId;
+		UnlatchBuffer((uint8_t *)bucket);
+		FreePage(pageId, 1);
+		break;
+	}
+	free(entry);
+
+	if (ok)
+	{
+		meta = (HashIndexMeta *)GetPage(metaPageId);
+		LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+		meta->nb_entries++;
+		UnlatchBuffer((uint8_t *)meta);
+		FreePage(metaPageId, 1);
+	}
+	return ok;
+}
+
+/*
+*   Params :
+*       - metaPageId : empty index
+*       - entries : n entries of keysize bytes followed by a BTreeRid
+*       - n : number of entries
+*
+*   Return :
+*       - 1 if the index was built, 0 if no page could be allocated, the index is then left empty
+*
+*   Description :
+*       Builds the index in one pass instead of n HashIndexInsert(): the directory is sized for buckets 3/4 full, the
+*       entries are grouped by slot, and every bucket is written once, in order.
+*/
+int HashIndexBuild(PageId *metaPageId, const uint8_t *entries, size_t n)
+{
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	const HashLayout l = layoutOf(meta->type, meta->keysize);
+	FreePage(metaPageId, 0);
+	if (!n)
+		return 1;
+
+	uint32_t depth = 0;
+	while (depth < l.maxDepth && ((size_t)1 << depth) * l.bucketCapacity * 3 / 4 < n)
+		depth++;
+	for (uint32_t d = 0; d < depth; d++)
+		if (growDirectory(&l, metaPageId) != 1)
+			return 0; // Every slot still points to the empty bucket
+
+	// Entries grouped by slot, counting sort
+	const size_t nb_slots = (size_t)1 << depth, inSize = l.keysize + sizeof(BTreeRid);
+	size_t *starts = calloc(nb_slots + 1, sizeof *starts);
+	uint32_t *hashes = malloc(n * sizeof *hashes);
+	uint8_t *sorted = malloc(n * l.entrysize);
+	if (!starts || !hashes || !sorted)
+	{
+		perror("error: malloc hash index build:");
+		abort();
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		hashes[i] = hashKey(&l, entries + i * inSize);
+		starts[slotOf(hashes[i], depth) + 1]++;
+	}
+	for (size_t s = 0; s < nb_slots; s++)
+		starts[s + 1] += starts[s];
+	size_t *next = malloc(nb_slots * sizeof *next);
+	if (!next)
+	{
+		perror("error: malloc hash index build:");
+		abort();
+	}
+	memcpy(next, starts, nb_slots * sizeof *next);
+	for (size_t i = 0; i < n; i++)
+	{
+		uint8_t *entry = sorted + next[slotOf(hashes[i], depth)]++ * l.entrysize;
+		memcpy(entry, hashes + i, sizeof *hashes);
+		memcpy(entry + sizeof *hashes, entries + i * inSize, inSize);
+	}
+	free(next);
+	free(hashes);
+
+	// Every page before writing any, the empty bucket being the first one
+	size_t nb_pages = 0;
+	for (size_t s = 0; s < nb_slots; s++)
+		nb_pages += pagesFor(&l, starts[s + 1] - starts[s]);
+	PageId **pages = malloc(nb_pages * sizeof *pages);
+	if (!pages)
+	{
+		perror("error: malloc hash index build:");
+		abort();
+	}
+	uint32_t global_depth, nb_dirPages;
+	pages[0] = bucketOfHash(&l, metaPageId, 0, &global_depth);
+	if (nb_pages > 1 && !AllocPages(pages + 1, (int)(nb_pages - 1))) // Consecutive, the chains are written in order
+	{
+		free(pages);
+		free(sorted);
+		free(starts);
+		return 0;
+	}
+
+	PageId *dirPages = readDirectory(metaPageId, &global_depth, &nb_dirPages);
+	PageId *dirId = NULL;
+	PageId *dir = NULL;
+	for (size_t s = 0, k = 0; s < nb_slots; s++)
+	{
+		const size_t count = starts[s + 1] - starts[s], nb = pagesFor(&l, count);
+		writeChain(&l, pages + k, nb, sorted + starts[s] * l.entrysize, count, depth);
+
+		PageId *slotDirId = FindPageId(dirPages[s / l.slotsPerPage]);
+		if (slotDirId != dirId)
+		{
+			if (dirId)
+				FreePage(dirId, 1);
+			dirId = slotDirId;
+			dir = (PageId *)GetPage(dirId);
+		}
+		// Not latched across writeChain(), which pins the buckets
+		LatchBuffer((uint8_t *)dir, BUFFER_LATCH_EXCLUSIVE);
+		dir[s % l.slotsPerPage] = *pages[k];
+		UnlatchBuffer((uint8_t *)dir);
+		k += nb;
+	}
+	FreePage(dirId, 1);
+
+	meta = (HashIndexMeta *)GetPage(metaPageId);
+	LatchBuffer((uint8_t *)meta, BUFFER_LATCH_EXCLUSIVE);
+	meta->nb_entries = n;
+	UnlatchBuffer((uint8_t *)meta);
+	FreePage(metaPageId, 1);
+
+	free(dirPages);
+	free(pages);
+	free(sorted);
+	free(starts);
+	return 1;
+}
+
+/*
+*   Params :
+*       - metaPageId : index
+*       - key : keysize bytes, copied
+*
+*   Return :
+*       - A cursor on the entries of key, NULL if it couldn't be allocated
+*/
+HashIndexCursor *HashIndexOpenCursor(PageId *metaPageId, const uint8_t *key)
+{
+	HashIndexCursor *cursor = calloc(1, sizeof *cursor);
+	if (!cursor)
+		return NULL;
+
+	HashIndexMeta *meta = (HashIndexMeta *)GetPage(metaPageId);
+	const HashLayout l = layoutOf(meta->type, meta->keysize);
+	FreePage(metaPageId, 0);
+
+	cursor->type = l.type;
+	cursor->keysize = l.keysize;
+	cursor->entrysize = l.entrysize;
+	cursor->key = malloc(l.keysize);
+	if (!cursor->key)
+	{
+		perror("error: malloc hash index cursor:");
+		abort();
+	}
+	memcpy(cursor->key, key, l.keysize);
+	cursor->hash = hashKey(&l, key);
+
+	uint32_t global_depth;
+	cursor->bucketId = bucketOfHash(&l, metaPageId, cursor->hash, &global_depth);
+	cursor->bucket = (HashBucket *)GetPage(cursor->bucketId);
+	cursor->pos = 0;
+	return cursor;
+}
+
+/*
+*   Params :
+*       - cursor
+*       - rid : receives the record of the next entry
+*
+*   Return :
+*       - 1 if rid was set, 0 once every entry of the key has been returned
+*/
+int HashIndexCursorNext(HashIndexCursor *cursor, RecordId *rid)
+{
+	while (cursor->bucket)
+	{
+		if (cursor->pos >= cursor->bucket->nb_entries)
+		{
+			PageId *nextId = cursor->bucket->has_next ? FindPageId(cursor->bucket->next) : NULL;
+			FreePage(cursor->bucketId, 0);
+			cursor->bucketId = nextId;
+			cursor->bucket = nextId ? (HashBucket *)GetPage(nextId) : NULL;
+			cursor->pos = 0;
+			continue;
+		}
+
+		const uint8_t *entry = cursor->bucket->data + cursor->pos++ * cursor->entrysize;
+		if (entryHash(entry) != cursor->hash || BTreeCompareKeys(cursor->type, cursor->keysize, entry + sizeof(uint32_t), cursor->key) != 0)
+			continue;
+
+		BTreeRid diskRid;
+		memcpy(&diskRid, entry + sizeof(uint32_t) + cursor->keysize, sizeof diskRid);
+		rid->page_id = FindPageId(diskRid.pageId);
+		rid->slot_idx = diskRid.slot_idx;
+		return 1;
+	}
+
+	return 0;
+}
+
+void HashIndexCloseCursor(HashIndexCursor *cursor)
+{
+	if (!cursor)
+		return;
+
+	if (cursor->bucket)
+		FreePage(cursor->bucketId, 0);
+	free(cursor->key);
+	free(cursor);
+}
@@ -0,0 +1,74 @@
+#ifndef SHINBDDA_HASHINDEX_H
+#define SHINBDDA_HASHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BTree.h"
+#include "HeapFile.h"
+#include "PageId.h"
+#include "Record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HashIndexMeta
+/*
+*   First page of an extendible hash index, its PageId identifies the index. The directory has 2^global_depth slots,
+*   each the PageId of a bucket, stored in the pages dirPages, slot i in dirPages[i / slots per page].
+*/
+{
+	uint32_t magic;
+	FieldType type; // INT, REAL or FIXED_LENGTH_STRING
+	uint32_t keysize; // Bytes of a key, a string is padded with zeros
+	uint32_t global_depth;
+	uint64_t nb_entries;
+	uint32_t nb_dirPages;
+	PageId dirPages[];
+} HashIndexMeta;
+
+typedef struct HashBucket
+/*
+*   Page of a hash index, its entries are (hash, key, BTreeRid) triples in no order. A bucket holds the entries whose
+*   hash ends with the local_depth low bits of its slots. The entries of a single hash that don't fit in a page, or
+*   that a full directory can't split, go in overflow pages chained by next, all full but the first one.
+*/
+{
+	uint32_t local_depth; // Of the first page of the chain only
+	uint32_t nb_entries;
+	uint8_t has_next;
+	PageId next;
+	uint8_t data[];
+} HashBucket;
+
+typedef struct HashIndexCursor
+/*
+*   Entries of a hash index equal to one key, see HashIndexCursorNext()
+*/
+{
+	FieldType type;
+	size_t keysize;
+	size_t entrysize;
+
+	PageId *bucketId; // Pinned page of the next entry, NULL at the end
+	HashBucket *bucket;
+	uint32_t pos;
+
+	uint32_t hash;
+	uint8_t *key;
+} HashIndexCursor;
+
+PageId *HashIndexCreate(FieldType type, size_t keysize);
+void HashIndexDrop(PageId *metaPageId);
+int HashIndexInsert(PageId *metaPageId, const uint8_t *key, RecordId rid);
+int HashIndexBuild(PageId *metaPageId, const uint8_t *entries, size_t n);
+HashIndexCursor *HashIndexOpenCursor(PageId *metaPageId, const uint8_t *key);
+int HashIndexCursorNext(HashIndexCursor *cursor, RecordId *rid);
+void HashIndexCloseCursor(HashIndexCursor *cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHINBDDA_HASHINDEX_H
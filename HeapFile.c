@@ -6,13 +6,13 @@
 
 #include <stdlib.h>
 
-HeapFileDataPage *__getDataPage(PageId *pageId, const char *function, const char *filename, size_t line)
+HeapFileDataPage *__getDataPage(PageId *pageId, BufferAccessStrategy *strategy, const char *function, const char *filename, size_t line)
 {
 	HeapFileDataPage *dataPage = calloc(1, sizeof(HeapFileDataPage));
 	if (dataPage == NULL)
 		return NULL;
 
-	dataPage->head = __GetPage(pageId, function, filename, line);
+	dataPage->head = __GetPageStrategy(pageId, strategy, function, filename, line);
 	dataPage->page_id = pageId;
 
 	dataPage->directory = (SlotDirectory *)(dataPage->head + config->pagesize - sizeof(SlotDirectory));
@@ -58,7 +58,7 @@ void appendPageIdList(HeapFilePageIdList *list, PageId *pageId)
 
 	if (list->length + 1 >= list->capacity)
 	{
-		list->capacity += 64;
+		list->capacity = list->capacity ? 2 * list->capacity : 64; // Amortized, a scan lists every data page
 		void *tmp = realloc(list->page_ids, list->capacity * sizeof *list->page_ids);
 		if (!tmp)
 			return;
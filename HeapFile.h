@@ -62,10 +62,11 @@ typedef struct HeapFilePageIdList
 	size_t capacity;
 } HeapFilePageIdList;
 
-HeapFileDataPage *__getDataPage(PageId *pageId, const char *function, const char *filename, size_t line);
+HeapFileDataPage *__getDataPage(PageId *pageId, BufferAccessStrategy *strategy, const char *function, const char *filename, size_t line);
 void __freeDataPage(HeapFileDataPage *page, uint8_t dirty, const char *function, const char *filename, size_t line);
 
-#define getDataPage(pageId) __getDataPage(pageId, __PRETTY_FUNCTION__, __FILE__, __LINE__);
+#define getDataPage(pageId) __getDataPage(pageId, NULL, __PRETTY_FUNCTION__, __FILE__, __LINE__);
+#define getDataPageStrategy(pageId, strategy) __getDataPage(pageId, strategy, __PRETTY_FUNCTION__, __FILE__, __LINE__);
 #define freeDataPage(pageId, dirty) __freeDataPage(pageId, dirty, __PRETTY_FUNCTION__, __FILE__, __LINE__);
 
 HeapFilePageIdList *newPageIdList();
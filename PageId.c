@@ -17,10 +17,10 @@ PageIdList* InitiatiateTables(char* folderpath,int filesize,int pagesize, int nu
 *   <stddef.h> [NULL; size_t]
 *   <fcntl.h> [open()]
 *   <fcntl-linux.h> [O_WRONLY]
-*   <unistd.h> [ftruncate(); close()]
+*   <unistd.h> [close()]
 *
 *   "PageId.h" [PageIdList; PageId]
-*   "Tools_L.h" [pathExtended(); StringandNumbers(); createFileInDirectory()]
+*   "Tools_L.h" [pathExtended(); StringandNumbers(); createFileInDirectory(); preallocateFile()]
 * Params:
 *   char* folderpath = The path of the BDD Folder.(BDD Stack) //DB Path of config shall be used.
 *   int filesize = The size of a file. //dm_maxfillesize of config shall be used
@@ -28,7 +28,7 @@ PageIdList* InitiatiateTables(char* folderpath,int filesize,int pagesize, int nu
 *   int number = The number of files to create.
 * Return:
 *   PageIdList* => Initiate and returns the PageIdList* pageIdlisted.
-*   NULL => There's been an error.
+*   NULL => There's been an error, no file is kept.
 * Description:
 *   This function initiates PageIdList* pageIdlisted and returns it.
  *   This creates number of files and assigned each Page to the pageIdlisted.
@@ -60,6 +60,7 @@ PageIdList* InitiatiateTables(char* folderpath,int filesize,int pagesize, int nu
     }
 
     pageIdlisted->list= pageArray;
+    pageIdlisted->capacity = total_pages;
 
     //Files creations
     char* BinDatapath = pathExtended(folderpath,"BinData",1);
@@ -88,187 +89,168 @@ PageIdList* InitiatiateTables(char* folderpath,int filesize,int pagesize, int nu
         char* newfilepath = createFileInDirectory(BinDatapath,newfile,".rsdb");
 
         //Make a set size
-        int fd = open(newfilepath, O_WRONLY);
+        int fd = newfilepath ? open(newfilepath, O_WRONLY) : -1;
+        const int failed = fd == -1 || preallocateFile(fd, filesize) == -1;
+        if (failed)
+            perror("Error creating file in InitiatiateTables");
         if (fd != -1)
+            close(fd);
+        free(newfile);
+        free(newfilepath);
+        if (failed)
         {
-            // Set file size to specified size
-            if (ftruncate(fd, filesize) == -1)
+            // Pages without storage would be handed out by AllocPage() and their writes lost
+            for (; i >= 0; i--)
             {
-                // Handle error: couldn't set file size
-                perror("Error setting file size in InitiatiateTables");
+                char path[4096];
+                snprintf(path, sizeof path, "%sF%d.rsdb", BinDatapath, i);
+                unlink(path);
             }
-            close(fd);
+            for (int k = 0; k < pageIdlisted->size; k++)
+                free(pageIdlisted->list[k]);
+            free(pageIdlisted->list);
+            free(pageIdlisted);
+            free(BinDatapath);
+            return NULL;
         }
-        else
-        {
-            perror("Error opening file init");
-        }
-        free(newfile);
-        free(newfilepath);
     }
     free(BinDatapath);
 
     return pageIdlisted;
 }
 
-PageId* addTable(char* folderpath,int filesize,int pagesize,int toadd,PageIdList* pageIdlisted, DiskManager* diskManager)
+PageId* appendPageId(PageIdList* pageIdlisted, int fileIdx, int pageIdx)
 /*
 * Includes:
-*   <stdio.h> [perror(); sizeof()]
-*   <stdlib.h> [realloc(); free(); malloc()]
-*   <stddef.h> [NULL;size_t]
-*   <fcntl.h> [open()]
-*   <fcntl-linux.h> [O_WRONLY]
-*   <unistd.h> [ftruncate(); close()]
-
+*   <stdio.h> [perror()]
+*   <stdlib.h> [realloc(); malloc()]
 *
 *   "PageId.h" [PageIdList; PageId]
-*   "Tools_L.h" [pathExtended(); StringandNumbers(); createFileInDirectory()]
-*   "DiskManager.h" [DiskManager]
 * Params:
-*   char* folderpath = The path of the BDD folder.(BDD Stack) //dbpath of config shall be used.
-*   int filesize = The max size of each file // dm_maxfillesize of config shall be used
-*   int pagesize = The size of a Page in a file. //pagesize of config shall be used.
-*   int toadd = Number of Files to add. This will create (filesize / pagesize) PageId per file.
 *   PageIdList* pageIdlisted = The pageIdListed.
-*   DiskManager* diskManager = The diskManager.
+*   int fileIdx = The FileIdx of the new PageId.
+*   int pageIdx = The PageIdx of the new PageId.
 * Return:
-*   PageId* => Returns the Newer PageId. This PageId is already put in diskManager->allocated.
+*   PageId* => Returns the new PageId, stored at the end of pageIdlisted->list.
 *   NULL => There's been an error.
 * Description:
-*   This function add toadd number of files to the BinData files. Each files produces (filesize / pagesize) of PageId.
-*   The first ever created PageId will be returned and put in diskManager->allocated. The other PagId will be in diskManager->desalocated
-*   Each new PageId is stored in PageIdList* pageIdlisted.
+*   This function creates a PageId and adds it to the list, the list doubles its capacity when it is full.
 * Malloc:
-*   The returned PageId HAS NOT TO BE free().
+*   The returned PageId HAS NOT TO BE free(), diskFREE() manages it.
 * Notes:
-*   Always creates at least (filesize / pagesize) PageId.
-*   diskManager->desalocated is filled in reverse for LIFO.
+*   None.
 */
 {
-    //Initials Index
-    int Initialpagesize=pageIdlisted->size;
-    int Initialdesalocatedsize=0;
-    int Initialallocatedsize=diskManager->size;
-
-
-    PageId* freePageId=NULL;
-    int freePageFlag=0;
-    char* BinDatapath = pathExtended(folderpath,"BinData",1);
-
-
-    //Gestion PageID
-    int numberofpages = filesize / pagesize;
-    int arrival = (pageIdlisted->numnerofFiles + toadd);//Files
-    int totalsize=(pageIdlisted->size) + (toadd*numberofpages);//Pages
-    size_t new_total_pages = (size_t)(totalsize);
-    PageId** new_pageArray = (PageId**)realloc(pageIdlisted->list, new_total_pages * sizeof(PageId*));
-    if (new_pageArray == NULL)
+    if (pageIdlisted->size == pageIdlisted->capacity)
     {
-        perror("Memory reallocation failed for PageIds");
-        return NULL;
+        int capacity = pageIdlisted->capacity ? 2 * pageIdlisted->capacity : 64;
+        PageId** tmp = realloc(pageIdlisted->list, capacity * sizeof *tmp);
+        if (tmp == NULL)
+        {
+            perror("Memory reallocation failed for PageIds");
+            return NULL;
+        }
+        pageIdlisted->list = tmp;
+        pageIdlisted->capacity = capacity;
     }
-    pageIdlisted->list = new_pageArray;
-    pageIdlisted->size= totalsize;
-    diskManager->size=totalsize;
 
-    //Gestion DiskManager
-    //allocated array realloc
-    PageId** new_allocatedArray = (PageId**)realloc(diskManager->allocated,new_total_pages* sizeof(PageId*));
-    if(new_allocatedArray == NULL)
+    PageId* pageId = malloc(sizeof *pageId);
+    if (pageId == NULL)
     {
-
-        perror("Memory reallocation failed for new_allocatedArray");
-        free(new_allocatedArray);
+        perror("Memory allocation failed for specific PageIds");
         return NULL;
     }
-    diskManager->allocated=new_allocatedArray;
-    for(int i=Initialpagesize;i<totalsize;i++)
-    {
-        diskManager->allocated[i]=NULL;
-    }
-    //desalocatd array realloc
-    PageId** new_desalocatedArray = (PageId**)realloc(diskManager->desalocated,new_total_pages* sizeof(PageId*));
-    if(new_desalocatedArray == NULL)
-    {
+    pageId->FileIdx = fileIdx;
+    pageId->PageIdx = pageIdx;
+    pageIdlisted->list[pageIdlisted->size++] = pageId;
 
-        perror("Memory reallocation failed for new_desalocatedArray");
-        free(new_desalocatedArray);
-        return NULL;
-    }
-    diskManager->desalocated=new_desalocatedArray;
-    //Mettre NULL dans les nouvelles cases de desalocated
-    for (int i = 0; i < new_total_pages; i++)
+    return pageId;
+}
+
+static void removeTables(char* BinDatapath, PageIdList* pageIdlisted, int first, int nb_files)
+// Undoes a failed addTable(): frees the PageIds appended from first and deletes the files added after nb_files.
+{
+    while (pageIdlisted->size > first)
+        free(pageIdlisted->list[--pageIdlisted->size]);
+
+    for (; pageIdlisted->numnerofFiles >= nb_files; pageIdlisted->numnerofFiles--)
     {
-        diskManager->desalocated[i] = NULL;
+        char path[4096];
+        snprintf(path, sizeof path, "%sF%d.rsdb", BinDatapath, pageIdlisted->numnerofFiles + 1);
+        unlink(path);
     }
+    pageIdlisted->numnerofFiles = nb_files;
+}
 
-    //
-    //Trouver l'index ou ecrire dans desalocated
-    int index = Initialpagesize;
-    int newsize = (arrival-pageIdlisted->numnerofFiles)*numberofpages-1-1;//-1 Pour l'index et -1 parce qu'on va mettre la premiere nouvelle page dans allocated
-    //
-    for (pageIdlisted->numnerofFiles; pageIdlisted->numnerofFiles < arrival; pageIdlisted->numnerofFiles +=1)
+PageId* addTable(char* folderpath,int filesize,int pagesize,int toadd,PageIdList* pageIdlisted)
+/*
+* Includes:
+*   <stdio.h> [perror(); fprintf()]
+*   <stdlib.h> [free()]
+*   <stddef.h> [NULL;size_t]
+*   <fcntl.h> [open()]
+*   <fcntl-linux.h> [O_WRONLY]
+*   <unistd.h> [close()]
+*
+*   "PageId.h" [PageIdList; PageId; appendPageId()]
+*   "Tools_L.h" [pathExtended(); StringandNumbers(); createFileInDirectory(); preallocateFile()]
+* Params:
+*   char* folderpath = The path of the BDD folder.(BDD Stack) //dbpath of config shall be used.
+*   int filesize = The size of each new file.
+*   int pagesize = The size of a Page in a file. //pagesize of config shall be used.
+*   int toadd = Number of Files to add. This will create (filesize / pagesize) PageId per file.
+*   PageIdList* pageIdlisted = The pageIdListed.
+* Return:
+*   PageId* => Returns the first new PageId, the new PageIds follow it in pageIdlisted->list.
+*   NULL => There's been an error, no PageId nor file is added.
+* Description:
+*   This function add toadd number of files to the BinData files. Each files produces (filesize / pagesize) of PageId.
+*   The files are preallocated with preallocateFile(), so writing their pages doesn't allocate disk blocks.
+*   Each new PageId is stored in PageIdList* pageIdlisted, the DiskManager registers them as free pages.
+* Malloc:
+*   The returned PageId HAS NOT TO BE free().
+* Notes:
+*   Always creates at least (filesize / pagesize) PageId.
+*/
+{
+    const int first = pageIdlisted->size, nb_files = pageIdlisted->numnerofFiles;
+    const int numberofpages = filesize / pagesize;
+    char* BinDatapath = pathExtended(folderpath,"BinData",1);
+
+    for (int i = 0; i < toadd; i++, pageIdlisted->numnerofFiles++)
     {
-        printf("Creating pages for file no %d\n", pageIdlisted->numnerofFiles);
-        //GESTION PageID
-        for(int j=0;j<numberofpages;j++)
+        const int fileIdx = pageIdlisted->numnerofFiles + 1;
+        for (int j = 0; j < numberofpages; j++)
         {
-            pageIdlisted->list[index]=(PageId*) malloc(sizeof(PageId));
-            if(pageIdlisted->list[index]==NULL)
+            if (appendPageId(pageIdlisted, fileIdx, j) == NULL)
             {
-                perror("Memory allocation failed for specific realoc of PageIds");
-                free(pageIdlisted);
+                removeTables(BinDatapath, pageIdlisted, first, nb_files);
+                free(BinDatapath);
                 return NULL;
             }
-            pageIdlisted->list[index]->FileIdx = pageIdlisted->numnerofFiles+1;
-            pageIdlisted->list[index]->PageIdx = j;
-            //pageIdlisted->list[i].PageIdx =j;
-            if(j==0 && freePageFlag==0) // On ajoute a allocated
-            {
-                freePageId = diskManager->allocated[Initialallocatedsize]=pageIdlisted->list[index];//On ecrit direct au bon endroit
-                freePageFlag++;
-            }
-            else//On met le reste dans desalocated
-            {
-                diskManager->desalocated[newsize]=pageIdlisted->list[index];
-                newsize--;
-            }
-            index++;
         }
 
-
-        //
-        char* newfile = StringandNumbers("F",pageIdlisted->numnerofFiles + 1);
-        char* newfilepath = createFileInDirectory(BinDatapath,newfile,".rsdb");
-        //Make a set size
-        int fd = open(newfilepath, O_WRONLY | O_CREAT);
+        // Pages without storage would be handed out by AllocPage() and their writes lost
+        char* newfile = StringandNumbers("F",fileIdx);
+        char* newfilepath = newfile ? createFileInDirectory(BinDatapath,newfile,".rsdb") : NULL;
+        int fd = newfilepath ? open(newfilepath, O_WRONLY) : -1;
+        const int failed = fd == -1 || preallocateFile(fd, (off_t)numberofpages * pagesize) == -1;
+        if (failed)
+            perror("Error creating file in addTable");
         if (fd != -1)
-        {
-            struct stat s;
-            if (fstat(fd, &s) == -1)
-                perror("couldn't stat file");
-
-            if (s.st_size != 0) {
-                fprintf(stderr, "error: %s: non empty file, no ftruncate\n", newfile);
-            }
-            else if (ftruncate(fd, filesize) == -1) // Set file size to specified size
-            {
-                // Handle error: couldn't set file size
-                perror("Error setting file size in addTable");
-            }
             close(fd);
-        }
-        else
-        {
-            perror("Error opening file add");
-        }
         free(newfile);
         free(newfilepath);
+        if (failed)
+        {
+            removeTables(BinDatapath, pageIdlisted, first, nb_files);
+            free(BinDatapath);
+            return NULL;
+        }
     }
 
     free(BinDatapath);
-    return freePageId;
+    return first < pageIdlisted->size ? pageIdlisted->list[first] : NULL;
 }
 
 char* getPageIdFile(PageId* pageid)
@@ -27,12 +27,14 @@ typedef struct PageIdList
 */
 {
     int size; // Size of the list array, so the number of PageId.
+    int capacity; // Allocated entries of list.
     int numnerofFiles; // Number of Files.
     PageId** list; //List of PageId
 }PageIdList;
 
 PageIdList* InitiatiateTables(char* folderpath,int filesize,int pagesize, int number);
-PageId* addTable(char* folderpath,int filesize,int pagesize,int toadd,PageIdList* pageIdlisted, DiskManager* diskManager);
+PageId* addTable(char* folderpath,int filesize,int pagesize,int toadd,PageIdList* pageIdlisted);
+PageId* appendPageId(PageIdList* pageIdlisted, int fileIdx, int pageIdx);
 char* getPageIdFile(PageId* pageid);
 
 #ifdef __cplusplus
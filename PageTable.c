@@ -0,0 +1,132 @@
+#include "PageTable.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Fibonacci hashing of the packed (FileIdx, PageIdx) pair, the high bits are the best mixed
+static size_t slot_of(const PageTable *table, const PageId *key)
+{
+	const uint64_t packed = (uint64_t)(uint32_t)key->FileIdx << 32 | (uint32_t)key->PageIdx;
+	return (size_t)((packed * 0x9E3779B97F4A7C15ull) >> (64 - table->bits));
+}
+
+static int same_page(const PageId *a, const PageId *b)
+{
+	return a->FileIdx == b->FileIdx && a->PageIdx == b->PageIdx;
+}
+
+static void alloc_entries(PageTable *table, size_t capacity)
+{
+	table->bits = 1;
+	while (((size_t)1 << table->bits) < capacity)
+		table->bits++;
+	table->capacity = (size_t)1 << table->bits;
+	table->size = 0;
+
+	table->entries = malloc(table->capacity * sizeof *table->entries);
+	if (!table->entries)
+	{
+		perror("error: malloc page table:");
+		abort();
+	}
+	for (size_t i = 0; i < table->capacity; i++)
+		table->entries[i].value = -1;
+}
+
+PageTable *newPageTable(size_t expected)
+{
+	PageTable *table = malloc(sizeof *table);
+	if (!table)
+		return NULL;
+
+	// load factor stays under 1/2 as long as the expected number of entries is respected
+	alloc_entries(table, 2 * (expected ? expected : 1));
+	return table;
+}
+
+void freePageTable(PageTable *table)
+{
+	if (!table)
+		return;
+
+	free(table->entries);
+	free(table);
+}
+
+void clearPageTable(PageTable *table)
+{
+	for (size_t i = 0; i < table->capacity; i++)
+		table->entries[i].value = -1;
+	table->size = 0;
+}
+
+int findPageTable(const PageTable *table, const PageId *key)
+{
+	const size_t mask = table->capacity - 1;
+
+	for (size_t i = slot_of(table, key); table->entries[i].value != -1; i = (i + 1) & mask)
+		if (same_page(&table->entries[i].key, key))
+			return table->entries[i].value;
+
+	return -1;
+}
+
+void insertPageTable(PageTable *table, const PageId *key, int value)
+{
+	assert(value != -1);
+
+	if (2 * (table->size + 1) > table->capacity)
+	{
+		PageTableEntry *old = table->entries;
+		const size_t old_capacity = table->capacity;
+
+		alloc_entries(table, 2 * old_capacity);
+		for (size_t i = 0; i < old_capacity; i++)
+			if (old[i].value != -1)
+				insertPageTable(table, &old[i].key, old[i].value);
+		free(old);
+	}
+
+	const size_t mask = table->capacity - 1;
+	size_t i = slot_of(table, key);
+	for (; table->entries[i].value != -1; i = (i + 1) & mask)
+	{
+		if (same_page(&table->entries[i].key, key))
+		{
+			table->entries[i].value = value;
+			return;
+		}
+	}
+
+	table->entries[i].key = *key;
+	table->entries[i].value = value;
+	table->size++;
+}
+
+void removePageTable(PageTable *table, const PageId *key)
+{
+	const size_t mask = table->capacity - 1;
+
+	size_t i = slot_of(table, key);
+	for (; table->entries[i].value != -1; i = (i + 1) & mask)
+		if (same_page(&table->entries[i].key, key))
+			break;
+	if (table->entries[i].value == -1)
+		return;
+
+	// Backward shift deletion: moves back the following entries of the cluster that can't be found anymore, no tombstone needed
+	size_t hole = i;
+	for (size_t j = (i + 1) & mask; table->entries[j].value != -1; j = (j + 1) & mask)
+	{
+		const size_t home = slot_of(table, &table->entries[j].key);
+		// j's entry can fill the hole only if its home slot isn't in ]hole, j] (cyclically)
+		if (((j - home) & mask) >= ((j - hole) & mask))
+		{
+			table->entries[hole] = table->entries[j];
+			hole = j;
+		}
+	}
+	table->entries[hole].value = -1;
+	table->size--;
+}
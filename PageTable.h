@@ -0,0 +1,41 @@
+#ifndef SHINBDDA_PAGETABLE_H
+#define SHINBDDA_PAGETABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PageId.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PageTableEntry
+{
+	PageId key;
+	int value; // -1 if the entry is empty
+} PageTableEntry;
+
+typedef struct PageTable
+/*
+*   Open addressing hash table (linear probing), from a PageId value to an int
+*/
+{
+	PageTableEntry *entries;
+	size_t capacity; // always a power of 2
+	uint8_t bits; // log2(capacity)
+	size_t size;
+} PageTable;
+
+PageTable *newPageTable(size_t expected);
+void freePageTable(PageTable *table);
+void clearPageTable(PageTable *table);
+int findPageTable(const PageTable *table, const PageId *key);
+void insertPageTable(PageTable *table, const PageId *key, int value);
+void removePageTable(PageTable *table, const PageId *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHINBDDA_PAGETABLE_H
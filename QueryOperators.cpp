@@ -0,0 +1,231 @@
+#include "QueryOperators.h"
+
+#include "DBConfig.h"
+
+#include <string>
+
+QueryMemoryExceeded::QueryMemoryExceeded(const std::string &what, size_t requested, size_t used, size_t limit)
+	: std::runtime_error("query memory budget exceeded by " + what + ": " + std::to_string(requested) + " bytes requested, "
+		+ std::to_string(used) + "/" + std::to_string(limit) + " used")
+{}
+
+MemoryBudget::MemoryBudget(size_t limit)
+	: limit_(limit)
+{}
+
+void MemoryBudget::reserve(size_t bytes, const char *what)
+{
+	if (bytes > limit_ - used_)
+		throw QueryMemoryExceeded(what, bytes, used_, limit_);
+
+	used_ += bytes;
+}
+
+void MemoryBudget::release(size_t bytes) noexcept
+{
+	used_ -= bytes;
+}
+
+SeqScan::SeqScan(Relation *rel, MemoryBudget &budget, const SelectCommand *pushdown)
+	: rel_(rel), budget_(budget), pushdown_(pushdown)
+{}
+
+SeqScan::~SeqScan()
+{
+	close();
+}
+
+// Estimated memory of a HeapScan: the cursor and the data pages of one header page, whatever the size of the relation
+static size_t scanSize(const SelectCommand *pushdown)
+{
+	size_t size = sizeof(HeapScan) + config->pagesize / sizeof(HeapFileDataDesc) * sizeof(PageId *);
+	if (pushdown)
+	{
+		size += pushdown->projectionColumns().size() * (sizeof(int) + sizeof(ScanValue));
+		// And the selection bitmap of a page, see HeapScanSetColumnFilters()
+		if (const size_t nb_filters = pushdown->columnFilters().size())
+			size += nb_filters * sizeof(ColumnFilter) + (config->pagesize / (sizeof(SlotDirectoryEntry) + 1) / 64 + 1) * sizeof(uint64_t);
+	}
+	return size;
+}
+
+// HeapScan that only returns the rows matching the conditions of pushdown, with their projected columns
+static HeapScan *openScan(Relation *rel, const SelectCommand *pushdown)
+{
+	if (!pushdown)
+		return HeapScanOpen(rel);
+
+	const std::vector<int> &cols = pushdown->projectionColumns();
+	const std::vector<ColumnFilter> &filters = pushdown->columnFilters();
+	HeapScanFilter filter = pushdown->has_residual_conditions() ? &SelectCommand::residual_filter : nullptr;
+	HeapScan *scan = HeapScanOpenFiltered(rel, filter, const_cast<SelectCommand *>(pushdown), cols.data(), static_cast<int>(cols.size()));
+	if (scan)
+		HeapScanSetColumnFilters(scan, filters.data(), static_cast<int>(filters.size()));
+	return scan;
+}
+
+void SeqScan::open()
+{
+	const size_t size = scanSize(pushdown_);
+	budget_.reserve(size, "sequential scan");
+	reserved_ = size;
+
+	scan_ = openScan(rel_, pushdown_);
+	if (!scan_)
+		throw std::bad_alloc();
+}
+
+const Record *SeqScan::next()
+{
+	return HeapScanNext(scan_);
+}
+
+const ScanValue *SeqScan::columns() const
+{
+	return scan_ && scan_->nb_columns ? scan_->values : nullptr;
+}
+
+void SeqScan::close()
+{
+	HeapScanClose(scan_);
+	scan_ = nullptr;
+
+	budget_.release(reserved_);
+	reserved_ = 0;
+}
+
+IndexScan::IndexScan(Relation *rel, MemoryBudget &budget, const SelectCommand &pushdown, const RelationIndex &index,
+	std::optional<Bound> lo, std::optional<Bound> hi)
+	: rel_(rel), budget_(budget), pushdown_(pushdown), index_(index), lo_(std::move(lo)), hi_(std::move(hi))
+{}
+
+IndexScan::~IndexScan()
+{
+	close();
+}
+
+static int cursorSource(void *arg, RecordId *rid)
+{
+	return BTreeCursorNext(static_cast<BTreeCursor *>(arg), rid);
+}
+
+static int hashCursorSource(void *arg, RecordId *rid)
+{
+	return HashIndexCursorNext(static_cast<HashIndexCursor *>(arg), rid);
+}
+
+void IndexScan::open()
+{
+	const size_t size = scanSize(&pushdown_) + FIELD_SIZEOF(rel_, index_.col)
+		+ (index_.kind == INDEX_HASH ? sizeof(HashIndexCursor) : sizeof(BTreeCursor) + FIELD_SIZEOF(rel_, index_.col));
+	budget_.reserve(size, "index scan");
+	reserved_ = size;
+
+	scan_ = openScan(rel_, &pushdown_);
+	if (!scan_)
+		throw std::bad_alloc();
+	// Every condition is still checked on the records fetched
+	if (index_.kind == INDEX_HASH)
+	{
+		hashCursor_ = HashIndexOpenCursor(index_.metaPageId, reinterpret_cast<const uint8_t *>(lo_->key.data()));
+		if (!hashCursor_)
+			throw std::bad_alloc();
+		HeapScanSetSource(scan_, &hashCursorSource, hashCursor_);
+	}
+	else
+	{
+		cursor_ = BTreeOpenCursor(index_.metaPageId,
+			lo_ ? reinterpret_cast<const uint8_t *>(lo_->key.data()) : nullptr, lo_ && lo_->inclusive,
+			hi_ ? reinterpret_cast<const uint8_t *>(hi_->key.data()) : nullptr, hi_ && hi_->inclusive);
+		if (!cursor_)
+			throw std::bad_alloc();
+		HeapScanSetSource(scan_, &cursorSource, cursor_);
+	}
+}
+
+const Record *IndexScan::next()
+{
+	return HeapScanNext(scan_);
+}
+
+const ScanValue *IndexScan::columns() const
+{
+	return scan_ && scan_->nb_columns ? scan_->values : nullptr;
+}
+
+void IndexScan::close()
+{
+	HeapScanClose(scan_);
+	scan_ = nullptr;
+	BTreeCloseCursor(cursor_);
+	cursor_ = nullptr;
+	HashIndexCloseCursor(hashCursor_);
+	hashCursor_ = nullptr;
+
+	budget_.release(reserved_);
+	reserved_ = 0;
+}
+
+std::unique_ptr<QueryOperator> PlanSelect(Relation *rel, MemoryBudget &budget, const SelectCommand &cmd)
+{
+	using Operator = SelectCommand::Condition::Operator;
+
+	// A hash index answers an equality in one bucket, a B+tree in one descent, a range in a descent and a walk
+	enum Rank { NONE, BTREE_RANGE, BTREE_EQ, HASH_EQ };
+	const RelationIndex *best = nullptr;
+	std::optional<IndexScan::Bound> best_lo, best_hi;
+	Rank best_rank = NONE;
+
+	for (int i = 0; i < rel->nb_indexes && best_rank != HASH_EQ; i++)
+	{
+		const RelationIndex &index = rel->indexes[i];
+		const FieldType type = rel->fieldsMetadata[index.col].type;
+		const size_t keysize = FIELD_SIZEOF(rel, index.col);
+		auto compare = [type, keysize](const std::string &a, const std::string &b)
+		{
+			return BTreeCompareKeys(type, keysize, reinterpret_cast<const uint8_t *>(a.data()), reinterpret_cast<const uint8_t *>(b.data()));
+		};
+
+		// The tightest bounds of the conditions on the column
+		std::optional<IndexScan::Bound> lo, hi;
+		bool eq = false;
+		for (const SelectCommand::KeyCondition &cond : cmd.keyConditions())
+		{
+			if (cond.col != index.col || eq)
+				continue;
+
+			const bool inclusive = cond.op == Operator::OP_EQ || cond.op == Operator::OP_LE || cond.op == Operator::OP_GE;
+			if (cond.op == Operator::OP_EQ)
+			{
+				lo = hi = IndexScan::Bound{cond.key, true};
+				eq = true;
+			}
+			else if (cond.op == Operator::OP_GT || cond.op == Operator::OP_GE)
+			{
+				const int c = lo ? compare(cond.key, lo->key) : 1;
+				if (c > 0 || (c == 0 && !inclusive))
+					lo = IndexScan::Bound{cond.key, inclusive};
+			}
+			else
+			{
+				const int c = hi ? compare(cond.key, hi->key) : -1;
+				if (c < 0 || (c == 0 && !inclusive))
+					hi = IndexScan::Bound{cond.key, inclusive};
+			}
+		}
+
+		const Rank rank = index.kind == INDEX_HASH ? (eq ? HASH_EQ : NONE)
+			: eq ? BTREE_EQ : lo || hi ? BTREE_RANGE : NONE;
+		if (rank > best_rank)
+		{
+			best = &index;
+			best_lo = lo;
+			best_hi = hi;
+			best_rank = rank;
+		}
+	}
+
+	if (best)
+		return std::make_unique<IndexScan>(rel, budget, cmd, *best, std::move(best_lo), std::move(best_hi));
+	return std::make_unique<SeqScan>(rel, budget, &cmd);
+}
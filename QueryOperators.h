@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Relation.h"
+#include "SelectCommand.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+struct QueryMemoryExceeded : std::runtime_error
+{
+	QueryMemoryExceeded(const std::string &what, size_t requested, size_t used, size_t limit);
+};
+
+// Admission check of a query against config->dm_query_memory: each operator reserves an estimate of what it holds when
+// it opens and releases it when it closes, the allocations themselves aren't counted. The estimates don't depend on the
+// size of the relation since the operators stream their rows.
+class MemoryBudget
+{
+public:
+	explicit MemoryBudget(size_t limit);
+
+	void reserve(size_t bytes, const char *what); // throws QueryMemoryExceeded past the limit
+	void release(size_t bytes) noexcept;
+
+private:
+	size_t limit_;
+	size_t used_{0};
+};
+
+// Pull based (Volcano) operator, next() returns the following row or nullptr at the end. A row is only valid until the
+// following call to next(), so nothing is materialized between two operators.
+class QueryOperator
+{
+public:
+	virtual ~QueryOperator() = default;
+
+	virtual void open() = 0;
+	virtual const Record *next() = 0;
+	virtual void close() = 0;
+
+	// Projected fields of the last row, nullptr if the operator doesn't project
+	[[nodiscard]] virtual const ScanValue *columns() const { return nullptr; }
+};
+
+// Rows of a relation, read-only views into its pinned data pages (see HeapScanNext()). With a pushdown command, the scan
+// only returns the rows matching its conditions, and only decodes their projected columns. Its column filters are
+// evaluated over whole pages by the SIMD kernels of FilterColumn().
+class SeqScan final : public QueryOperator
+{
+public:
+	SeqScan(Relation *rel, MemoryBudget &budget, const SelectCommand *pushdown = nullptr);
+	~SeqScan() override;
+
+	void open() override;
+	const Record *next() override;
+	void close() override;
+	[[nodiscard]] const ScanValue *columns() const override;
+
+private:
+	Relation *rel_;
+	MemoryBudget &budget_;
+	const SelectCommand *pushdown_;
+	HeapScan *scan_{nullptr};
+	size_t reserved_{0};
+};
+
+// Rows of a relation found through one of its indexes, between two keys, then checked and projected as a SeqScan does.
+// A hash index only finds the rows of one key, lo and hi are then that key.
+class IndexScan final : public QueryOperator
+{
+public:
+	struct Bound
+	{
+		std::string key;
+		bool inclusive;
+	};
+
+	IndexScan(Relation *rel, MemoryBudget &budget, const SelectCommand &pushdown, const RelationIndex &index,
+		std::optional<Bound> lo, std::optional<Bound> hi);
+	~IndexScan() override;
+
+	void open() override;
+	const Record *next() override;
+	void close() override;
+	[[nodiscard]] const ScanValue *columns() const override;
+
+private:
+	Relation *rel_;
+	MemoryBudget &budget_;
+	const SelectCommand &pushdown_;
+	const RelationIndex &index_;
+	std::optional<Bound> lo_;
+	std::optional<Bound> hi_;
+	HeapScan *scan_{nullptr};
+	BTreeCursor *cursor_{nullptr};
+	HashIndexCursor *hashCursor_{nullptr};
+	size_t reserved_{0};
+};
+
+// The scan of a SELECT: an IndexScan if an index of the relation answers one of its conditions, an equality first, on a
+// hash index rather than on a B+tree, a SeqScan otherwise
+std::unique_ptr<QueryOperator> PlanSelect(Relation *rel, MemoryBudget &budget, const SelectCommand &cmd);
@@ -177,6 +177,23 @@ size_t readFromBuffer(Record *record, const uint8_t *buf, size_t pos)
 	return record->io.length;
 }
 
+// Makes record a read-only view of the record written at buf + pos, nothing is copied
+// record->rel must be set, and record->offsets must already hold the offsets of a non dynamic relation
+void viewFromBuffer(Record *record, const uint8_t *buf, size_t pos, size_t length)
+{
+	record->buffer = NULL;
+	record->io.start = (uint8_t *)buf + pos;
+	record->io.length = length;
+
+	if (record->rel->is_dynamic)
+	{
+		record->offsets = (uint32_t *)record->io.start;
+		record->data = record->io.start + (record->rel->nb_fields + 1) * sizeof *record->offsets;
+	}
+	else
+		record->data = record->io.start;
+}
+
 RecordList *newRecordList()
 {
 	RecordList *list = malloc(sizeof *list);
@@ -53,6 +53,7 @@ Record *newRecord(Relation *rel);
 void freeRecord(Record *rec);
 size_t writeRecordToBuffer(const Record *record, uint8_t *buf, size_t pos);
 size_t readFromBuffer(Record *record, const uint8_t *buf, size_t pos);
+void viewFromBuffer(Record *record, const uint8_t *buf, size_t pos, size_t length);
 
 #define FIELD_GET_SET_PROTO(type, name_mod) \
     void write_field_##name_mod(Record *record, int col, type data); \
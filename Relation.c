@@ -65,6 +65,11 @@ void free_relation(Relation *relation) {
     if (!relation)
         return;
     free((char *)relation->name);
+    freeFreeSpaceMap(relation->fsm);
+
+    for (int i = 0; i < relation->nb_indexes; i++)
+        free(relation->indexes[i].name);
+    free(relation->indexes);
 
     if (relation->fieldsMetadata)
     {
@@ -78,100 +83,171 @@ void free_relation(Relation *relation) {
     free(relation);
 }
 
-void addDataPage(Relation *rel)
+// Interns a PageId read from a header page of rel, NULL and reported if there's no such page
+static PageId *findHdrPageId(const Relation *rel, const char *kind, PageId pageId)
+{
+    PageId *res = FindPageId(pageId);
+    if (!res)
+        fprintf(stderr, "error: relation %s: %s page %d of file %d doesn't exist\n", rel->name, kind,
+                pageId.PageIdx, pageId.FileIdx);
+    return res;
+}
+
+// Builds the free space map of rel from its header pages on the first use
+static FreeSpaceMap *getFreeSpaceMap(Relation *rel)
+{
+    if (rel->fsm)
+        return rel->fsm;
+
+    FreeSpaceMap *fsm = newFreeSpaceMap(0);
+    if (!fsm)
+        return NULL;
+
+    PageId *cur = rel->headHdrPageId;
+    do
+    {
+        HeapFileHdr *hdr = (HeapFileHdr *)GetPage(cur);
+        LatchBuffer((uint8_t *)hdr, BUFFER_LATCH_SHARED);
+
+        for (int i = 0; i < hdr->nb_data_pages; i++)
+        {
+            PageId *data = findHdrPageId(rel, "data", hdr->pages[i].pageId);
+            if (data) // Otherwise no record is inserted there
+                addFreeSpaceMap(fsm, data, cur, i, hdr->pages[i].free);
+        }
+        // A missing header ends the chain, the data pages of the next headers get no record
+        PageId *next = hdr->has_next ? findHdrPageId(rel, "header", hdr->next) : NULL;
+
+        UnlatchBuffer((uint8_t *)hdr);
+        FreePage(cur, 0);
+        cur = next;
+    } while (cur);
+
+    rel->fsm = fsm;
+    return fsm;
+}
+
+// Adds the empty page data after the last data page of rel, 0 if no header page is left to list it
+static int linkDataPage(Relation *rel, PageId *data, BufferAccessStrategy *strategy)
 {
     HeapFileHdr *hdr = (HeapFileHdr *)GetPage(rel->tailHdrPageId);
     size_t cur_hdr_sz = offsetof(HeapFileHdr, pages) + hdr->nb_data_pages * sizeof(HeapFileDataDesc); // can sizeof hdr because flexible array at the HeapFileHdr structure's end
-    FreePage(rel->tailHdrPageId, 0);
 
     if (cur_hdr_sz + sizeof(HeapFileDataDesc) > config->pagesize)
     {
         assert(!hdr->has_next);
 
-        FreePage(rel->tailHdrPageId, 0);
         PageId *next = AllocPage();
         if (!next)
-            return;
+        {
+            FreePage(rel->tailHdrPageId, 0);
+            return 0;
+        }
         hdr->has_next = 1;
         hdr->next = *next;
+        FreePage(rel->tailHdrPageId, 1);
 
         HeapFileHdr *new_hdr = (HeapFileHdr *)GetPage(next);
         new_hdr->has_next = 0;
         new_hdr->has_prev = 1;
         new_hdr->prev = *rel->tailHdrPageId;
         new_hdr->nb_data_pages = 0;
+        FreePage(next, 1);
 
-        FreePage(rel->tailHdrPageId, 1);
         rel->tailHdrPageId = next;
-
-        hdr = new_hdr;
     }
+    else
+        FreePage(rel->tailHdrPageId, 0);
 
-    PageId *data = AllocPage();
-    if (!data)
-        return;
-
-    HeapFileDataPage *sd = getDataPage(data);
+    HeapFileDataPage *sd = getDataPageStrategy(data, strategy);
+    LatchBuffer(sd->head, BUFFER_LATCH_EXCLUSIVE);
     sd->directory->first_free = 0;
     sd->directory->nb_slots = 0;
+    UnlatchBuffer(sd->head);
     freeDataPage(sd, 1);
 
+    const uint32_t free_bytes = config->pagesize - sizeof(SlotDirectory);
     hdr = (HeapFileHdr *)GetPage(rel->tailHdrPageId);
-    hdr->pages[hdr->nb_data_pages].free = config->pagesize - sizeof(SlotDirectory);
-    hdr->pages[hdr->nb_data_pages].pageId = *data;
+    const int idx = hdr->nb_data_pages;
+    hdr->pages[idx].free = free_bytes;
+    hdr->pages[idx].pageId = *data;
 
     hdr->nb_data_pages++;
     FreePage(rel->tailHdrPageId, 1);
+
+    if (rel->fsm)
+        addFreeSpaceMap(rel->fsm, data, rel->tailHdrPageId, idx, free_bytes);
+    return 1;
 }
 
-PageId *getFreeDataPage(const Relation *rel, size_t record_size)
+void addDataPage(Relation *rel, BufferAccessStrategy *strategy)
 {
-    PageId *next = rel->headHdrPageId;
+    PageId *data = AllocPage();
+    if (data && !linkDataPage(rel, data, strategy))
+        DeallocPage(data);
+}
 
-    do
+// Same as count addDataPage(), with consecutive pages so a bulk insert fills them in disk order
+static void addDataPages(Relation *rel, size_t count, BufferAccessStrategy *strategy)
+{
+    PageId **pages = count > 1 ? malloc(count * sizeof *pages) : NULL;
+    if (!pages || !AllocPages(pages, (int)count))
     {
-        HeapFileHdr *hdr = (HeapFileHdr *)GetPage(next);
-        PageId *res = NULL;
-
-        uint8_t found = 0;
-        for (size_t i = 0; i < hdr->nb_data_pages; i++)
-        {
-            if (record_size + sizeof(SlotDirectoryEntry) <= hdr->pages[i].free)
-            {
-                found = 1;
-                res = FindPageId(hdr->pages[i].pageId);
-                break;
-            }
-        }
+        free(pages);
+        addDataPage(rel, strategy);
+        return;
+    }
 
-        FreePage(next, 0);
+    size_t k = 0;
+    while (k < count && linkDataPage(rel, pages[k], strategy))
+        k++;
+    while (k < count)
+        DeallocPage(pages[k++]);
+    free(pages);
+}
 
-        if (found)
-            return res;
+/*
+*   Params :
+*       - rel
+*       - record_size : size of the record written by writeRecordToDataPage()
+*
+*   Return :
+*       - The first data page (in header order) with room for the record and its slot, NULL if there's none
+*
+*   Notes :
+*       - O(log n) lookup in the free space map of the relation, built from the header pages on the first call
+*/
+PageId *getFreeDataPage(Relation *rel, size_t record_size)
+{
+    FreeSpaceMap *fsm = getFreeSpaceMap(rel);
+    if (!fsm)
+        return NULL;
 
-        next = hdr->has_next ? &hdr->next : NULL;
-    } while (next);
+    const size_t needed = record_size + sizeof(SlotDirectoryEntry);
+    if (needed > UINT32_MAX)
+        return NULL;
 
-    return NULL;
+    const int slot = searchFreeSpaceMap(fsm, (uint32_t)needed);
+    return slot == -1 ? NULL : fsm->slots[slot].pageId;
 }
 
-RecordId writeRecordToDataPage(const Record *record, PageId *pageId)
+// Writes record in a deleted slot large enough, or in a new slot after the last record, the page must be latched
+static RecordId placeRecord(HeapFileDataPage *data_page, const Record *record)
 {
-    HeapFileDataPage *data_page = getDataPage(pageId);
     SlotDirectory *dir = data_page->directory;
     RecordId rid;
-    rid.page_id = pageId;
+    rid.page_id = data_page->page_id;
     rid.slot_idx = 0;
 
     // Search free slot (in case of record deletion)
     SlotDirectoryEntry *free_entry = NULL;
-    SlotDirectoryEntry *tail = data_page->entriesTail;
+    SlotDirectoryEntry *tail = data_page->entriesTail - 1;
     for (size_t i = 0; i < dir->nb_slots; i++, tail--)
     {
         if (tail->size_record == 0)
         {
             // May lead to fragmentation... in case of new record too small to fill completely the record
-            size_t start_next = i + 1 < dir->nb_slots ? (tail - 1)->start_record : 0;
+            size_t start_next = i + 1 < dir->nb_slots ? (tail - 1)->start_record : dir->first_free;
             size_t cur_max_size = start_next - tail->start_record;
 
             if (cur_max_size >= record->io.length)
@@ -187,9 +263,9 @@ RecordId writeRecordToDataPage(const Record *record, PageId *pageId)
     if (!free_entry)
     {
         // Create a new slot...
-        free_entry = data_page->entriesTail - data_page->directory->nb_slots - 1;
-        free_entry->start_record = data_page->directory->first_free;
-        rid.slot_idx = data_page->directory->nb_slots;
+        free_entry = data_page->entriesTail - dir->nb_slots - 1;
+        free_entry->start_record = dir->first_free;
+        rid.slot_idx = dir->nb_slots;
         is_new_slot = 1;
     }
 
@@ -197,45 +273,84 @@ RecordId writeRecordToDataPage(const Record *record, PageId *pageId)
     free_entry->size_record = written;
 
     if (is_new_slot)
-        data_page->directory->first_free += written;
-
-    data_page->directory->nb_slots++;
-    freeDataPage(data_page, 1);
-
-    HeapFileHdr *hdr = (HeapFileHdr *)GetPage(record->rel->headHdrPageId);
-    for (size_t i = 0; i < hdr->nb_data_pages; i++)
     {
-        if (hdr->pages[i].pageId.FileIdx == pageId->FileIdx && hdr->pages[i].pageId.PageIdx == pageId->PageIdx)
-        {
-            hdr->pages[i].free -= written + sizeof(SlotDirectoryEntry);
-            break;
-        }
+        dir->first_free += written;
+        dir->nb_slots++;
     }
-    FreePage(record->rel->headHdrPageId, 1);
+
     return rid;
 }
 
-RecordList *getRecordsInDataPage(Relation *rel, PageId *pageId)
+/*
+*   Params :
+*       - records : records to write, records[0] fits in the page
+*       - n : number of records
+*       - pageId : data page of records[0]->rel
+*       - strategy : used to pin the data page, can be NULL
+*       - rids : filled with the RecordId of each record written, can be NULL
+*
+*   Return :
+*       - Number of records written, the first ones of records
+*
+*   Description :
+*       Writes records[0], then the following records as long as they would have been written in this page one by one,
+*       i.e. they belong to the same relation and this page is still the first one with enough room for them.
+*       The data page is pinned once, its header entry is updated once.
+*/
+static size_t writeRecordsToDataPage(const Record **records, size_t n, PageId *pageId, BufferAccessStrategy *strategy, RecordId *rids)
 {
-    HeapFileDataPage *data_page = getDataPage(pageId);
-    RecordList *records = newRecordList();
-    if (!records)
-        return NULL;
+    Relation *rel = records[0]->rel;
+    FreeSpaceMap *fsm = getFreeSpaceMap(rel);
+    const int slot = fsm ? findFreeSpaceMap(fsm, pageId) : -1;
+    uint32_t free_bytes = slot != -1 ? readFreeSpaceMap(fsm, slot) : 0;
+    uint32_t used = 0;
 
-    SlotDirectoryEntry *tail = data_page->entriesTail - 1;
-    for (size_t i = 0; i < data_page->directory->nb_slots; i++, tail--)
+    HeapFileDataPage *data_page = getDataPageStrategy(pageId, strategy);
+    LatchBuffer(data_page->head, BUFFER_LATCH_EXCLUSIVE);
+
+    size_t k = 0;
+    for (; k < n; k++)
     {
-        if (tail->size_record == 0)
-            continue;
+        const uint32_t needed = records[k]->io.length + sizeof(SlotDirectoryEntry);
+        if (k && (slot == -1 || records[k]->rel != rel || searchFreeSpaceMap(fsm, needed) != slot))
+            break;
 
-        Record *record = newRecord(rel);
-        readFromBuffer(record, data_page->head, tail->start_record);
+        const RecordId rid = placeRecord(data_page, records[k]);
+        if (rids)
+            rids[k] = rid;
 
-        appendRecordList(records, record);
+        used += needed;
+        if (slot != -1)
+        {
+            free_bytes -= needed;
+            updateFreeSpaceMap(fsm, slot, free_bytes);
+        }
     }
 
-    freeDataPage(data_page, 0);
-    return records;
+    UnlatchBuffer(data_page->head);
+    freeDataPage(data_page, 1);
+
+    if (slot == -1)
+        return k;
+
+    // The descriptor of the page can be in any header page, the free space map knows which one
+    PageId *hdrPageId = fsm->slots[slot].hdrPageId;
+    const int idx = fsm->slots[slot].hdrIdx;
+
+    HeapFileHdr *hdr = (HeapFileHdr *)GetPage(hdrPageId);
+    LatchBuffer((uint8_t *)hdr, BUFFER_LATCH_EXCLUSIVE);
+    hdr->pages[idx].free -= used;
+    UnlatchBuffer((uint8_t *)hdr);
+    FreePage(hdrPageId, 1);
+
+    return k;
+}
+
+RecordId writeRecordToDataPage(const Record *record, PageId *pageId, BufferAccessStrategy *strategy)
+{
+    RecordId rid;
+    writeRecordsToDataPage(&record, 1, pageId, strategy, &rid);
+    return rid;
 }
 
 HeapFilePageIdList *getDataPages(const Relation *rel)
@@ -248,41 +363,625 @@ HeapFilePageIdList *getDataPages(const Relation *rel)
         HeapFileHdr *hdr = (HeapFileHdr *)GetPage(curPageId);
 
         for (size_t i = 0; i < hdr->nb_data_pages; i++)
-            appendPageIdList(list, FindPageId(hdr->pages[i].pageId));
+        {
+            PageId *data = findHdrPageId(rel, "data", hdr->pages[i].pageId);
+            if (data)
+                appendPageIdList(list, data);
+        }
+        PageId *next = hdr->has_next ? findHdrPageId(rel, "header", hdr->next) : NULL;
 
         FreePage(curPageId, 0);
 
-        curPageId = hdr->has_next ? &hdr->next : NULL;
+        curPageId = next;
     } while (curPageId);
 
     return list;
 }
 
+// Adds the entry of record to every index of its relation
+static void indexRecord(const Record *record, RecordId rid)
+{
+    const Relation *rel = record->rel;
+
+    for (int i = 0; i < rel->nb_indexes; i++)
+    {
+        const RelationIndex *index = rel->indexes + i;
+        const uint8_t *key = record->data + record->offsets[index->col];
+        const int ok = index->kind == INDEX_HASH ? HashIndexInsert(index->metaPageId, key, rid)
+            : BTreeInsert(index->metaPageId, key, rid);
+        if (!ok)
+            fprintf(stderr, "error: index %s of %s: no page left for the entry of a record\n", index->name, rel->name);
+    }
+}
+
 RecordId InsertRecord(const Record *record)
 {
-    PageId *pageId = getFreeDataPage(record->rel, record->io.length);
+    return InsertRecordWithStrategy(record, NULL);
+}
+
+// Data pages go through strategy, header pages stay cached normally
+RecordId InsertRecordWithStrategy(const Record *record, BufferAccessStrategy *strategy)
+{
+    RecordId rid = {0, NULL};
+    InsertRecordsWithStrategy(&record, 1, strategy, &rid);
+    return rid;
+}
+
+size_t InsertRecords(const Record **records, size_t n)
+{
+    return InsertRecordsWithStrategy(records, n, NULL, NULL);
+}
 
-    if (!pageId)
+/*
+*   Params :
+*       - records : records to insert, each in its own relation (usually the same one)
+*       - n : number of records
+*       - strategy : used to pin the data pages, can be NULL
+*       - rids : filled with the RecordId of each record inserted, can be NULL
+*
+*   Return :
+*       - Number of records inserted, less than n only if a record doesn't fit in an empty page or no page is left
+*
+*   Description :
+*       Same pages as n InsertRecord() calls, but the consecutive records that go in the same data page are written
+*       under a single pin of the page and a single update of its header entry.
+*       A record that can't be inserted is skipped, its RecordId in rids has a NULL page_id, the others are inserted.
+*/
+size_t InsertRecordsWithStrategy(const Record **records, size_t n, BufferAccessStrategy *strategy, RecordId *rids)
+{
+    // The indexes need the RecordId of every record
+    RecordId *ownRids = NULL;
+    for (size_t k = 0; k < n && !rids; k++)
     {
-        addDataPage(record->rel);
-        pageId = getFreeDataPage(record->rel, record->io.length);
+        if (records[k]->rel->nb_indexes)
+        {
+            ownRids = malloc(n * sizeof *ownRids);
+            if (!ownRids)
+            {
+                perror("error: malloc insert records:");
+                abort();
+            }
+            rids = ownRids;
+        }
     }
 
-    return writeRecordToDataPage(record, pageId);
+    // Room of an empty data page, a larger record would only get a new page it doesn't fit in
+    const size_t max_needed = config->pagesize - sizeof(SlotDirectory);
+
+    size_t done = 0, inserted = 0;
+    while (done < n)
+    {
+        Relation *rel = records[done]->rel;
+        const int fits = records[done]->io.length + sizeof(SlotDirectoryEntry) <= max_needed;
+        PageId *pageId = fits ? getFreeDataPage(rel, records[done]->io.length) : NULL;
+
+        if (!pageId && fits)
+        {
+            // Pages for the following records of rel as well, at least as many as they fill
+            size_t needed = 0;
+            for (size_t k = done; k < n && records[k]->rel == rel; k++)
+                if (records[k]->io.length + sizeof(SlotDirectoryEntry) <= max_needed)
+                    needed += records[k]->io.length + sizeof(SlotDirectoryEntry);
+            addDataPages(rel, (needed + max_needed - 1) / max_needed, strategy);
+            pageId = getFreeDataPage(rel, records[done]->io.length);
+        }
+        if (!pageId)
+        {
+            if (rids)
+                rids[done] = (RecordId){0, NULL};
+            done++;
+            continue;
+        }
+
+        const size_t written = writeRecordsToDataPage(records + done, n - done, pageId, strategy, rids ? rids + done : NULL);
+        done += written;
+        inserted += written;
+    }
+
+    for (size_t k = 0; k < n; k++)
+        if (records[k]->rel->nb_indexes && rids[k].page_id)
+            indexRecord(records[k], rids[k]);
+    free(ownRids);
+
+    return inserted;
 }
 
 RecordList *GetAllRecords(Relation *rel)
 {
-    HeapFilePageIdList *list = getDataPages(rel);
     RecordList *records = newRecordList();
+    HeapScan *scan = HeapScanOpen(rel);
+    if (!scan)
+        return records;
 
-    for (size_t i = 0; i < list->length; i++)
+    for (const Record *view; (view = HeapScanNext(scan));)
     {
-        RecordList *intList = getRecordsInDataPage(rel, list->page_ids[i]);
-        concatRecordList(records, intList);
-        freeRecordList(intList);
+        Record *record = newRecord(rel);
+        readFromBuffer(record, view->io.start, 0);
+        appendRecordList(records, record);
     }
 
-    freePageIdList(list);
+    HeapScanClose(scan);
     return records;
-}
\ No newline at end of file
+}
+
+HeapScan *HeapScanOpen(Relation *rel)
+{
+    return HeapScanOpenFiltered(rel, NULL, NULL, NULL, 0);
+}
+
+/*
+*   Params :
+*       - rel
+*       - filter : records for which it returns 0 are skipped, NULL to return every record
+*       - filterArg : given to filter
+*       - columns : fields of rel decoded in scan->values for each record returned, can be NULL
+*       - nb_columns : number of columns
+*
+*   Return :
+*       - The scan, to give to HeapScanNext() and HeapScanClose()
+*
+*   Description :
+*       The filter runs on the record in its page, before the record is returned, and only the requested columns of the
+*       records that pass it are decoded.
+*/
+HeapScan *HeapScanOpenFiltered(Relation *rel, HeapScanFilter filter, void *filterArg, const int *columns, int nb_columns)
+{
+    HeapScan *scan = calloc(1, sizeof *scan);
+    if (!scan)
+        return NULL;
+
+    scan->rel = rel;
+    scan->nextHdrPageId = rel->headHdrPageId;
+    scan->pages = malloc((config->pagesize - offsetof(HeapFileHdr, pages)) / sizeof(HeapFileDataDesc) * sizeof *scan->pages);
+    if (!scan->pages)
+    {
+        perror("error: malloc heap scan:");
+        abort();
+    }
+    // The data pages of a scan are read once, they recycle a ring instead of evicting the cached pages
+    scan->strategy = GetAccessStrategy(BAS_BULKREAD);
+    scan->view.rel = rel;
+
+    // A dynamic record starts with its offsets, the view points to them
+    if (!rel->is_dynamic)
+    {
+        scan->offsets = calloc(rel->nb_fields + 1, sizeof *scan->offsets);
+        if (!scan->offsets)
+        {
+            perror("error: malloc heap scan:");
+            abort();
+        }
+        for (int i = 1; i <= rel->nb_fields; i++)
+            scan->offsets[i] = scan->offsets[i - 1] + FIELD_SIZEOF(rel, i - 1);
+        scan->view.offsets = scan->offsets;
+    }
+
+    scan->filter = filter;
+    scan->filterArg = filterArg;
+    if (nb_columns)
+    {
+        scan->columns = malloc(nb_columns * sizeof *scan->columns);
+        scan->values = calloc(nb_columns, sizeof *scan->values);
+        if (!scan->columns || !scan->values)
+        {
+            perror("error: malloc heap scan:");
+            abort();
+        }
+        memcpy(scan->columns, columns, nb_columns * sizeof *scan->columns);
+        scan->nb_columns = nb_columns;
+    }
+
+    return scan;
+}
+
+/*
+*   Params :
+*       - scan : opened, not yet read
+*       - filters : conditions on INT and REAL fields of the relation, every one must hold
+*       - nb_filters : number of filters
+*
+*   Description :
+*       Unlike the filter given to HeapScanOpenFiltered(), filters are evaluated over every slot of a page at once
+*       with FilterColumn() when the page holds fixed size records at a constant stride, i.e. for a non dynamic relation.
+*       They are checked one record at a time otherwise, the filter of the scan then only runs on the records that
+*       pass them.
+*/
+void HeapScanSetColumnFilters(HeapScan *scan, const ColumnFilter *filters, int nb_filters)
+{
+    if (!nb_filters)
+        return;
+
+    scan->colFilters = malloc(nb_filters * sizeof *scan->colFilters);
+    if (!scan->colFilters)
+    {
+        perror("error: malloc heap scan:");
+        abort();
+    }
+    memcpy(scan->colFilters, filters, nb_filters * sizeof *scan->colFilters);
+    scan->nb_colFilters = nb_filters;
+
+    if (scan->offsets)
+    {
+        // A record takes at least one byte and its slot entry
+        const size_t max_slots = config->pagesize / (sizeof(SlotDirectoryEntry) + 1);
+        scan->selection = calloc(max_slots / 64 + 1, sizeof *scan->selection);
+        if (!scan->selection)
+        {
+            perror("error: malloc heap scan:");
+            abort();
+        }
+    }
+}
+
+// Evaluates the column filters of scan on every slot of its newly pinned page, if its records are at a constant stride
+static void selectPage(HeapScan *scan)
+{
+    const HeapFileDataPage *page = scan->page;
+    const uint32_t stride = scan->offsets[scan->rel->nb_fields];
+
+    scan->nb_selected = 0;
+    LatchBuffer(page->head, BUFFER_LATCH_SHARED);
+
+    const uint32_t nb_slots = page->directory->nb_slots;
+    memset(scan->selection, 0, (nb_slots + 63) / 64 * sizeof *scan->selection);
+    // A deleted slot is only reused by a record of the same size, at the same place
+    int strided = stride && page->directory->first_free == nb_slots * stride;
+    for (uint32_t i = 0; strided && i < nb_slots; i++)
+    {
+        const SlotDirectoryEntry *entry = page->entriesTail - 1 - i;
+        strided = entry->start_record == i * stride;
+        if (entry->size_record)
+            scan->selection[i / 64] |= 1ULL << i % 64;
+    }
+
+    if (strided)
+    {
+        for (int k = 0; k < scan->nb_colFilters; k++)
+        {
+            const ColumnFilter *filter = scan->colFilters + k;
+            FilterColumn(filter, page->head + scan->offsets[filter->col], stride, nb_slots, scan->selection);
+        }
+        scan->nb_selected = nb_slots;
+    }
+
+    UnlatchBuffer(page->head);
+}
+
+// First slot at or after slot with its bit set in the selection of scan, scan->nb_selected if there is none
+static uint32_t nextSelectedSlot(const HeapScan *scan, uint32_t slot)
+{
+    size_t w = slot / 64;
+    uint64_t bits = scan->selection[w] & ~0ULL << slot % 64;
+    while (!bits)
+    {
+        if (++w * 64 >= scan->nb_selected)
+            return scan->nb_selected;
+        bits = scan->selection[w];
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+// Column filters of scan checked on its current record alone
+static int matchColumnFilters(const HeapScan *scan)
+{
+    const Record *record = &scan->view;
+
+    for (int k = 0; k < scan->nb_colFilters; k++)
+    {
+        const ColumnFilter *filter = scan->colFilters + k;
+        if (!ColumnFilterMatches(filter, record->data + record->offsets[filter->col]))
+            return 0;
+    }
+    return 1;
+}
+
+// Decodes the requested columns of the current record of scan in scan->values
+static void projectRecord(HeapScan *scan)
+{
+    const Record *record = &scan->view;
+
+    for (int k = 0; k < scan->nb_columns; k++)
+    {
+        const int col = scan->columns[k];
+        const uint8_t *field = record->data + record->offsets[col];
+        ScanValue *value = scan->values + k;
+
+        value->type = scan->rel->fieldsMetadata[col].type;
+        switch (value->type)
+        {
+        case INT:
+            memcpy(&value->i, field, sizeof value->i);
+            break;
+        case REAL:
+            memcpy(&value->f, field, sizeof value->f);
+            break;
+        default:
+            value->str.data = (const char *)field;
+            value->str.len = strnlen(value->str.data, record->offsets[col + 1] - record->offsets[col]);
+        }
+    }
+}
+
+/*
+*   Params :
+*       - scan
+*       - source : gives the RecordId of each record the scan returns, in its order
+*       - sourceArg : given to source
+*
+*   Description :
+*       Turns scan into a fetch of the records source gives, an index lookup, instead of a read of every page. The
+*       column filters, the filter and the projection of the scan still apply to each record fetched.
+*/
+void HeapScanSetSource(HeapScan *scan, HeapScanSource source, void *sourceArg)
+{
+    scan->source = source;
+    scan->sourceArg = sourceArg;
+
+    // The fetched pages are scattered, they go through the replacement policy
+    FreeAccessStrategy(scan->strategy);
+    scan->strategy = NULL;
+}
+
+// HeapScanNext() of a scan with a source, the page of the last record stays pinned until a record is in another page
+static const Record *fetchNext(HeapScan *scan)
+{
+    RecordId rid;
+    while (scan->source(scan->sourceArg, &rid))
+    {
+        if (!scan->page || scan->page->page_id != rid.page_id)
+        {
+            freeDataPage(scan->page, 0);
+            scan->page = getDataPage(rid.page_id);
+        }
+
+        LatchBuffer(scan->page->head, BUFFER_LATCH_SHARED);
+        const SlotDirectoryEntry *entry = scan->page->entriesTail - 1 - rid.slot_idx;
+        if (rid.slot_idx >= scan->page->directory->nb_slots || entry->size_record == 0)
+        {
+            UnlatchBuffer(scan->page->head);
+            continue;
+        }
+
+        viewFromBuffer(&scan->view, scan->page->head, entry->start_record, entry->size_record);
+        if (!matchColumnFilters(scan) || (scan->filter && !scan->filter(&scan->view, scan->filterArg)))
+        {
+            UnlatchBuffer(scan->page->head);
+            continue;
+        }
+        projectRecord(scan);
+        scan->rid = rid;
+
+        UnlatchBuffer(scan->page->head);
+        return &scan->view;
+    }
+
+    freeDataPage(scan->page, 0);
+    scan->page = NULL;
+    return NULL;
+}
+
+/*
+*   Params :
+*       - scan
+*
+*   Return :
+*       - The next record of the relation that passes the filter, its requested columns decoded in scan->values,
+*         NULL once every record has been returned
+*
+*   Description :
+*       The record is a read-only view into the pinned frame of its data page, no record is allocated or copied.
+*       It stays valid until the next call, the page is released when the scan moves to the next page.
+*       The header pages are read one at a time as the scan reaches them, its memory doesn't depend on the table size.
+*
+*   Notes :
+*       - The bytes of a record aren't latched between two calls, records are never moved or updated in place
+*/
+const Record *HeapScanNext(HeapScan *scan)
+{
+    if (scan->source)
+        return fetchNext(scan);
+
+    for (;;)
+    {
+        if (scan->page)
+        {
+            LatchBuffer(scan->page->head, BUFFER_LATCH_SHARED);
+            const uint32_t nb_slots = scan->page->directory->nb_slots;
+            while (scan->nextSlot < nb_slots)
+            {
+                // The selected slots already passed the column filters, the others are skipped without being read
+                if (scan->nextSlot < scan->nb_selected)
+                {
+                    scan->nextSlot = nextSelectedSlot(scan, scan->nextSlot);
+                    if (scan->nextSlot >= nb_slots)
+                        break;
+                }
+                const int selected = scan->nextSlot < scan->nb_selected;
+
+                const SlotDirectoryEntry *entry = scan->page->entriesTail - 1 - scan->nextSlot++;
+                if (entry->size_record == 0)
+                    continue;
+
+                viewFromBuffer(&scan->view, scan->page->head, entry->start_record, entry->size_record);
+                if (!selected && !matchColumnFilters(scan))
+                    continue;
+                if (scan->filter && !scan->filter(&scan->view, scan->filterArg))
+                    continue;
+                projectRecord(scan);
+                scan->rid.page_id = scan->page->page_id;
+                scan->rid.slot_idx = scan->nextSlot - 1;
+
+                UnlatchBuffer(scan->page->head);
+                return &scan->view;
+            }
+            UnlatchBuffer(scan->page->head);
+
+            freeDataPage(scan->page, 0);
+            scan->page = NULL;
+        }
+
+        if (scan->nextPage >= scan->nb_pages)
+        {
+            if (!scan->nextHdrPageId)
+                return NULL;
+
+            PageId *hdrPageId = scan->nextHdrPageId;
+            HeapFileHdr *hdr = (HeapFileHdr *)GetPage(hdrPageId);
+            LatchBuffer((uint8_t *)hdr, BUFFER_LATCH_SHARED);
+            // Missing pages are skipped, a missing header ends the scan
+            scan->nb_pages = 0;
+            for (int i = 0; i < hdr->nb_data_pages; i++)
+                if ((scan->pages[scan->nb_pages] = findHdrPageId(scan->rel, "data", hdr->pages[i].pageId)))
+                    scan->nb_pages++;
+            scan->nextHdrPageId = hdr->has_next ? findHdrPageId(scan->rel, "header", hdr->next) : NULL;
+            UnlatchBuffer((uint8_t *)hdr);
+            FreePage(hdrPageId, 0);
+
+            scan->nextPage = 0;
+            scan->prefetched = 0;
+            continue;
+        }
+
+        const size_t i = scan->nextPage++;
+        if (i >= scan->prefetched)
+        {
+            const size_t nb = PrefetchPages(scan->pages + i, scan->nb_pages - i, scan->strategy);
+            scan->prefetched = i + (nb ? nb : 1);
+        }
+
+        scan->page = getDataPageStrategy(scan->pages[i], scan->strategy);
+        scan->nextSlot = 0;
+        scan->nb_selected = 0;
+        if (scan->selection)
+            selectPage(scan);
+    }
+}
+
+void HeapScanClose(HeapScan *scan)
+{
+    if (!scan)
+        return;
+
+    freeDataPage(scan->page, 0);
+    FreeAccessStrategy(scan->strategy);
+    free(scan->pages);
+    free(scan->offsets);
+    free(scan->columns);
+    free(scan->values);
+    free(scan->colFilters);
+    free(scan->selection);
+    free(scan);
+}
+
+void AddRelationIndex(Relation *rel, const char *name, IndexKind kind, int col, PageId *metaPageId)
+{
+    RelationIndex *indexes = realloc(rel->indexes, (rel->nb_indexes + 1) * sizeof *indexes);
+    if (!indexes)
+    {
+        perror("error: malloc relation index:");
+        abort();
+    }
+    rel->indexes = indexes;
+
+    RelationIndex *index = rel->indexes + rel->nb_indexes++;
+    index->name = strdup(name);
+    index->kind = kind;
+    index->col = col;
+    index->metaPageId = metaPageId;
+}
+
+/*
+*   Params :
+*       - rel
+*       - name : name of the index
+*       - kind : INDEX_BTREE or INDEX_HASH
+*       - col : field of rel, INT, REAL or CHAR
+*
+*   Return :
+*       - 1 if the index was created, 0 if col can't be indexed or no page could be allocated
+*
+*   Description :
+*       Builds the index from the records of rel, the following insertions then maintain it.
+*/
+int CreateRelationIndex(Relation *rel, const char *name, IndexKind kind, int col)
+{
+    const FieldType type = rel->fieldsMetadata[col].type;
+    if (type == VARCHAR)
+        return 0;
+
+    PageId *metaPageId = kind == INDEX_HASH ? HashIndexCreate(type, FIELD_SIZEOF(rel, col))
+        : BTreeCreate(type, FIELD_SIZEOF(rel, col));
+    if (!metaPageId)
+        return 0;
+    void (*drop)(PageId *) = kind == INDEX_HASH ? HashIndexDrop : BTreeDrop;
+
+    HeapScan *scan = HeapScanOpen(rel);
+    if (!scan)
+    {
+        drop(metaPageId);
+        return 0;
+    }
+
+    // The entries of every record, written in one pass by BTreeBuild() or HashIndexBuild()
+    const size_t keysize = FIELD_SIZEOF(rel, col), entrysize = keysize + sizeof(BTreeRid);
+    size_t nb_entries = 0, capacity = 1024;
+    uint8_t *entries = malloc(capacity * entrysize);
+    if (!entries)
+    {
+        perror("error: malloc relation index:");
+        abort();
+    }
+    for (const Record *view; (view = HeapScanNext(scan));)
+    {
+        if (nb_entries == capacity)
+        {
+            capacity *= 2;
+            uint8_t *tmp = realloc(entries, capacity * entrysize);
+            if (!tmp)
+            {
+                perror("error: malloc relation index:");
+                abort();
+            }
+            entries = tmp;
+        }
+
+        const BTreeRid rid = {.pageId = *scan->rid.page_id, .slot_idx = scan->rid.slot_idx};
+        memcpy(entries + nb_entries * entrysize, view->data + view->offsets[col], keysize);
+        memcpy(entries + nb_entries * entrysize + keysize, &rid, sizeof rid);
+        nb_entries++;
+    }
+    HeapScanClose(scan);
+
+    const int ok = kind == INDEX_HASH ? HashIndexBuild(metaPageId, entries, nb_entries)
+        : BTreeBuild(metaPageId, entries, nb_entries);
+    free(entries);
+    if (!ok)
+    {
+        drop(metaPageId);
+        return 0;
+    }
+
+    AddRelationIndex(rel, name, kind, col, metaPageId);
+    return 1;
+}
+
+// Deallocates the pages of the index, 0 if rel has no index of this name
+int DropRelationIndex(Relation *rel, const char *name)
+{
+    for (int i = 0; i < rel->nb_indexes; i++)
+    {
+        RelationIndex *index = rel->indexes + i;
+        if (strcmp(index->name, name) != 0)
+            continue;
+
+        if (index->kind == INDEX_HASH)
+            HashIndexDrop(index->metaPageId);
+        else
+            BTreeDrop(index->metaPageId);
+        free(index->name);
+        memmove(index, index + 1, (rel->nb_indexes - i - 1) * sizeof *index);
+        rel->nb_indexes--;
+        return 1;
+    }
+    return 0;
+}
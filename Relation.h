@@ -2,6 +2,10 @@
 #ifndef SHINBDDA_RELATION_H
 #define SHINBDDA_RELATION_H
 
+#include "BTree.h"
+#include "FilterKernels.h"
+#include "FreeSpaceMap.h"
+#include "HashIndex.h"
 #include "HeapFile.h"
 #include "Structures.h"
 #include "Record.h"
@@ -18,6 +22,22 @@ struct FieldMetadata{
     size_t len; // Used for Fixed length String
 };
 
+typedef enum IndexKind {
+    INDEX_BTREE, // Equality and ranges
+    INDEX_HASH, // Equality only, a bucket read per lookup
+} IndexKind;
+
+typedef struct RelationIndex
+/*
+*   Secondary index on a field of a relation, maintained by InsertRecords()
+*/
+{
+    char *name;
+    IndexKind kind;
+    int col; // INT, REAL or CHAR field
+    PageId *metaPageId; // Identifies the tree or the hash index, see BTreeCreate() and HashIndexCreate()
+} RelationIndex;
+
 struct Relation {
     uint64_t oid;
     const char *name;
@@ -27,18 +47,91 @@ struct Relation {
 
     PageId *headHdrPageId;
     PageId *tailHdrPageId;
+
+    FreeSpaceMap *fsm; // Free bytes of each data page, NULL until the first insertion builds it from the header pages
+
+    RelationIndex *indexes;
+    int nb_indexes;
 };
 
+typedef int (*HeapScanFilter)(const Record *record, void *arg); // Non zero if the scan returns record
+typedef int (*HeapScanSource)(void *arg, RecordId *rid); // Sets the next record to fetch, 0 at the end
+
+typedef struct ScanValue
+/*
+*   Field of a record decoded by a scan, a string points into the pinned page
+*/
+{
+    FieldType type;
+    union
+    {
+        int i;
+        float f;
+        struct
+        {
+            const char *data;
+            size_t len; // Up to the first '\0', fixed length strings are padded with zeros
+        } str;
+    };
+} ScanValue;
+
+typedef struct HeapScan
+/*
+*   Cursor over the records of a relation, in the order of GetAllRecords(), see HeapScanNext()
+*/
+{
+    Relation *rel;
+    PageId *nextHdrPageId; // Header page read once every page of pages is scanned, NULL after the tail header
+    PageId **pages; // Data pages of the last header page read, the scan never holds more than one header's pages
+    size_t nb_pages;
+    size_t nextPage; // Index in pages of the page pinned after the current one
+    size_t prefetched; // Pages before this index have been read ahead
+    BufferAccessStrategy *strategy;
+
+    HeapFileDataPage *page; // Pinned page of the current record, NULL before the first page and at the end
+    uint32_t nextSlot; // Slot of page examined by the next call
+
+    Record view; // Current record, points into the frame of page
+    RecordId rid; // Of view
+    uint32_t *offsets; // Field offsets of a non dynamic relation, the same for every record
+
+    HeapScanFilter filter; // Pushed down predicate, evaluated on the page bytes before a record is returned, can be NULL
+    void *filterArg;
+    int *columns; // Fields decoded in values for each record returned, in this order
+    int nb_columns;
+    ScanValue *values;
+
+    ColumnFilter *colFilters; // Evaluated on the whole page at once when its records are at a constant stride
+    int nb_colFilters;
+    uint64_t *selection; // Bit i set if slot i of page passes colFilters
+    uint32_t nb_selected; // Slots of page covered by selection, the following ones are filtered one by one
+
+    HeapScanSource source; // Records fetched instead of reading every page, NULL for a sequential scan
+    void *sourceArg;
+} HeapScan;
+
 Relation *new_relation(const char *name, int nb_fields, FieldMetadata *fields);
 size_t relation_alloc_size(const Relation *relation);
-void addDataPage(Relation *rel);
-PageId *getFreeDataPage(const Relation *rel, size_t record_size);
-RecordId writeRecordToDataPage(const Record *record, PageId *pageId);
-RecordList *getRecordsInDataPage(Relation *rel, PageId *pageId);
+void addDataPage(Relation *rel, BufferAccessStrategy *strategy);
+PageId *getFreeDataPage(Relation *rel, size_t record_size);
+RecordId writeRecordToDataPage(const Record *record, PageId *pageId, BufferAccessStrategy *strategy);
 HeapFilePageIdList *getDataPages(const Relation *rel);
 
 RecordId InsertRecord(const Record *record);
+RecordId InsertRecordWithStrategy(const Record *record, BufferAccessStrategy *strategy);
+size_t InsertRecords(const Record **records, size_t n);
+size_t InsertRecordsWithStrategy(const Record **records, size_t n, BufferAccessStrategy *strategy, RecordId *rids);
 RecordList *GetAllRecords(Relation *rel);
+HeapScan *HeapScanOpen(Relation *rel);
+HeapScan *HeapScanOpenFiltered(Relation *rel, HeapScanFilter filter, void *filterArg, const int *columns, int nb_columns);
+void HeapScanSetColumnFilters(HeapScan *scan, const ColumnFilter *filters, int nb_filters);
+void HeapScanSetSource(HeapScan *scan, HeapScanSource source, void *sourceArg);
+const Record *HeapScanNext(HeapScan *scan);
+void HeapScanClose(HeapScan *scan);
+
+int CreateRelationIndex(Relation *rel, const char *name, IndexKind kind, int col);
+void AddRelationIndex(Relation *rel, const char *name, IndexKind kind, int col, PageId *metaPageId);
+int DropRelationIndex(Relation *rel, const char *name);
 
 void free_relation(Relation *relation);
 
@@ -0,0 +1,165 @@
+#include "ResultSink.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+// Longest number to_chars writes, "-1.17549e-38" or an int
+static constexpr size_t NUMBER_MAX = 32;
+
+ResultSink::ResultSink(std::ostream &os)
+	: os_(os), buffer_(RESULT_BUFFER_SIZE)
+{}
+
+std::unique_ptr<ResultSink> ResultSink::create(ResultFormat format, std::ostream &os)
+{
+	switch (format)
+	{
+	case RESULT_TSV:
+		return std::make_unique<TsvSink>(os);
+	case RESULT_BINARY:
+		return std::make_unique<BinarySink>(os);
+	default:
+		return std::make_unique<TextSink>(os);
+	}
+}
+
+void ResultSink::begin()
+{
+	used_ = 0;
+	rows_ = 0;
+}
+
+void ResultSink::row(const ScanValue *values, size_t nb_values)
+{
+	format(values, nb_values);
+	rows_++;
+}
+
+void ResultSink::end()
+{
+	trailer();
+	write_out();
+	os_.flush();
+}
+
+size_t ResultSink::rows() const
+{
+	return rows_;
+}
+
+char *ResultSink::reserve(size_t bytes)
+{
+	if (bytes > buffer_.size() - used_)
+		write_out();
+	return buffer_.data() + used_;
+}
+
+void ResultSink::commit(const char *end)
+{
+	used_ = end - buffer_.data();
+}
+
+void ResultSink::append(std::string_view data)
+{
+	if (data.size() > buffer_.size() - used_)
+	{
+		write_out();
+		// Bigger than the whole buffer, goes straight to the stream
+		if (data.size() > buffer_.size())
+		{
+			os_.write(data.data(), static_cast<std::streamsize>(data.size()));
+			return;
+		}
+	}
+	memcpy(buffer_.data() + used_, data.data(), data.size());
+	used_ += data.size();
+}
+
+void ResultSink::write_out()
+{
+	os_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+	used_ = 0;
+}
+
+void TextSink::format(const ScanValue *values, size_t nb_values)
+{
+	for (size_t i = 0; i < nb_values; i++)
+	{
+		if (i)
+			append(" ; ");
+
+		if (values[i].type == INT || values[i].type == REAL)
+		{
+			char *p = reserve(NUMBER_MAX);
+			// The same digits as operator<<, 6 significant ones
+			auto [end, ec] = values[i].type == INT ? std::to_chars(p, p + NUMBER_MAX, values[i].i)
+				: std::to_chars(p, p + NUMBER_MAX, values[i].f, std::chars_format::general, 6);
+			commit(end);
+		}
+		else
+			append({values[i].str.data, values[i].str.len});
+	}
+	append("\n");
+}
+
+void TextSink::trailer()
+{
+	char *p = reserve(NUMBER_MAX);
+	commit(std::to_chars(p, p + NUMBER_MAX, rows()).ptr);
+	append(" tuples.\n");
+}
+
+void TsvSink::format(const ScanValue *values, size_t nb_values)
+{
+	for (size_t i = 0; i < nb_values; i++)
+	{
+		if (i)
+			append("\t");
+
+		if (values[i].type == INT || values[i].type == REAL)
+		{
+			char *p = reserve(NUMBER_MAX);
+			auto [end, ec] = values[i].type == INT ? std::to_chars(p, p + NUMBER_MAX, values[i].i)
+				: std::to_chars(p, p + NUMBER_MAX, values[i].f);
+			commit(end);
+			continue;
+		}
+
+		const std::string_view str(values[i].str.data, values[i].str.len);
+		size_t start = 0;
+		for (size_t k = 0; k < str.size(); k++)
+		{
+			const char c = str[k];
+			if (c != '\t' && c != '\n' && c != '\\')
+				continue;
+			append(str.substr(start, k - start));
+			append(c == '\t' ? "\\t" : c == '\n' ? "\\n" : "\\\\");
+			start = k + 1;
+		}
+		append(str.substr(start));
+	}
+	append("\n");
+}
+
+void BinarySink::format(const ScanValue *values, size_t nb_values)
+{
+	for (size_t i = 0; i < nb_values; i++)
+	{
+		switch (values[i].type)
+		{
+		case INT:
+			append({reinterpret_cast<const char *>(&values[i].i), sizeof values[i].i});
+			break;
+		case REAL:
+			append({reinterpret_cast<const char *>(&values[i].f), sizeof values[i].f});
+			break;
+		default:
+			{
+				const auto len = static_cast<uint32_t>(values[i].str.len);
+				append({reinterpret_cast<const char *>(&len), sizeof len});
+				append({values[i].str.data, values[i].str.len});
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "DBConfig.h"
+#include "Relation.h"
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#define RESULT_BUFFER_SIZE (64 << 10) // Bytes of rows formatted before they're written to the stream
+
+// Output of the rows of a query. A row is formatted in a buffer kept from one query to the next, the buffer is written
+// to the stream when it is full and at the end of the query, the only time the stream is flushed.
+class ResultSink
+{
+public:
+	explicit ResultSink(std::ostream &os);
+	virtual ~ResultSink() = default;
+
+	static std::unique_ptr<ResultSink> create(ResultFormat format, std::ostream &os);
+
+	void begin();
+	void row(const ScanValue *values, size_t nb_values);
+	void end(); // Writes the pending rows and the trailer of the format, then flushes
+
+	[[nodiscard]] size_t rows() const;
+
+protected:
+	virtual void format(const ScanValue *values, size_t nb_values) = 0;
+	virtual void trailer() {}
+
+	char *reserve(size_t bytes); // bytes free at the end of the buffer, writes the buffer first if needed
+	void commit(const char *end); // The reserved bytes are used up to end
+	void append(std::string_view data);
+	void write_out();
+
+	std::ostream &os_;
+	std::vector<char> buffer_;
+	size_t used_{0};
+	size_t rows_{0};
+};
+
+// "a ; b" rows, followed by "N tuples.", as printed by the shell
+class TextSink final : public ResultSink
+{
+public:
+	using ResultSink::ResultSink;
+
+protected:
+	void format(const ScanValue *values, size_t nb_values) override;
+	void trailer() override;
+};
+
+// Tab separated rows, the floats in their shortest exact form, '\t', '\n' and '\\' escaped in the strings
+class TsvSink final : public ResultSink
+{
+public:
+	using ResultSink::ResultSink;
+
+protected:
+	void format(const ScanValue *values, size_t nb_values) override;
+};
+
+// Fields back to back in machine order, an INT or a REAL on 4 bytes, a string as its uint32 length then its bytes
+class BinarySink final : public ResultSink
+{
+public:
+	using ResultSink::ResultSink;
+
+protected:
+	void format(const ScanValue *values, size_t nb_values) override;
+};
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <ranges>
 #include <set>
 #include <stdexcept>
@@ -12,8 +13,11 @@
 #include <filesystem>
 #include <fstream>
 
+#include "QueryOperators.h"
+#include "ResultSink.h"
 #include "SelectCommand.h"
 #include <csignal>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -65,6 +69,7 @@ SGBD::SGBD(int argc, char** argv)
 	init_wd = fs::current_path();
 
 	LoadDBConfig(argv[1]);
+	result_sink_ = ResultSink::create(config->dm_result_format, std::cout);
 
     fs::path db_path(config->dbpath);
     config->need_init = !is_regular_file(db_path / "dm.save");
@@ -79,12 +84,15 @@ SGBD::SGBD(int argc, char** argv)
 	REGISTER_COMMAND("SET DATABASE", ProcessSetDatabaseCommand);
 	REGISTER_COMMAND("CREATE TABLE", ProcessCreateTableCommand);
 	REGISTER_COMMAND("DROP TABLE", ProcessDropTableCommand);
+	REGISTER_COMMAND("CREATE INDEX", ProcessCreateIndexCommand);
+	REGISTER_COMMAND("DROP INDEX", ProcessDropIndexCommand);
 	REGISTER_COMMAND("LIST TABLES", ProcessListTablesCommand);
 	REGISTER_COMMAND("DROP TABLES", ProcessDropTablesCommand);
 	REGISTER_COMMAND("DROP DATABASES", ProcessDropDatabasesCommand);
 	REGISTER_COMMAND("LIST DATABASES", ProcessListDatabasesCommand);
 	REGISTER_COMMAND("DROP DATABASE", ProcessDropDatabaseCommand);
 	REGISTER_COMMAND("QUIT", ProcessQuitCommand);
+	REGISTER_COMMAND("CHECKPOINT", ProcessCheckpointCommand);
 
 	REGISTER_COMMAND("INSERT INTO", ProcessInsertIntoCommand);
 	REGISTER_COMMAND("BULKINSERT INTO", ProcessBulkInsertIntoCommand);
@@ -119,9 +127,12 @@ void SGBD::Run()
 	for (const auto &key : command_handlers | std::views::keys) // C++ construction, should be read as pipe in bash, we have a map, and we want its keys
 		regexps.emplace(key, std::regex{key});
 
+	// No prompt when commands are piped in, so that the output only holds the results (see ResultSink)
+	const bool interactive = isatty(STDIN_FILENO);
 	while (true)
 	{
-        std::cout << "$> ";
+        if (interactive)
+            std::cout << "$> " << std::flush;
 
 		if (!std::getline(std::cin, command))
 			break;
@@ -140,13 +151,17 @@ void SGBD::Run()
                 }
                 catch (const DBCommandBadSyntax& err)
                 {
-                    std::cerr << err.what();
+                    std::cerr << err.what() << std::endl;
                 }
                 catch (const std::invalid_argument &ex)
                 {
                     std::cerr << "error: unexpected argument: " << ex.what() << std::endl;
                 }
                 catch (const std::out_of_range &ex)
+                {
+                    std::cerr << "error: " << ex.what() << std::endl;
+                }
+                catch (const QueryMemoryExceeded &ex)
                 {
                     std::cerr << "error: " << ex.what() << std::endl;
                 }
@@ -262,6 +277,51 @@ void SGBD::ProcessDropTableCommand(const std::string &command) const
 	dbManager.RemoveTableFromCurrentDatabase(match[1].str());
 }
 
+void SGBD::ProcessCreateIndexCommand(const std::string &command) const
+{
+	static std::regex regex(R"(^CREATE INDEX ([[:alnum:]]+) ON ([[:alnum:]]+) ?\((\w+)\)(?: USING (BTREE|HASH))?$)");
+	std::smatch match;
+
+	if (!std::regex_match(command, match, regex))
+		throw DBCommandBadSyntax("CREATE INDEX", "couldn't parse input");
+
+	const std::string name = match[1].str();
+	if (dbManager.GetIndexTableFromCurrentDatabase(name) != nullptr)
+		throw DBCommandBadSyntax("CREATE INDEX", "duplicated index: " + name);
+
+	const DBManager::RelationPtr rel = dbManager.GetTableFromCurrentDatabase(match[2].str());
+	if (rel == nullptr)
+		throw DBCommandBadSyntax("CREATE INDEX", "table not found: " + match[2].str());
+
+	int col = -1;
+	for (int i = 0; i < rel->nb_fields && col == -1; i++)
+		if (match[3].str() == rel->fieldsMetadata[i].name)
+			col = i;
+	if (col == -1)
+		throw DBCommandBadSyntax("CREATE INDEX", "unknown column: " + match[3].str());
+	if (rel->fieldsMetadata[col].type == VARCHAR)
+		throw DBCommandBadSyntax("CREATE INDEX", "a VARCHAR column can't be indexed: " + match[3].str());
+
+	// The records already in the table are indexed here, the insertions then keep the index up to date
+	const IndexKind kind = match[4].str() == "HASH" ? INDEX_HASH : INDEX_BTREE;
+	if (!CreateRelationIndex(rel.get(), name.c_str(), kind, col))
+		throw DBCommandBadSyntax("CREATE INDEX", "couldn't create index " + name + ": key too large or no page left");
+}
+
+void SGBD::ProcessDropIndexCommand(const std::string &command) const
+{
+	static std::regex regex("^DROP INDEX ([[:alnum:]]+)$");
+	std::smatch match;
+
+	if (!std::regex_match(command, match, regex))
+		throw DBCommandBadSyntax("DROP INDEX", "couldn't parse input");
+
+	const DBManager::RelationPtr rel = dbManager.GetIndexTableFromCurrentDatabase(match[1].str());
+	if (rel == nullptr)
+		throw DBCommandBadSyntax("DROP INDEX", "index not found: " + match[1].str());
+	DropRelationIndex(rel.get(), match[1].str().c_str());
+}
+
 void SGBD::ProcessListTablesCommand(const std::string & /*not needed, but still mandatory since it's in an array*/) const
 {
 	dbManager.ListTablesInCurrentDatabase();
@@ -292,7 +352,7 @@ void SGBD::ProcessDropDatabaseCommand(const std::string &command)
 	dbManager.RemoveDatabase(match[1].str());
 }
 
-void SGBD::recordInserter(const std::string& command, const std::string& fields_str, const DBManager::RelationPtr &rel)
+Record *SGBD::parseRecord(const std::string& command, const std::string& fields_str, const DBManager::RelationPtr &rel)
 {
 	std::vector<std::string> fields;
 	std::string current;
@@ -372,8 +432,37 @@ void SGBD::recordInserter(const std::string& command, const std::string& fields_
 		}
 	}
 
-	InsertRecord(record);
-	freeRecord(record);
+	return record;
+}
+
+void SGBD::recordInserter(const std::string& command, std::span<const std::string> lines, const DBManager::RelationPtr &rel, BufferAccessStrategy *strategy)
+{
+	std::vector<const Record *> records;
+	records.reserve(lines.size());
+
+	// Lines are inserted together, those before a bad line are still inserted as if they were inserted one by one
+	auto insert = [&records, strategy]
+	{
+		const size_t inserted = InsertRecordsWithStrategy(records.data(), records.size(), strategy, nullptr);
+		for (const Record *record : records)
+			freeRecord(const_cast<Record *>(record));
+		return records.size() - inserted;
+	};
+
+	try
+	{
+		for (const std::string &line : lines)
+			records.push_back(parseRecord(command, line, rel));
+	}
+	catch (...)
+	{
+		insert();
+		throw;
+	}
+
+	// Only the records too large for a page, or those no page was left for, are missing
+	if (const size_t missing = insert(); missing > 0)
+		throw DBCommandBadSyntax(command, "bad input: " + std::to_string(missing) + " record(s) not inserted: larger than a page or no page left");
 }
 
 void SGBD::ProcessInsertIntoCommand(const std::string& command) const
@@ -389,7 +478,8 @@ void SGBD::ProcessInsertIntoCommand(const std::string& command) const
 	if (rel == nullptr)
 		throw DBCommandBadSyntax("INSERT INTO", "table not found: " + table_name);
 
-	recordInserter("INSERT INTO", match[2].str(), rel);
+	const std::string line = match[2].str();
+	recordInserter("INSERT INTO", {&line, 1}, rel);
 }
 
 void SGBD::ProcessBulkInsertIntoCommand(const std::string& command) const
@@ -413,34 +503,57 @@ void SGBD::ProcessBulkInsertIntoCommand(const std::string& command) const
 	if (!ifs.is_open())
 		throw DBCommandBadSyntax("BULKINSERT INTO", "couldn't open file: " + match[2].str());
 
+	// The loaded pages won't be read soon, a ring keeps them from evicting the whole buffer pool
+	std::unique_ptr<BufferAccessStrategy, decltype(&FreeAccessStrategy)> strategy(GetAccessStrategy(BAS_BULKWRITE), FreeAccessStrategy);
+	std::vector<std::string> lines;
+	lines.reserve(BULKINSERT_BATCH);
 	for (std::string line; std::getline(ifs, line);)
-		recordInserter("BULKINSERT INTO", line, rel);
+	{
+		lines.push_back(std::move(line));
+		if (lines.size() == BULKINSERT_BATCH)
+		{
+			recordInserter("BULKINSERT INTO", lines, rel, strategy.get());
+			lines.clear();
+		}
+	}
+	recordInserter("BULKINSERT INTO", lines, rel, strategy.get());
 }
 
 void SGBD::ProcessSelectCommand(const std::string& command) const
 {
 	SelectCommand cmd(command);
 
-	// Replaces c style list by C++ vector (and releases directly both the c style list and the relation pointer)
-	std::vector<Record *> records;
-	{
-		const DBManager::RelationPtr rel = dbManager.GetTableFromCurrentDatabase(cmd.relation());
-		cmd.expandProjections(rel);
-
-		RecordList *rec_list = GetAllRecords(rel.get());
-		records.assign(rec_list->records, rec_list->records + rec_list->length);
-		freeRecordList(rec_list);
-	}
-
-	for (Record *rec : records)
-	{
-		cmd(std::cout, rec);
-		freeRecord(rec);
-	}
-    std::cout << cmd.nb_printed() << " tuples." << std::endl;
+	const DBManager::RelationPtr rel = dbManager.GetTableFromCurrentDatabase(cmd.relation());
+	if (rel == nullptr)
+		throw DBCommandBadSyntax("SELECT", "table not found: " + cmd.relation());
+	cmd.expandProjections(rel);
+	cmd.compileConditions(rel);
+
+	// Rows are pulled one at a time and printed as the pages are scanned, nothing is materialized. The conditions and the
+	// projection are pushed down to the scan: it filters the records in their page and decodes the projected columns only.
+	// An index of the table on a column of the conditions only fetches the records it finds.
+	MemoryBudget budget(config->dm_query_memory);
+	const std::unique_ptr<QueryOperator> plan = PlanSelect(rel.get(), budget, cmd);
+
+	// The rows go through the buffer of the sink, the output is only written when it is full and at the end
+	const size_t nb_columns = cmd.projectionColumns().size();
+	plan->open();
+	result_sink_->begin();
+	while (plan->next())
+		result_sink_->row(plan->columns(), nb_columns);
+	result_sink_->end();
+	plan->close();
 }
 
 void SGBD::ProcessQuitCommand(const std::string &/*not needed, but still mandatory since it's in an array*/) const
 {
 	handleSignal();
 }
+
+// Makes the current state durable without leaving, the buffer pool stays warm
+void SGBD::ProcessCheckpointCommand(const std::string &/*not needed, but still mandatory since it's in an array*/) const
+{
+	CheckpointBuffers();
+	dbManager.SaveState();
+	SaveState();
+}
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "DBManager.h"
+#include "ResultSink.h"
 
 #include <regex>
 #include <filesystem>
+#include <span>
 
 namespace fs = std::filesystem;
 
+#define BULKINSERT_BATCH 1024 // Lines of a csv parsed before their records are inserted together
+
 struct DBCommandBadSyntax : std::runtime_error
 {
 public:
@@ -28,25 +32,30 @@ public:
     }
 
 private:
-	static void recordInserter(const std::string& command, const std::string& fields_str, const DBManager::RelationPtr &rel);
+	static Record *parseRecord(const std::string& command, const std::string& fields_str, const DBManager::RelationPtr &rel);
+	static void recordInserter(const std::string& command, std::span<const std::string> lines, const DBManager::RelationPtr &rel, BufferAccessStrategy *strategy = nullptr);
 	static fs::path init_wd;
 
 	void ProcessCreateDatabaseCommand(const std::string &command);
 	void ProcessSetDatabaseCommand(const std::string &command);
 	void ProcessCreateTableCommand(const std::string &command) const;
 	void ProcessDropTableCommand(const std::string &command) const;
+	void ProcessCreateIndexCommand(const std::string &command) const;
+	void ProcessDropIndexCommand(const std::string &command) const;
 	void ProcessListTablesCommand(const std::string &command) const;
 	void ProcessDropTablesCommand(const std::string &command) const;
 	void ProcessDropDatabasesCommand(const std::string &command);
 	void ProcessListDatabasesCommand(const std::string &command) const;
 	void ProcessDropDatabaseCommand(const std::string &command);
 	void ProcessQuitCommand(const std::string &command) const;
+	void ProcessCheckpointCommand(const std::string &command) const;
 
 	void ProcessInsertIntoCommand(const std::string &command) const;
 	void ProcessBulkInsertIntoCommand(const std::string &command) const;
 	void ProcessSelectCommand(const std::string &command) const;
 
 	DBManager dbManager;
+	std::unique_ptr<ResultSink> result_sink_; // Output of SELECT, its buffer is reused by every query
 	std::unordered_map<std::string, std::function<void(const std::string &)>> command_handlers;
 
     static SGBD *instance;
@@ -1,7 +1,11 @@
 #include "SelectCommand.h"
 #include "SGBD.h"
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <ranges>
+#include <string_view>
 
 std::regex SelectCommand::global_exp(R"(^SELECT ([\w*.,]*) FROM (\w+) (\w+)(?: WHERE (.+))?$)");
 std::regex SelectCommand::proj_exp(R"!((\w+)\.(\w+))!");
@@ -29,21 +33,23 @@ SelectCommand::Condition::Condition(const std::string& el1, const std::string& o
 	{
 		Operand &out = is_first ? e1_ : e2_;
 
-		if (!is_first && std::holds_alternative<ProjElement>(e1_))
 		if (operand[0] == '"')
 		{
-			if (*operand.rbegin() != '"') // reverse begin, takes last character from string
+			if (operand.size() < 2 || *operand.rbegin() != '"') // reverse begin, takes last character from string
 				throw DBCommandBadSyntax("SELECT", "couldn't parse condition: " + el1 + op + el2);
 
-			out = operand.substr(1, operand.size() - 1);
+			out = operand.substr(1, operand.size() - 2);
 		}
 		else
 		{
 			try
 			{
-				// least restrictive parsing first, if it fails, there is no chance that the second one can pass
-				out = std::stof(operand);
-				out = std::stoi(operand);
+				// A number is an int only if stoi reads all of it, "0.5" is a float
+				size_t pos = 0;
+				if (const int i = std::stoi(operand, &pos); pos == operand.size())
+					out = i;
+				else if (const float f = std::stof(operand, &pos); pos == operand.size())
+					out = f;
 			}
 			catch (const std::exception &)
 			{
@@ -74,7 +80,7 @@ SelectCommand::Condition::Condition(const std::string& el1, const std::string& o
 
 	try
 	{
-		op_ = operators[op];
+		op_ = operators.at(op);
 	}
 	catch (const std::out_of_range &)
 	{
@@ -158,15 +164,33 @@ void SelectCommand::validate_aliases()
 
 void SelectCommand::expandProjections(const DBManager::RelationPtr& relation)
 {
-	if (!projections_.empty())
-		return;
-
-	for (size_t i = 0; i < relation->nb_fields; i++)
-		projections_.push_back(ProjElement{
-			.rel = relation->name,
-			.col = relation->fieldsMetadata[i].name
-		});
-	projections_.shrink_to_fit();
+	if (projections_.empty())
+	{
+		for (size_t i = 0; i < relation->nb_fields; i++)
+			projections_.push_back(ProjElement{
+				.rel = relation->name,
+				.col = relation->fieldsMetadata[i].name
+			});
+		projections_.shrink_to_fit();
+	}
+
+	// Column index of each projection, the only fields the scan decodes
+	projection_cols_.clear();
+	for (const ProjElement &proj : projections_)
+	{
+		int col = -1;
+		for (int i = 0; i < relation->nb_fields && col == -1; i++)
+			if (proj.col == relation->fieldsMetadata[i].name)
+				col = i;
+		if (col == -1)
+			throw DBCommandBadSyntax("SELECT", "unknown column: " + proj.rel + "." + proj.col);
+		projection_cols_.push_back(col);
+	}
+}
+
+const std::vector<int> &SelectCommand::projectionColumns() const
+{
+	return projection_cols_;
 }
 
 const std::vector<SelectCommand::Condition> &SelectCommand::conditions() const
@@ -189,115 +213,305 @@ const std::string & SelectCommand::alias() const
 	return alias_;
 }
 
-bool SelectCommand::check_conditions(const Fields& fields) const
+namespace
 {
-	static std::unordered_map<Condition::Operator, std::function<bool(const FieldData&, const FieldData&)>> operators{
-		{Condition::OP_EQ, [](const FieldData &a, const FieldData &b) -> bool { return a == b; } },
-		{Condition::OP_NE, [](const FieldData &a, const FieldData &b) -> bool { return a != b; } },
-		{Condition::OP_LT, [](const FieldData &a, const FieldData &b) -> bool { return a < b; } },
-		{Condition::OP_LE, [](const FieldData &a, const FieldData &b) -> bool { return a <= b; } },
-		{Condition::OP_GT, [](const FieldData &a, const FieldData &b) -> bool { return a > b; } },
-		{Condition::OP_GE, [](const FieldData &a, const FieldData &b) -> bool { return a >= b; } },
+	using CompiledCondition = SelectCommand::CompiledCondition;
+	using Operator = SelectCommand::Condition::Operator;
+
+	// Fields aren't aligned in the records, memcpy compiles to a plain load
+	template <typename T>
+	T load(const Record *record, int col)
+	{
+		T value;
+		memcpy(&value, record->data + record->offsets[col], sizeof value);
+		return value;
+	}
+
+	// Up to the first '\0', fixed length strings are padded with zeros
+	std::string_view load_string(const Record *record, int col)
+	{
+		const char *str = reinterpret_cast<const char *>(record->data + record->offsets[col]);
+		return {str, strnlen(str, record->offsets[col + 1] - record->offsets[col])};
+	}
+
+	// Each kernel compares one combination of operand types, Cmp is the operator
+	struct IntColConst
+	{
+		template <typename Cmp>
+		static bool apply(const CompiledCondition &c, const Record *r) { return Cmp{}(load<int>(r, c.col1), c.i); }
 	};
 
-	for (auto &cond : conditions_)
+	template <typename T>
+	struct NumColConst
 	{
-		FieldData op1;
-
-		if (std::holds_alternative<int>(cond.e1_))
-			op1 = std::get<int>(cond.e1_);
-		else if (std::holds_alternative<float>(cond.e1_))
-			op1 = std::get<float>(cond.e1_);
-		else if (std::holds_alternative<std::string>(cond.e1_))
-			op1 = std::get<std::string>(cond.e1_);
-		else if (std::holds_alternative<ProjElement>(cond.e1_))
-			op1 = fields.at(std::get<ProjElement>(cond.e1_).col);
-		else
-			throw std::logic_error("unknown operand type");
+		template <typename Cmp>
+		static bool apply(const CompiledCondition &c, const Record *r) { return Cmp{}(static_cast<double>(load<T>(r, c.col1)), c.d); }
+	};
 
-		FieldData op2;
-		if (std::holds_alternative<int>(cond.e2_))
-			op2 = std::get<int>(cond.e2_);
-		else if (std::holds_alternative<float>(cond.e2_))
-			op2 = std::get<float>(cond.e2_);
-		else if (std::holds_alternative<std::string>(cond.e2_))
-			op2 = std::get<std::string>(cond.e2_);
-		else if (std::holds_alternative<ProjElement>(cond.e2_))
-			op2 = fields.at(std::get<ProjElement>(cond.e2_).col);
-		else
-			throw std::logic_error("unknown operand type");
+	template <typename T1, typename T2>
+	struct NumColCol
+	{
+		template <typename Cmp>
+		static bool apply(const CompiledCondition &c, const Record *r)
+		{
+			if constexpr (std::is_same_v<T1, int> && std::is_same_v<T2, int>)
+				return Cmp{}(load<int>(r, c.col1), load<int>(r, c.col2));
+			else
+				return Cmp{}(static_cast<double>(load<T1>(r, c.col1)), static_cast<double>(load<T2>(r, c.col2)));
+		}
+	};
 
-		if (!operators[cond.op_](op1, op2))
-			return false;
+	struct StrColConst
+	{
+		template <typename Cmp>
+		static bool apply(const CompiledCondition &c, const Record *r) { return Cmp{}(load_string(r, c.col1), std::string_view(c.s)); }
+	};
+
+	struct StrColCol
+	{
+		template <typename Cmp>
+		static bool apply(const CompiledCondition &c, const Record *r) { return Cmp{}(load_string(r, c.col1), load_string(r, c.col2)); }
+	};
+
+	template <typename Kernel, typename Cmp>
+	bool eval(const CompiledCondition &c, const Record *r)
+	{
+		return Kernel::template apply<Cmp>(c, r);
+	}
+
+	template <typename Kernel>
+	CompiledCondition::Eval specialize(Operator op)
+	{
+		switch (op)
+		{
+		case Operator::OP_EQ: return &eval<Kernel, std::equal_to<>>;
+		case Operator::OP_NE: return &eval<Kernel, std::not_equal_to<>>;
+		case Operator::OP_LT: return &eval<Kernel, std::less<>>;
+		case Operator::OP_LE: return &eval<Kernel, std::less_equal<>>;
+		case Operator::OP_GT: return &eval<Kernel, std::greater<>>;
+		case Operator::OP_GE: return &eval<Kernel, std::greater_equal<>>;
+		}
+		throw std::logic_error("unknown operator");
+	}
+
+	// a op b <=> b flip(op) a
+	Operator flip(Operator op)
+	{
+		switch (op)
+		{
+		case Operator::OP_LT: return Operator::OP_GT;
+		case Operator::OP_LE: return Operator::OP_GE;
+		case Operator::OP_GT: return Operator::OP_LT;
+		case Operator::OP_GE: return Operator::OP_LE;
+		default: return op;
+		}
+	}
+
+	FilterOp filter_op(Operator op)
+	{
+		switch (op)
+		{
+		case Operator::OP_EQ: return FILTER_EQ;
+		case Operator::OP_NE: return FILTER_NE;
+		case Operator::OP_LT: return FILTER_LT;
+		case Operator::OP_LE: return FILTER_LE;
+		case Operator::OP_GT: return FILTER_GT;
+		case Operator::OP_GE: return FILTER_GE;
+		}
+		throw std::logic_error("unknown operator");
+	}
+
+	template <typename T>
+	bool compare(const T &a, Operator op, const T &b)
+	{
+		switch (op)
+		{
+		case Operator::OP_EQ: return a == b;
+		case Operator::OP_NE: return a != b;
+		case Operator::OP_LT: return a < b;
+		case Operator::OP_LE: return a <= b;
+		case Operator::OP_GT: return a > b;
+		case Operator::OP_GE: return a >= b;
+		}
+		throw std::logic_error("unknown operator");
 	}
-	return true;
 }
 
-SelectCommand::Fields SelectCommand::read_record(const Record* record)
+/*
+*   Params :
+*       - relation : relation of the command
+*
+*   Description :
+*       Binds the column operands of the conditions to their index in relation, and picks for each condition the
+*       comparator of its operand types and operator. A number compared to a number compares their values, whatever
+*       their type, a string can only be compared to a string. Conditions between two constants are evaluated here.
+*       The comparisons of an INT column to an int and of a REAL column to a constant exact as a float are also given
+*       as column filters, that the scan can evaluate over a whole page at once. These and the comparisons of a CHAR
+*       column to a string that fits in it, but <>, are also given as key conditions, for an index on the column.
+*/
+void SelectCommand::compileConditions(const DBManager::RelationPtr &relation)
 {
-	const Relation *rel = record->rel;
-	std::vector metaDatas(rel->fieldsMetadata, rel->fieldsMetadata + rel->nb_fields);
+	enum class Kind { INT, REAL, STRING };
+
+	struct Bound
+	{
+		Kind kind;
+		int col{-1}; // -1 for a constant
+		int i{0};
+		double d{0};
+		std::string s;
+	};
+
+	auto bind = [&relation](const Condition::Operand &operand)
+	{
+		Bound b;
+		if (const auto *i = std::get_if<int>(&operand))
+		{
+			b.kind = Kind::INT;
+			b.i = *i;
+			b.d = *i;
+		}
+		else if (const auto *f = std::get_if<float>(&operand))
+		{
+			b.kind = Kind::REAL;
+			b.d = *f;
+		}
+		else if (const auto *s = std::get_if<std::string>(&operand))
+		{
+			b.kind = Kind::STRING;
+			b.s = *s;
+		}
+		else if (const auto *proj = std::get_if<ProjElement>(&operand))
+		{
+			for (int i = 0; i < relation->nb_fields && b.col == -1; i++)
+				if (proj->col == relation->fieldsMetadata[i].name)
+					b.col = i;
+			if (b.col == -1)
+				throw DBCommandBadSyntax("SELECT", "unknown column: " + proj->rel + "." + proj->col);
 
-	Fields fields;
-	fields.reserve(record->rel->nb_fields);
+			switch (relation->fieldsMetadata[b.col].type)
+			{
+			case INT: b.kind = Kind::INT; break;
+			case REAL: b.kind = Kind::REAL; break;
+			default: b.kind = Kind::STRING;
+			}
+		}
+		else
+			throw std::logic_error("unknown operand type");
+		return b;
+	};
 
+	compiled_.clear();
+	column_filters_.clear();
+	key_conditions_.clear();
+	always_false_ = false;
 
-	for (size_t i = 0; i < metaDatas.size(); ++i)
+	for (const Condition &cond : conditions_)
 	{
-		FieldData data;
+		Bound a = bind(cond.e1_);
+		Bound b = bind(cond.e2_);
+		Operator op = cond.op_;
+
+		if ((a.kind == Kind::STRING) != (b.kind == Kind::STRING))
+			throw DBCommandBadSyntax("SELECT", "cannot compare a string with a number");
+
+		if (a.col == -1 && b.col == -1)
+		{
+			if (a.kind == Kind::STRING)
+				always_false_ |= !compare(a.s, op, b.s);
+			else
+				always_false_ |= !compare(a.d, op, b.d);
+			continue;
+		}
 
-		switch (metaDatas[i].type)
+		// The column goes first
+		if (a.col == -1)
 		{
-		case FieldType::INT:
-			data = read_field_i32(record, i);
-			break;
-		case FieldType::REAL:
-			data = read_field_f32(record, i);
-			break;
-		case FieldType::FIXED_LENGTH_STRING:
-		case FieldType::VARCHAR:
+			std::swap(a, b);
+			op = flip(op);
+		}
+
+		CompiledCondition c;
+		c.col1 = a.col;
+		c.col2 = b.col;
+		c.i = b.i;
+		c.d = b.d;
+		c.s = b.s;
+
+		if (a.kind == Kind::STRING)
+			c.eval = b.col == -1 ? specialize<StrColConst>(op) : specialize<StrColCol>(op);
+		else if (b.col == -1)
+		{
+			if (a.kind == Kind::INT && b.kind == Kind::INT)
+				c.eval = specialize<IntColConst>(op);
+			else
+				c.eval = a.kind == Kind::INT ? specialize<NumColConst<int>>(op) : specialize<NumColConst<float>>(op);
+		}
+		else if (a.kind == Kind::INT)
+			c.eval = b.kind == Kind::INT ? specialize<NumColCol<int, int>>(op) : specialize<NumColCol<int, float>>(op);
+		else
+			c.eval = b.kind == Kind::INT ? specialize<NumColCol<float, int>>(op) : specialize<NumColCol<float, float>>(op);
+
+		// A float filter compares the field as a float, the same as compared as a double only if the constant is exact
+		const bool columnar = a.kind == Kind::INT ? b.kind == Kind::INT
+			: a.kind == Kind::REAL && static_cast<double>(static_cast<float>(b.d)) == b.d;
+		if (b.col == -1 && columnar)
+		{
+			ColumnFilter filter{};
+			filter.op = filter_op(op);
+			filter.col = a.col;
+			if (a.kind == Kind::INT)
+			{
+				filter.type = INT;
+				filter.value.i = b.i;
+			}
+			else
 			{
-				char *str;
-				const size_t len = read_field_string(record, i, &str, nullptr);
-				data = std::string{str, str + len};
-				free(str);
-				break;
+				filter.type = REAL;
+				filter.value.f = static_cast<float>(b.d);
 			}
+			column_filters_.push_back(filter);
+			c.columnar = true;
+
+			if (op != Operator::OP_NE)
+				key_conditions_.push_back(KeyCondition{a.col, op, std::string(reinterpret_cast<const char *>(&filter.value), 4)});
+		}
+		else if (b.col == -1 && op != Operator::OP_NE && relation->fieldsMetadata[a.col].type == FIXED_LENGTH_STRING
+			&& b.s.size() <= FIELD_SIZEOF(relation, a.col))
+		{
+			std::string key = b.s;
+			key.resize(FIELD_SIZEOF(relation, a.col), '\0');
+			key_conditions_.push_back(KeyCondition{a.col, op, std::move(key)});
 		}
 
-		fields[metaDatas[i].name] = data;
+		compiled_.push_back(std::move(c));
 	}
-
-	return fields;
 }
 
-
-void SelectCommand::operator()(std::ostream& os, const Record* record)
+bool SelectCommand::has_residual_conditions() const
 {
-	Fields fields = read_record(record);
-	if (!check_conditions(fields))
-		return;
-	nb_printed_++;
+	return always_false_ || std::ranges::any_of(compiled_, [](const CompiledCondition &cond) { return !cond.columnar; });
+}
 
-	bool first = true;
-	for (const std::string &col : projections_ | std::views::transform([](const ProjElement &proj) {return proj.col;}))
-	{
-		if (!first)
-			os << " ; ";
+// HeapScanFilter of the conditions that aren't column filters, for a scan that evaluates the column filters itself
+int SelectCommand::residual_filter(const Record *record, void *arg)
+{
+	const auto *cmd = static_cast<const SelectCommand *>(arg);
+	if (cmd->always_false_)
+		return false;
 
-		if (std::holds_alternative<int>(fields[col]))
-			os << std::get<int>(fields[col]);
-		else if (std::holds_alternative<float>(fields[col]))
-			os << std::get<float>(fields[col]);
-		else if (std::holds_alternative<std::string>(fields[col]))
-			os << std::get<std::string>(fields[col]);
+	for (const CompiledCondition &cond : cmd->compiled_)
+		if (!cond.columnar && !cond.eval(cond, record))
+			return false;
+	return true;
+}
 
-		first = false;
-	}
-	os << std::endl;
+const std::vector<ColumnFilter> &SelectCommand::columnFilters() const
+{
+	return column_filters_;
 }
 
-size_t SelectCommand::nb_printed() const
+const std::vector<SelectCommand::KeyCondition> &SelectCommand::keyConditions() const
 {
-	return nb_printed_;
+	return key_conditions_;
 }
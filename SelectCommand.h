@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "DBManager.h"
+#include "FilterKernels.h"
 #include "Record.h"
 
 class SelectCommand
@@ -77,6 +78,28 @@ public:
 		}
 	};
 
+	// WHERE condition bound to the columns of the relation, specialized for the types of its operands and its operator
+	struct CompiledCondition
+	{
+		using Eval = bool (*)(const CompiledCondition &cond, const Record *record);
+
+		Eval eval{nullptr}; // Reads the fields in place, allocates nothing
+		int col1{-1}; // Column of the first operand
+		int col2{-1}; // Column of the second operand, -1 if it's a constant
+		int i{0}; // Constant second operand, as read by eval
+		double d{0};
+		std::string s;
+		bool columnar{false}; // Also in the column filters, evaluated by the scan over whole pages
+	};
+
+	// Condition "column op constant" an index on the column can answer, the constant encoded as a key of the index
+	struct KeyCondition
+	{
+		int col;
+		Condition::Operator op; // Any but OP_NE
+		std::string key; // The bytes of the field, a string padded with zeros
+	};
+
 	explicit SelectCommand(const std::string &command);
 
 	[[nodiscard]] const std::vector<Condition> &conditions() const;
@@ -85,27 +108,29 @@ public:
 	const std::string &relation() const;
 	const std::string &alias() const;
 
-	void operator()(std::ostream &os, const Record *record);
-	size_t nb_printed() const;
+	[[nodiscard]] bool has_residual_conditions() const;
+	static int residual_filter(const Record *record, void *arg);
+	[[nodiscard]] const std::vector<ColumnFilter> &columnFilters() const;
+	[[nodiscard]] const std::vector<KeyCondition> &keyConditions() const;
 
 	void expandProjections(const DBManager::RelationPtr &relation);
+	[[nodiscard]] const std::vector<int> &projectionColumns() const;
+	void compileConditions(const DBManager::RelationPtr &relation);
 
 private:
-	using FieldData = std::variant<int, float, std::string>;
-	using Fields = std::unordered_map<std::string, FieldData>;
-
 	static std::regex global_exp;
 	static std::regex proj_exp;
 	static std::regex where_exp;
 
 	void validate_aliases();
 
-	static Fields read_record(const Record *record);
-	bool check_conditions(const Fields &fields) const;
-
 	std::vector<ProjElement> projections_;
+	std::vector<int> projection_cols_; // Index in the relation of each projection, see expandProjections()
 	std::vector<Condition> conditions_;
+	std::vector<CompiledCondition> compiled_; // Conditions of conditions_ that depend on the record, see compileConditions()
+	std::vector<ColumnFilter> column_filters_; // Conditions "INT or REAL column op constant" of compiled_
+	std::vector<KeyCondition> key_conditions_; // Conditions of compiled_ an index can answer
+	bool always_false_{false}; // A condition between two constants is false
 	std::string relation_;
 	std::string alias_;
-	size_t nb_printed_{0};
 };
@@ -12,5 +12,6 @@ typedef struct PageIdList PageIdList;
 typedef struct Relation Relation;
 typedef struct Record Record;
 typedef struct FieldMetadata FieldMetadata;
+typedef struct BufferAccessStrategy BufferAccessStrategy;
 
 #endif //SHINBDDA_STRUCTURES_H
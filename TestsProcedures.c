@@ -3,4 +3,328 @@
 #include "DBConfig.h"
 #include "Tools_L.h"
 #include "DiskManager.h"
+#include "BufferManager.h"
 #include "PageId.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static double elapsedNs(const struct timespec* start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) * 1e9 + (double)(end.tv_nsec - start->tv_nsec);
+}
+
+static void perCallMmapReadPage(PageId* pageid, uint8_t* buff)
+// What ReadPage() used to do: open, map the whole file, copy and unmap for each page.
+{
+    char* path = getPageIdFile(pageid);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return;
+    }
+
+    uint8_t* file = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0); // Files grow past dm_maxfilesize
+    if (file != MAP_FAILED)
+    {
+        memcpy(buff, file + (size_t)pageid->PageIdx * config->pagesize, config->pagesize);
+        munmap(file, st.st_size);
+    }
+    close(fd);
+}
+
+static int allocBenchPages(PageId** pages, int nb_pages)
+// Allocates the pages of a benchmark, -1 and none allocated if the files can't grow.
+{
+    for (int i = 0; i < nb_pages; i++)
+    {
+        if ((pages[i] = AllocPage()) == NULL)
+        {
+            fprintf(stderr, "error: benchmark: can't allocate %d pages\n", nb_pages);
+            while (i-- > 0)
+                DeallocPage(pages[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void BenchmarkIOBackends(int nb_pages, int rounds)
+/*
+* Includes:
+*   <stdio.h> [printf()]
+*   <stdlib.h> [malloc(); free(); rand()]
+*   <time.h> [clock_gettime()]
+*
+*   "DiskManager.h" [AllocPage(); DeallocPage(); GetIOBackend(); DiskIOBackend]
+* Params:
+*   int nb_pages = The number of pages to allocate for the benchmark.
+*   int rounds = The number of times each operation goes over every page.
+* Return:
+*   None.
+* Description:
+*   This function runs the same workload on each DiskIOBackend and prints the mean time per page of:
+*      write_page on every page, read_page in random order, read_pages on all the pages at once,
+*      write_pages_async on all the pages at once, waiting only at the end.
+*   The pages are written first, so reads hit a warm page cache.
+*   The old per-call mmap ReadPage() is measured as well, as a reference.
+* Malloc:
+*   None.
+* Notes:
+*   The allocated pages are deallocated at the end, their content is overwritten.
+*/
+{
+    PageId** pages = malloc(nb_pages * sizeof *pages);
+    uint8_t** buffs = malloc(nb_pages * sizeof *buffs);
+    int* order = malloc(nb_pages * sizeof *order);
+    if (allocBenchPages(pages, nb_pages) == -1)
+    {
+        free(pages);
+        free(buffs);
+        free(order);
+        return;
+    }
+    for (int i = 0; i < nb_pages; i++)
+    {
+        buffs[i] = calloc(config->pagesize, sizeof(uint8_t));
+        order[i] = rand() % nb_pages;
+    }
+
+    const IOBackend backends[] = {IO_BACKEND_MMAP, IO_BACKEND_PREAD, IO_BACKEND_URING};
+    const double total = (double)nb_pages * rounds;
+    struct timespec start;
+
+    for (size_t b = 0; b < sizeof backends / sizeof backends[0]; b++)
+    {
+        const DiskIOBackend* io = GetIOBackend(backends[b]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int r = 0; r < rounds; r++)
+            for (int i = 0; i < nb_pages; i++)
+                io->write_page(pages[i], buffs[i]);
+        printf("%-6s write_page : %10.1f ns/page\n", io->name, elapsedNs(&start) / total);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int r = 0; r < rounds; r++)
+            for (int i = 0; i < nb_pages; i++)
+                io->read_page(pages[order[i]], buffs[i]);
+        printf("%-6s read_page  : %10.1f ns/page\n", io->name, elapsedNs(&start) / total);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int r = 0; r < rounds; r++)
+            io->read_pages(pages, buffs, nb_pages);
+        printf("%-6s read_pages : %10.1f ns/page\n", io->name, elapsedNs(&start) / total);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int r = 0; r < rounds; r++)
+            io->write_pages_async(pages, buffs, nb_pages);
+        io->wait();
+        printf("%-6s write_async: %10.1f ns/page\n", io->name, elapsedNs(&start) / total);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        io->sync();
+        printf("%-6s sync       : %10.1f ns\n", io->name, elapsedNs(&start));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < nb_pages; i++)
+            perCallMmapReadPage(pages[order[i]], buffs[i]);
+    printf("%-6s read_page  : %10.1f ns/page (mmap per call)\n", "OLD", elapsedNs(&start) / total);
+
+    for (int i = 0; i < nb_pages; i++)
+    {
+        DeallocPage(pages[i]);
+        free(buffs[i]);
+    }
+    free(order);
+    free(buffs);
+    free(pages);
+}
+
+void BenchmarkReplacementPolicies(int nb_pages, int nb_hot, int rounds)
+/*
+* Includes:
+*   <stdio.h> [printf()]
+*   <stdlib.h> [malloc(); free(); rand()]
+*   <time.h> [clock_gettime()]
+*
+*   "DiskManager.h" [AllocPage(); DeallocPage()]
+*   "BufferManager.h" [GetPage(); FreePage(); FlushBuffers(); SetCurrentReplacementPolicy(); GetBufferStats()]
+* Params:
+*   int nb_pages = The number of pages scanned, they should outnumber the frames.
+*   int nb_hot = The number of pages accessed repeatedly, as relation header pages are.
+*   int rounds = The number of scans of the trace.
+* Return:
+*   None.
+* Description:
+*   This function builds one trace mixing full scans of the pages with accesses to the hot pages
+*   (one every 4 scanned pages, plus random point lookups) and replays it under each replacement policy,
+*   printing the hits, misses, evictions and time per access of each one.
+*   The buffers are flushed before each replay, so every policy starts from an empty pool.
+* Malloc:
+*   None.
+* Notes:
+*   The allocated pages are deallocated at the end, the current policy is restored.
+*/
+{
+    const size_t per_round = nb_pages + nb_pages / 4 + nb_pages / 8;
+    const size_t length = per_round * rounds;
+    PageId** pages = malloc((nb_pages + nb_hot) * sizeof *pages);
+    int* trace = malloc(length * sizeof *trace);
+    if (allocBenchPages(pages, nb_pages + nb_hot) == -1)
+    {
+        free(pages);
+        free(trace);
+        return;
+    }
+
+    size_t n = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < nb_pages; i++)
+        {
+            trace[n++] = i;
+            if (i % 4 == 3)
+                trace[n++] = nb_pages + rand() % nb_hot;
+            if (i % 8 == 7)
+                trace[n++] = rand() % nb_pages;
+        }
+    }
+
+    const Policy saved = config->dm_policy;
+    const Policy policies[] = {POLICY_LRU, POLICY_MRU, POLICY_CLOCK, POLICY_ARC};
+    const char* names[] = {[POLICY_LRU] = "LRU", [POLICY_MRU] = "MRU", [POLICY_CLOCK] = "CLOCK", [POLICY_ARC] = "ARC"};
+    struct timespec start;
+
+    for (size_t p = 0; p < sizeof policies / sizeof policies[0]; p++)
+    {
+        FlushBuffers();
+        SetCurrentReplacementPolicy(policies[p]);
+        const BufferStats before = GetBufferStats(policies[p]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < n; i++)
+        {
+            GetPage(pages[trace[i]]);
+            FreePage(pages[trace[i]], 0);
+        }
+        const double ns = elapsedNs(&start) / (double)n;
+
+        const BufferStats after = GetBufferStats(policies[p]);
+        const size_t hits = after.hits - before.hits, misses = after.misses - before.misses;
+        printf("%-5s hits: %8zu misses: %8zu evictions: %8zu hit ratio: %5.1f%% %8.1f ns/access\n", names[policies[p]],
+            hits, misses, after.evictions - before.evictions, 100.0 * (double)hits / (double)(hits + misses), ns);
+    }
+
+    FlushBuffers();
+    SetCurrentReplacementPolicy(saved);
+    for (int i = 0; i < nb_pages + nb_hot; i++)
+        DeallocPage(pages[i]);
+    free(trace);
+    free(pages);
+}
+
+typedef struct ConcurrentWorker
+{
+    PageId** pages;
+    int nb_pages;
+    int accesses;
+    unsigned int seed;
+} ConcurrentWorker;
+
+static void* concurrentWorkerMain(void* arg)
+{
+    ConcurrentWorker* worker = arg;
+
+    for (int i = 0; i < worker->accesses; i++)
+    {
+        PageId* pageId = worker->pages[rand_r(&worker->seed) % worker->nb_pages];
+        uint8_t* content = GetPage(pageId);
+        LatchBuffer(content, BUFFER_LATCH_EXCLUSIVE);
+        (*(uint32_t*)content)++;
+        UnlatchBuffer(content);
+        FreePage(pageId, 1);
+    }
+
+    return NULL;
+}
+
+void BenchmarkConcurrentGetPage(int nb_pages, int nb_threads, int accesses)
+/*
+* Includes:
+*   <stdio.h> [printf()]
+*   <stdlib.h> [malloc(); free()]
+*   <pthread.h> [pthread_create(); pthread_join()]
+*   <time.h> [clock_gettime()]
+*
+*   "DiskManager.h" [AllocPage(); DeallocPage()]
+*   "BufferManager.h" [GetPage(); FreePage(); LatchBuffer(); UnlatchBuffer(); FlushBuffers()]
+* Params:
+*   int nb_pages = The number of pages accessed, more than the frames to exercise the evictions.
+*   int nb_threads = The number of threads accessing the pages at once.
+*   int accesses = The number of pages accessed by each thread.
+* Return:
+*   None.
+* Description:
+*   Each thread pins random pages and increments a counter stored at the start of the page under an exclusive latch.
+*   Once the threads are joined, the counters must add up to nb_threads * accesses: an update lost by an eviction
+*   or by two threads sharing a frame shows up as a mismatch. The time per access is printed with the current policy.
+* Malloc:
+*   None.
+* Notes:
+*   The allocated pages are deallocated at the end.
+*/
+{
+    PageId** pages = malloc(nb_pages * sizeof *pages);
+    ConcurrentWorker* workers = malloc(nb_threads * sizeof *workers);
+    pthread_t* threads = malloc(nb_threads * sizeof *threads);
+    if (allocBenchPages(pages, nb_pages) == -1)
+    {
+        free(pages);
+        free(workers);
+        free(threads);
+        return;
+    }
+    for (int i = 0; i < nb_pages; i++)
+    {
+        memset(GetPage(pages[i]), 0, config->pagesize);
+        FreePage(pages[i], 1);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < nb_threads; t++)
+    {
+        workers[t] = (ConcurrentWorker){pages, nb_pages, accesses, (unsigned int)t + 1};
+        pthread_create(threads + t, NULL, concurrentWorkerMain, workers + t);
+    }
+    for (int t = 0; t < nb_threads; t++)
+        pthread_join(threads[t], NULL);
+    const double ns = elapsedNs(&start) / ((double)nb_threads * accesses);
+
+    size_t total = 0;
+    for (int i = 0; i < nb_pages; i++)
+    {
+        total += *(uint32_t*)GetPage(pages[i]);
+        FreePage(pages[i], 0);
+    }
+    printf("%d threads: %zu/%zu updates kept %8.1f ns/access\n", nb_threads, total, (size_t)nb_threads * accesses, ns);
+
+    FlushBuffers();
+    for (int i = 0; i < nb_pages; i++)
+        DeallocPage(pages[i]);
+    free(threads);
+    free(workers);
+    free(pages);
+}
@@ -4,4 +4,16 @@
 
 #include "Structures.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void BenchmarkIOBackends(int nb_pages, int rounds);
+void BenchmarkReplacementPolicies(int nb_pages, int nb_hot, int rounds);
+void BenchmarkConcurrentGetPage(int nb_pages, int nb_threads, int accesses);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif //SHINBDDA_TESTSPROCEDURES_H
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // fallocate()
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -566,6 +567,42 @@ char* StringandNumbers(const char* prefix, int number)
         return result;  // Return the new dynamically allocated string
 }
 
+int preallocateFile(int fd, off_t size)
+/*
+* Includes:
+*   <fcntl.h> [fallocate()]
+*   <unistd.h> [ftruncate()]
+*   <sys/stat.h> [fstat()]
+*   <errno.h> [errno; EOPNOTSUPP]
+* Params:
+*   int fd = The file descriptor, opened for writing.
+*   off_t size = The size of the file after the call.
+* Return:
+*   int
+*      0 => Success.
+*      -1 => There's been an error, errno is set.
+* Description:
+*   This function grows the file to size bytes and reserves its blocks with fallocate(), so writing the new part doesn't allocate them.
+*   If the filesystem doesn't support fallocate(), the file is extended with ftruncate() instead.
+* Malloc:
+*   None.
+* Notes:
+*   A file already of size bytes or more is left as is.
+*/
+{
+    struct stat s;
+    if (fstat(fd, &s) == -1)
+        return -1;
+    if (s.st_size >= size)
+        return 0;
+
+    if (fallocate(fd, 0, s.st_size, size - s.st_size) == 0)
+        return 0;
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+        return -1;
+    return ftruncate(fd, size);
+}
+
 int remove_directory(const char *path)
 /*
 * Includes:
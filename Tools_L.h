@@ -115,6 +115,7 @@ static inline int checkDATA(char* filename, int lineNumber) //return 1 if existi
 
 char* createFileInDirectory(const char* directoryPath, const char* fileName,char* extensionwithdot);
 char* StringandNumbers(const char* prefix, int number);
+int preallocateFile(int fd, off_t size);
 int remove_directory(const char *path);
 
 #ifdef __cplusplus
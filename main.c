@@ -8,9 +8,10 @@
 #include "BufferManager.h"
 #include "Relation.h"
 #include "Record.h"
+#include "TestsProcedures.h"
 
 void assert_head(PageId *pageId) {
-    assert(bufferManager->bufferHead->bufferPageId == pageId);
+    assert(bufferManager->bufferHead->bufferPageId.FileIdx == pageId->FileIdx && bufferManager->bufferHead->bufferPageId.PageIdx == pageId->PageIdx);
 }
 
 void random_string(char *out, size_t len)
@@ -105,6 +106,20 @@ int main(int argc, char **argv)
     int diskinitreturn = diskInit(config); // Mandatory to call
     constructBufferManager();
 
+    //Benchmarks of the DiskManager I/O backends, of the replacement policies and of concurrent pins: ./SHINBDDA <config file> bench
+    if (argc > 2 && strcmp(argv[2], "bench") == 0)
+    {
+        BenchmarkIOBackends(256, 20);
+        BenchmarkReplacementPolicies(4 * config->dm_buffercount, config->dm_buffercount / 4 + 1, 20);
+        BenchmarkConcurrentGetPage(2 * config->dm_buffercount, 4, 20000);
+        SaveState();
+        free(mainpath);
+        clearBufferManager();
+        diskFREE();
+        DBFree();
+        return 0;
+    }
+
     //Tests BufferManager
     /*
     *           // 1. Remplir les buffers